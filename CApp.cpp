@@ -46,10 +46,7 @@ CApp::CApp()
 	isRunning = true;
 	pWindow = NULL;
 	pRenderer = NULL;
-	
-	// ***********
-	// We have to initialize the thread counter here in the class constructor.
-	m_threadCounter = new std::atomic<int> (0);
+	m_pFrameTexture = NULL;
 }
 
 bool CApp::OnInit()
@@ -87,9 +84,27 @@ bool CApp::OnInit()
 		}
 		
 		// ****
-		// Initialize the thread counter.
-		m_maxThreads = 12;
-		m_threadCounter -> store(0, std::memory_order_release);		
+		// Register an SDL event for the render threads to wake us up with
+		// whenever they finish a tile (see OnEvent()).
+		m_tileEventType = SDL_RegisterEvents(1);
+		if (m_tileEventType == static_cast<Uint32>(-1))
+		{
+			std::cout << "Failed to register the tile event." << std::endl;
+			return false;
+		}
+		m_tileScheduler.SetTileCallback([this](int tileIndex){ PostTileEvent(); });
+		
+		// Start the render threads. These persist until OnExit() and
+		// each one repeatedly picks up the next tile from the scheduler.
+		if (!m_tileScheduler.Start(&m_scene, m_numThreads))
+		{
+			std::cout << "Failed to start the render threads." << std::endl;
+			return false;
+		}
+		
+		// Start rendering the first frame.
+		m_tileScheduler.SetTileOrder(m_tileOrder);
+		m_tileScheduler.StartFrame();
 		
 		/*
 			Following the introduction of tile-based rendering, the code
@@ -126,25 +141,23 @@ int CApp::OnExecute()
 	
 	while (isRunning)
 	{
-		while (SDL_PollEvent(&event) != 0)
+		/*
+			Rather than polling with a short delay, we now sleep until there
+			is an event to handle. As well as the usual SDL events, the render
+			threads push an event each time they finish a tile, so we only
+			wake up when there is something new to display.
+		*/
+		if (SDL_WaitEvent(&event) != 0)
 		{
 			OnEvent(&event);
+			while (SDL_PollEvent(&event) != 0)
+			{
+				OnEvent(&event);
+			}
 		}
 		
 		OnLoop();
 		OnRender();
-		
-		/*
-			The delay here seems counterintuitive, but it actually makes the
-			rendering faster (with multi-threading). The reason for this, 
-			I think, is that it reduces the load imposed by looping through 
-			this code allowing more of the CPU time to be used for actual 
-			rendering. I have tried different values, reducing it below 1 
-			seems to slow things down and increasing it above 4 also slows 
-			things down. It would seem that somewhere between 1 and 4 is the
-			'sweet spot', so I have left it at 1.
-		*/
-		SDL_Delay(1);		
 	}
 	
 	OnExit();
@@ -157,6 +170,19 @@ void CApp::OnEvent(SDL_Event *event)
 	{
 		isRunning = false;
 	}
+	
+	// A render thread has finished one or more tiles. Clearing the flag first means
+	// that any tiles finished after we collect them in OnRender() will post a new event.
+	if (event->type == m_tileEventType)
+	{
+		m_tileEventPending.store(false);
+	}
+	
+	// Render the tiles under the mouse cursor first.
+	if (event->type == SDL_MOUSEMOTION)
+	{
+		m_tileScheduler.SetFocusPoint(event->motion.x, event->motion.y);
+	}
 }
 
 void CApp::OnLoop()
@@ -189,84 +215,62 @@ void CApp::OnLoop()
 			break;
 		}
 	}*/
-	for (int i=0; i<m_tiles.size(); ++i)
+	/*
+		Tiles are now handed out to the render threads by the tile scheduler
+		(see qbThreads/tilescheduler.cpp), which also splits any tiles that
+		take too long. All that we have to do here is report the statistics
+		once the frame is finished.
+	*/
+	if (!m_frameStatsPrinted && m_tileScheduler.IsFrameComplete())
 	{
-			if (m_tileFlags.at(i) -> load(std::memory_order_acquire) == 0)
-			{
-				// This tile is waiting to be rendered.
-				// Check if any threads are available.
-				if (m_threadCounter -> load(std::memory_order_acquire) < m_maxThreads)
-				{
-					// We have a thread available, so launch it to render this tile.
-					int numActiveThreads = m_threadCounter -> load(std::memory_order_acquire);					
-					m_threadCounter -> store(numActiveThreads+1, std::memory_order_release);
-					std::thread renderThread (&CApp::RenderTile, this, &m_tiles.at(i), m_threadCounter, m_tileFlags.at(i));
-					renderThread.detach();
-				}
-			}	
+		m_tileScheduler.PrintStats();
+		m_frameStatsPrinted = true;
 	}
 }
 
 void CApp::OnRender()
 {
-	// Converstion factors from screen width/height to window width/height.
-	// For future versions.
-	double widthFactor = 1.0;
-	double heightFactor = 1.0;
-	
 	/*
-		The actual display is now generated here. We loop over all of the tiles
-		and wherever we find one that has been rendered (tileFlags == 2), then
-		we check if we have already display this tile (textureComplete) and if
-		not we convert the image data to an SDL texture and then use SDL_RenderCopy
-		to copy that texture to the right place in the window.
-		
-		In a single-thread implementation, this approach doesn't necessarily make
-		much sense, but it forms the foundation on which we can build our multi-threaded
-		version.
+		The render threads now tell us which tiles they have finished (see
+		OnEvent()), so rather than checking every tile each time through
+		the loop, we only display the tiles that are new. If there aren't
+		any, then there is nothing to present either.
 	*/
+	if (!m_tileScheduler.GetCompletedTiles(m_completedTiles))
+		return;
 	
-	// Render the tiles.
-	for (int i=0; i<m_tiles.size(); ++i)
+	/*
+		The render threads write the final pixels straight into the frame
+		buffer, so all that we have to do here is copy the area covered by
+		each new tile into the texture. A tile that was split before it
+		rendered anything has no rows of its own.
+	*/
+	const qbRT::FrameBuffer &frameBuffer = m_tileScheduler.GetFrameBuffer();
+	for (auto i : m_completedTiles)
 	{
-		// Only render the tile if it is complete.
-		//if (m_tileFlags.at(i) == 2)
-		if (m_tileFlags.at(i) -> load(std::memory_order_acquire) == 2)
+		const qbRT::DATA::tile &tile = m_tileScheduler.GetTile(i);
+		if (tile.ySize > 0)
 		{
-			SDL_Rect srcRect, dstRect;
-			srcRect.x = 0;
-			srcRect.y = 0;
-			srcRect.w = m_tiles.at(i).xSize;
-			srcRect.h = m_tiles.at(i).ySize;
-			dstRect.x = static_cast<int>(std::round(static_cast<double>(m_tiles.at(i).x) * widthFactor));
-			dstRect.y = static_cast<int>(std::round(static_cast<double>(m_tiles.at(i).y) * heightFactor));
-			dstRect.w = static_cast<int>(std::round(static_cast<double>(m_tiles.at(i).xSize) * widthFactor));
-			dstRect.h = static_cast<int>(std::round(static_cast<double>(m_tiles.at(i).ySize) * heightFactor));
-			
-			/*
-				If the textureComplete flag for this tile is not set, then it means that the tile
-				has been rendered, but not yet converted to a texture. So we do that here and
-				then set the textureComplete flag and blit the texture into the renderer.
-				Note that once this is done, we don't do this again for this tile meaning
-				that we don't keep updating each tile every time we go through this loop.
-				This helps to keep things as efficient as possible.
-			*/
-			if (!m_tiles.at(i).textureComplete)
-			{
-				ConvertImageToTexture(m_tiles.at(i));
-				m_tiles.at(i).textureComplete = true;
-				SDL_RenderCopy(pRenderer, m_tiles.at(i).pTexture, &srcRect, &dstRect);			
-			}					
+			SDL_Rect tileRect;
+			tileRect.x = tile.x;
+			tileRect.y = tile.y;
+			tileRect.w = tile.xSize;
+			tileRect.h = tile.ySize;
+			SDL_UpdateTexture(m_pFrameTexture, &tileRect, frameBuffer.GetPixels(tile.x, tile.y), frameBuffer.GetPitch());
 		}
 	}
 	
 	// Show the result.
+	SDL_RenderCopy(pRenderer, m_pFrameTexture, NULL, NULL);
 	SDL_RenderPresent(pRenderer);		
 	
 }
 
 void CApp::OnExit()
 {
+	// Stop the render threads before we destroy the tiles they are working on.
+	m_tileScheduler.Stop();
+	
 	// Tidy up the tile grid.
 	bool result = DestroyTileGrid();
 
@@ -290,154 +294,59 @@ void CApp::PrintVector(const qbVector3<double> &inputVector)
 // Function to generate the tile grid.
 bool CApp::GenerateTileGrid(int tileSizeX, int tileSizeY)
 {
-	// How many tiles will fit horizontally?
-	int numTilesX = std::floor(m_xSize / tileSizeX);
-	m_numTilesX = numTilesX;
-	
-	// How many tiles will fit vertically?
-	int numTilesY = std::floor(m_ySize / tileSizeY);
-	m_numTilesY = numTilesY;
+	// The tiles themselves are generated (and owned) by the tile scheduler.
+	if (!m_tileScheduler.GenerateTileGrid(m_xSize, m_ySize, tileSizeX, tileSizeY))
+		return false;
 	
-	// Setup an SDL surface from which we can generate the textures for each tile.
-	Uint32 rmask, gmask, bmask, amask;
-	#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    rmask = 0xff000000;
-    gmask = 0x00ff0000;
-    bmask = 0x0000ff00;
-    amask = 0x000000ff;
-	#else
-    rmask = 0x000000ff;
-    gmask = 0x0000ff00;
-    bmask = 0x00ff0000;
-    amask = 0xff000000;
-	#endif	
-	SDL_Surface *tempSurface = SDL_CreateRGBSurface(0, tileSizeX, tileSizeY, 32, rmask, gmask, bmask, amask);
+	/*
+		Rather than a texture for each tile, we now use a single streaming
+		texture for the whole window. The pixels come from the scheduler's
+		frame buffer, which is in the same format, so there is no conversion
+		to do when we update the texture.
+	*/
+	qbRT::FrameBuffer &frameBuffer = m_tileScheduler.GetFrameBuffer();
+	frameBuffer.SetMaxLevel(m_maxLevel);
 	
-	// Generate the actual tiles.
-	for (int y=0; y<numTilesY; ++y)
+	if (m_pFrameTexture == NULL)
+		m_pFrameTexture = SDL_CreateTexture(pRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, m_xSize, m_ySize);
+		
+	if (m_pFrameTexture == NULL)
 	{
-		for (int x=0; x<numTilesX; ++x)
-		{
-			qbRT::DATA::tile tempTile;
-			tempTile.x = x * tileSizeX;
-			tempTile.y = y * tileSizeY;
-			tempTile.xSize = tileSizeX;
-			tempTile.ySize = tileSizeY;
-			tempTile.renderComplete = 0;
-			tempTile.pTexture = SDL_CreateTextureFromSurface(pRenderer, tempSurface);
-			tempTile.rgbData.resize(tempTile.xSize * tempTile.ySize);
-			m_tiles.push_back(tempTile);		
-		}
+		std::cout << "Failed to create texture: " << SDL_GetError() << std::endl;
+		return false;
 	}
-				
-	// Set all the tile flags to zero.
-	for (int i=0; i<m_tiles.size(); ++i)
-	{
-		m_tileFlags.push_back(new std::atomic<int> (0));
-	}	
-	/*
-	for (int i=0; i<m_tiles.size(); ++i)
-	{
-		m_tileFlags.push_back(0);
-	}*/
-				
-	// Tidy up before returning.
-	SDL_FreeSurface(tempSurface);	
+	
+	// Start with the (blank) contents of the frame buffer.
+	SDL_UpdateTexture(m_pFrameTexture, NULL, frameBuffer.GetPixels(), frameBuffer.GetPitch());
 	return true;				
 }
 
 // Function to destroy the tile grid.
 bool CApp::DestroyTileGrid()
 {
-	for (int i=0; i<m_tiles.size(); ++i)
-	{
-		if (m_tiles.at(i).pTexture != NULL)
-			SDL_DestroyTexture(m_tiles.at(i).pTexture);
-	
-	}
+	if (m_pFrameTexture != NULL)
+		SDL_DestroyTexture(m_pFrameTexture);
+		
+	m_pFrameTexture = NULL;
 	return true;
 }
 
-// Function to convert an RGB image to a texture.
-void CApp::ConvertImageToTexture(qbRT::DATA::tile &tile)
+// Function to wake up the display thread (called on the render threads).
+void CApp::PostTileEvent()
 {
-	// Allocate memory for a pixel buffer.
-	Uint32 *tempPixels = new Uint32[tile.xSize * tile.ySize];
-	
-	// Clear the pixel buffer.
-	memset(tempPixels, 0, tile.xSize * tile.ySize * sizeof(Uint32));
-	
-	// Copy the image into tempPixels.
-	for (int i=0; i<tile.xSize * tile.ySize; ++i)
+	// We only need one event in the queue at a time, however many tiles have finished.
+	if (!m_tileEventPending.exchange(true))
 	{
-		tempPixels[i] = ConvertColor(tile.rgbData.at(i).m_x, tile.rgbData.at(i).m_y, tile.rgbData.at(i).m_z);
+		SDL_Event event;
+		SDL_zero(event);
+		event.type = m_tileEventType;
+		SDL_PushEvent(&event);
 	}
-	
-	// Update the texture with the pixel buffer.
-	SDL_UpdateTexture(tile.pTexture, NULL, tempPixels, tile.xSize * sizeof(Uint32));	
-	
-	// Delete the pixel buffer.
-	delete[] tempPixels;
 }
 
-// Function to convert colours to Uint32
-Uint32 CApp::ConvertColor(const double red, const double green, const double blue)
-{
-	// Convert the colours to unsigned integers.
-	double newRed = std::max(std::min(std::pow(red, m_maxLevel), 1.0), 0.0);
-	double newGreen = std::max(std::min(std::pow(green, m_maxLevel), 1.0), 0.0);
-	double newBlue = std::max(std::min(std::pow(blue, m_maxLevel), 1.0), 0.0);
-	
-	unsigned char r = static_cast<unsigned char>(newRed * 255.0);
-	unsigned char g = static_cast<unsigned char>(newGreen * 255.0);
-	unsigned char b = static_cast<unsigned char>(newBlue * 255.0);
-	
-	#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-		Uint32 pixelColor = (r << 24) + (g << 16) + (b << 8) + 255;
-	#else
-		Uint32 pixelColor = (255 << 24) + (b << 16) + (g << 8) + r;
-	#endif
-	
-	return pixelColor;
-}
-
-
-// *******************
-// Function to handle rendering a tile.
-void CApp::RenderTile(qbRT::DATA::tile *tile, std::atomic<int> *threadCounter, std::atomic<int> *tileFlag)
-{
-	tileFlag -> store(1, std::memory_order_release);
-	m_scene.RenderTile(tile);
-	int numActiveThreads = threadCounter -> load(std::memory_order_acquire);
-	threadCounter -> store(numActiveThreads-1, std::memory_order_release);
-	tileFlag -> store(2, std::memory_order_release);
-}
-
-// Function to reset the tile flags.
+// Function to reset the tiles and start rendering the frame again.
 void CApp::ResetTileFlags()
 {
-	for (int i=0; i<m_tiles.size(); ++i)
-	{
-		m_tileFlags.at(i) -> store(0, std::memory_order_release);
-		m_tiles.at(i).textureComplete = false;
-	}
+	if (m_tileScheduler.StartFrame())
+		m_frameStatsPrinted = false;
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -51,6 +51,7 @@
 #include "./qbRayTrace/qbLinAlg/qbVector2.hpp"
 #include "./qbRayTrace/qbLinAlg/qbVector3.hpp"
 #include "./qbRayTrace/qbLinAlg/qbVector4.hpp"
+#include "./qbRayTrace/qbThreads/tilescheduler.hpp"
 
 class CApp
 {
@@ -64,10 +65,6 @@ class CApp
 		void OnRender();
 		void OnExit();
 		
-		// **************
-		// Function to handle rendering a tile.
-		void RenderTile(qbRT::DATA::tile *tile, std::atomic<int> *threadCounter, std::atomic<int> *tileFlag);
-		
 	private:
 		void PrintVector(const qbVector3<double> &inputVector);
 		
@@ -83,8 +80,11 @@ class CApp
 		// Function to handle destroying the tile grid.
 		bool DestroyTileGrid();
 		
+		// Function to wake up the display thread when a tile is finished.
+		void PostTileEvent();
+		
 		// *************************************
-		// Function to reset the tile flags.
+		// Function to reset the tiles and start rendering the frame again.
 		void ResetTileFlags();		
 		
 	private:
@@ -95,21 +95,28 @@ class CApp
 			New code here to support tiles.
 			22/02/23
 		*/
-		// Array to store tiles.
-		std::vector<qbRT::DATA::tile> m_tiles;
-		
-		//std::vector<int> m_tileFlags;
-		std::vector<std::atomic<int> *> m_tileFlags;
-		
-		int m_numTilesX, m_numTilesY;
+		// The tile scheduler, which owns the tiles and the render threads.
+		qbRT::Threads::TileScheduler m_tileScheduler;
 		
 		// *****************************************
 		// Thread stuff.
-		int m_maxThreads = 6;
-		int m_numCurrentThreads = 0;
-		std::vector<int> m_tilesCurrentlyRendering;
-		std::vector<std::thread> m_threads;
-		std::atomic<int> *m_threadCounter;		
+		// The number of render threads to use (zero means use the number of hardware threads).
+		int m_numThreads = 0;
+		
+		// The order in which the tiles are rendered. Tiles nearest to the mouse
+		// cursor (or the center of the window, until the mouse moves) go first.
+		int m_tileOrder = qbRT::Threads::TILE_ORDER_CURSOR;
+		
+		// The SDL event used by the render threads to tell us that a tile is finished,
+		// and a flag to indicate that one of these events is already waiting.
+		Uint32 m_tileEventType = 0;
+		std::atomic<bool> m_tileEventPending {false};
+		
+		// The tiles collected from the scheduler in OnRender().
+		std::vector<int> m_completedTiles;
+		
+		// Flag to indicate that the statistics for the current frame have been printed.
+		bool m_frameStatsPrinted = false;
 		
 		// An instance of the scene class.
 		qbRT::Scene_E21 m_scene;
@@ -119,6 +126,9 @@ class CApp
 		SDL_Window *pWindow;
 		SDL_Renderer *pRenderer;
 		
+		// The texture that the frame buffer is copied into for display.
+		SDL_Texture *m_pFrameTexture;
+		
 		/*
 			New functions here to handle tile based rendering. This isn't much use
 			right now, but forms the basis for the multi-threading implementation
@@ -128,12 +138,6 @@ class CApp
 		// Display configuration.
 		int m_xSize, m_ySize;
 		
-		// Function to convert tile image to texture.
-		void ConvertImageToTexture(qbRT::DATA::tile &tile);
-		
-		// Function to handle converting colors from RGB to UINT32.
-		Uint32 ConvertColor(const double red, const double green, const double blue);
-		
 		// The value to be used for gamma-correction.
 		double m_maxLevel = 0.8;
 		
@@ -0,0 +1,322 @@
+/* ***********************************************************
+	qbRayCLI.cpp
+
+	A command-line front end for the ray tracer. This renders a
+	single frame through the same tile scheduler as the SDL2
+	application, writes the result to a BMP file and prints the
+	timing. It does not need a display, or SDL2.
+
+	Usage:
+		qbRayCLI [--width N] [--height N] [--threads N] [--scene NAME]
+		         [--output FILE] [--tile WxH] [--budget SECONDS]
+		         [--reflections N] [--refractions N] [--cull WEIGHT]
+		         [--roulette on|off] [--reference FILE]
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "./qbRayTrace/scene_E21.hpp"
+#include "./qbRayTrace/bitmap.hpp"
+#include "./qbRayTrace/qbThreads/tilescheduler.hpp"
+#include "./qbRayTrace/qbMaterials/materialbase.hpp"
+
+// Function to print the usage message.
+void PrintUsage(const char *programName)
+{
+	std::cout << "Usage: " << programName << " [options]" << std::endl;
+	std::cout << "  --width N          Image width in pixels (default 1280)." << std::endl;
+	std::cout << "  --height N         Image height in pixels (default 720)." << std::endl;
+	std::cout << "  --threads N        Number of render threads (default 0, one per hardware thread)." << std::endl;
+	std::cout << "  --scene NAME       Scene to render (default E21)." << std::endl;
+	std::cout << "  --output FILE      Output BMP file (default qbRay.bmp)." << std::endl;
+	std::cout << "  --tile WxH         Tile size in pixels (default 128x90)." << std::endl;
+	std::cout << "  --budget SECONDS   Time budget for a tile before it is split (default 0.05, 0 disables splitting)." << std::endl;
+	std::cout << "  --secondary MODE   How reflected and refracted rays are traced: immediate, or binned per tile (default immediate)." << std::endl;
+	std::cout << "  --pipeline NAME    Renderer to use: recursive (one pixel at a time), or wavefront (default recursive)." << std::endl;
+	std::cout << "  --reflections N    Maximum number of reflections along a path (default 3)." << std::endl;
+	std::cout << "  --refractions N    Maximum number of refractions along a path (default 8)." << std::endl;
+	std::cout << "  --cull WEIGHT      Skip reflected and refracted rays that carry less than this fraction of the pixel color (default 0, off)." << std::endl;
+	std::cout << "  --roulette on|off  Use Russian roulette rather than skipping the culled rays outright (default off)." << std::endl;
+	std::cout << "  --reference FILE   BMP file to compare the result against, to report the image error." << std::endl;
+}
+
+// Function to create the scene with the given name.
+std::unique_ptr<qbRT::Scene> CreateScene(const std::string &sceneName)
+{
+	if (sceneName == "E21")
+		return std::make_unique<qbRT::Scene_E21>();
+
+	return nullptr;
+}
+
+// Function to compare the frame buffer with a reference image, as the RMS and maximum error in any color component.
+bool ComputeImageError(const std::string &referenceFile, const qbRT::FrameBuffer &frameBuffer, double &rmsError, int &maxError)
+{
+	qbRT::Bitmap reference;
+	if (!reference.LoadBMP(referenceFile))
+		return false;
+
+	int xSize = frameBuffer.GetXSize();
+	int ySize = frameBuffer.GetYSize();
+	if ((reference.GetXSize() != xSize) || (reference.GetYSize() != ySize))
+		return false;
+
+	double sumSquaredError = 0.0;
+	maxError = 0;
+	for (int y=0; y<ySize; ++y)
+	{
+		const unsigned char *pixel = frameBuffer.GetPixels(0, y);
+		for (int x=0; x<xSize; ++x)
+		{
+			uint8_t referenceColor[4];
+			reference.GetPixel(x, y, referenceColor[0], referenceColor[1], referenceColor[2], referenceColor[3]);
+			for (int i=0; i<3; ++i)
+			{
+				int error = std::abs(static_cast<int>(pixel[i]) - static_cast<int>(referenceColor[i]));
+				sumSquaredError += static_cast<double>(error * error);
+				maxError = std::max(maxError, error);
+			}
+
+			pixel += 4;
+		}
+	}
+
+	rmsError = std::sqrt(sumSquaredError / (3.0 * static_cast<double>(xSize) * static_cast<double>(ySize)));
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int xSize = 1280;
+	int ySize = 720;
+	int numThreads = 0;
+	int tileSizeX = 128;
+	int tileSizeY = 90;
+	double tileBudget = 0.05;
+	bool binSecondaryRays = false;
+	bool useWavefront = false;
+	int maxReflectionRays = 3;
+	int maxRefractionRays = 8;
+	double minRayWeight = 0.0;
+	bool russianRoulette = false;
+	std::string referenceFile;
+	std::string sceneName = "E21";
+	std::string outputFile = "qbRay.bmp";
+
+	// Parse the command line.
+	for (int i=1; i<argc; ++i)
+	{
+		std::string option = argv[i];
+		if ((option == "--help") || (option == "-h"))
+		{
+			PrintUsage(argv[0]);
+			return 0;
+		}
+
+		if ((i + 1) >= argc)
+		{
+			std::cout << "Missing value for " << option << "." << std::endl;
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		std::string value = argv[++i];
+		try
+		{
+			if (option == "--width")
+				xSize = std::stoi(value);
+			else if (option == "--height")
+				ySize = std::stoi(value);
+			else if (option == "--threads")
+				numThreads = std::stoi(value);
+			else if (option == "--scene")
+				sceneName = value;
+			else if (option == "--output")
+				outputFile = value;
+			else if (option == "--budget")
+				tileBudget = std::stod(value);
+			else if (option == "--secondary")
+			{
+				if ((value != "immediate") && (value != "binned"))
+					throw std::invalid_argument(value);
+
+				binSecondaryRays = (value == "binned");
+			}
+			else if (option == "--pipeline")
+			{
+				if ((value != "recursive") && (value != "wavefront"))
+					throw std::invalid_argument(value);
+
+				useWavefront = (value == "wavefront");
+			}
+			else if (option == "--reflections")
+				maxReflectionRays = std::stoi(value);
+			else if (option == "--refractions")
+				maxRefractionRays = std::stoi(value);
+			else if (option == "--cull")
+				minRayWeight = std::stod(value);
+			else if (option == "--roulette")
+			{
+				if ((value != "on") && (value != "off"))
+					throw std::invalid_argument(value);
+
+				russianRoulette = (value == "on");
+			}
+			else if (option == "--reference")
+				referenceFile = value;
+			else if (option == "--tile")
+			{
+				size_t separator = value.find('x');
+				if (separator == std::string::npos)
+					throw std::invalid_argument(value);
+
+				tileSizeX = std::stoi(value.substr(0, separator));
+				tileSizeY = std::stoi(value.substr(separator + 1));
+			}
+			else
+			{
+				std::cout << "Unknown option " << option << "." << std::endl;
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Invalid value " << value << " for " << option << "." << std::endl;
+			return 1;
+		}
+	}
+
+	if ((xSize < 1) || (ySize < 1) || (tileSizeX < 1) || (tileSizeY < 1))
+	{
+		std::cout << "The image and tile sizes must be at least one pixel." << std::endl;
+		return 1;
+	}
+
+	// Setup the scene.
+	auto setupStart = std::chrono::steady_clock::now();
+	std::unique_ptr<qbRT::Scene> scene = CreateScene(sceneName);
+	if (!scene)
+	{
+		std::cout << "Unknown scene " << sceneName << "." << std::endl;
+		return 1;
+	}
+
+	scene -> m_xSize = xSize;
+	scene -> m_ySize = ySize;
+	scene -> m_binSecondaryRays = binSecondaryRays;
+	scene -> m_useWavefront = useWavefront;
+
+	// The materials set up the default depth limits when they are created, so these go after the scene.
+	qbRT::MaterialBase::m_maxReflectionRays = maxReflectionRays;
+	qbRT::MaterialBase::m_maxRefractionRays = maxRefractionRays;
+	qbRT::MaterialBase::m_minRayWeight = minRayWeight;
+	qbRT::MaterialBase::m_russianRoulette = russianRoulette;
+
+	// Match the camera to the shape of the image, so that it isn't stretched.
+	scene -> m_camera.SetAspect(static_cast<double>(xSize) / static_cast<double>(ySize));
+	scene -> m_camera.UpdateCameraGeometry();
+	std::chrono::duration<double> setupTime = std::chrono::steady_clock::now() - setupStart;
+
+	// Setup the tile scheduler. The render threads wake us up each time they
+	// finish a tile, so that we can check whether the frame is complete.
+	qbRT::Threads::TileScheduler tileScheduler;
+	tileScheduler.m_tileBudget = tileBudget;
+	if (!tileScheduler.GenerateTileGrid(xSize, ySize, tileSizeX, tileSizeY))
+	{
+		std::cout << "Failed to generate tile grid." << std::endl;
+		return 1;
+	}
+
+	std::mutex frameMutex;
+	std::condition_variable frameCondition;
+	tileScheduler.SetTileCallback([&](int tileIndex)
+	{
+		std::lock_guard<std::mutex> lock(frameMutex);
+		frameCondition.notify_one();
+	});
+
+	if (!tileScheduler.Start(scene.get(), numThreads))
+	{
+		std::cout << "Failed to start the render threads." << std::endl;
+		return 1;
+	}
+
+	// Render the frame.
+	std::cout << "Rendering " << sceneName << " at " << xSize << " x " << ySize << "..." << std::endl;
+	auto renderStart = std::chrono::steady_clock::now();
+	tileScheduler.StartFrame();
+	{
+		std::unique_lock<std::mutex> lock(frameMutex);
+		frameCondition.wait(lock, [&]{ return tileScheduler.IsFrameComplete(); });
+	}
+	std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - renderStart;
+	tileScheduler.PrintStats();
+	tileScheduler.Stop();
+
+	// Write the result.
+	auto writeStart = std::chrono::steady_clock::now();
+	const qbRT::FrameBuffer &frameBuffer = tileScheduler.GetFrameBuffer();
+	if (!qbRT::Bitmap::SaveBMP(outputFile, frameBuffer.GetPixels(), frameBuffer.GetXSize(), frameBuffer.GetYSize(), frameBuffer.GetPitch()))
+	{
+		std::cout << "Failed to write " << outputFile << "." << std::endl;
+		return 1;
+	}
+	std::chrono::duration<double> writeTime = std::chrono::steady_clock::now() - writeStart;
+
+	// Report the timing.
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "Scene setup time: " << setupTime.count() << "s" << std::endl;
+	std::cout << "Rendering time: " << renderTime.count() << "s" << std::endl;
+	std::cout << "Output time: " << writeTime.count() << "s" << std::endl;
+	std::cout << "Wrote " << outputFile << "." << std::endl;
+
+	// If we were given a reference image, report how far this one is from it.
+	if (!referenceFile.empty())
+	{
+		double rmsError = 0.0;
+		int maxError = 0;
+		if (!ComputeImageError(referenceFile, frameBuffer, rmsError, maxError))
+		{
+			std::cout << "Failed to compare with " << referenceFile << "." << std::endl;
+			return 1;
+		}
+
+		std::cout << "Image error against " << referenceFile << ": RMS " << rmsError << ", max " << maxError << " (out of 255)." << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,303 @@
+/* ***********************************************************
+	bitmap.cpp
+
+	The Bitmap class implementation - A class to load and save images
+	in the Windows BMP format.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "bitmap.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// Functions to read and write little-endian values.
+static uint32_t ReadU32(const std::vector<uint8_t> &data, size_t offset)
+{
+	return static_cast<uint32_t>(data[offset]) | (static_cast<uint32_t>(data[offset+1]) << 8) |
+		(static_cast<uint32_t>(data[offset+2]) << 16) | (static_cast<uint32_t>(data[offset+3]) << 24);
+}
+
+static uint16_t ReadU16(const std::vector<uint8_t> &data, size_t offset)
+{
+	return static_cast<uint16_t>(data[offset] | (data[offset+1] << 8));
+}
+
+static void WriteU32(std::vector<uint8_t> &data, uint32_t value)
+{
+	for (int i=0; i<4; ++i)
+		data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+static void WriteU16(std::vector<uint8_t> &data, uint16_t value)
+{
+	data.push_back(static_cast<uint8_t>(value));
+	data.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+// Function to extract an 8-bit channel from a pixel, given its bit mask.
+static uint8_t ExtractChannel(uint32_t pixel, uint32_t mask, uint8_t defaultValue)
+{
+	if (mask == 0)
+		return defaultValue;
+
+	int shift = 0;
+	while (((mask >> shift) & 1) == 0)
+		shift++;
+
+	uint32_t maxValue = mask >> shift;
+	uint32_t value = (pixel & mask) >> shift;
+	return static_cast<uint8_t>(((value * 255) + (maxValue / 2)) / maxValue);
+}
+
+// Default constructor.
+qbRT::Bitmap::Bitmap()
+{
+
+}
+
+// Function to load a BMP file.
+bool qbRT::Bitmap::LoadBMP(const std::string &fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Failed to open " << fileName << "." << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	// Check the file header and the size of the info header.
+	if ((data.size() < 54) || (data[0] != 'B') || (data[1] != 'M'))
+	{
+		std::cout << fileName << " is not a BMP file." << std::endl;
+		return false;
+	}
+
+	uint32_t dataOffset = ReadU32(data, 10);
+	uint32_t headerSize = ReadU32(data, 14);
+	if (headerSize < 40)
+	{
+		std::cout << fileName << " uses an unsupported BMP header." << std::endl;
+		return false;
+	}
+
+	int xSize = static_cast<int32_t>(ReadU32(data, 18));
+	int ySize = static_cast<int32_t>(ReadU32(data, 22));
+	int bitsPerPixel = ReadU16(data, 28);
+	uint32_t compression = ReadU32(data, 30);
+	uint32_t numColors = ReadU32(data, 46);
+
+	// A negative height means that the rows are stored top row first.
+	bool topDown = (ySize < 0);
+	if (topDown)
+		ySize = -ySize;
+
+	// Work out where each channel is stored.
+	uint32_t rMask = 0, gMask = 0, bMask = 0, aMask = 0;
+	if (compression == 3)
+	{
+		// The masks come straight after the original 40 byte info header, either
+		// as part of a later version of the header or on their own.
+		if (data.size() < 70)
+			return false;
+
+		rMask = ReadU32(data, 54);
+		gMask = ReadU32(data, 58);
+		bMask = ReadU32(data, 62);
+		if (headerSize >= 56)
+			aMask = ReadU32(data, 66);
+	}
+	else if (compression == 0)
+	{
+		if (bitsPerPixel == 16)
+		{
+			rMask = 0x7C00;
+			gMask = 0x03E0;
+			bMask = 0x001F;
+		}
+		else if ((bitsPerPixel == 24) || (bitsPerPixel == 32))
+		{
+			rMask = 0x00FF0000;
+			gMask = 0x0000FF00;
+			bMask = 0x000000FF;
+		}
+	}
+	else
+	{
+		std::cout << fileName << " is compressed, which is not supported." << std::endl;
+		return false;
+	}
+
+	if ((xSize <= 0) || (ySize <= 0) || !((bitsPerPixel == 8) || (bitsPerPixel == 16) || (bitsPerPixel == 24) || (bitsPerPixel == 32)))
+	{
+		std::cout << fileName << " has an unsupported format (" << bitsPerPixel << " bits per pixel)." << std::endl;
+		return false;
+	}
+
+	// The palette (for 8-bit images) follows the info header.
+	std::vector<uint32_t> palette;
+	if (bitsPerPixel == 8)
+	{
+		if (numColors == 0)
+			numColors = 256;
+
+		size_t paletteOffset = 14 + headerSize;
+		for (uint32_t i=0; (i<numColors) && ((paletteOffset + (4 * (i + 1))) <= data.size()); ++i)
+			palette.push_back(ReadU32(data, paletteOffset + (4 * i)));
+	}
+
+	// Each row is padded to a multiple of four bytes.
+	int bytesPerPixel = bitsPerPixel / 8;
+	size_t rowSize = ((static_cast<size_t>(xSize) * bitsPerPixel + 31) / 32) * 4;
+	if ((dataOffset + (rowSize * ySize)) > data.size())
+	{
+		std::cout << fileName << " is truncated." << std::endl;
+		return false;
+	}
+
+	m_xSize = xSize;
+	m_ySize = ySize;
+	m_pixels.resize(static_cast<size_t>(xSize) * ySize * 4);
+	for (int y=0; y<ySize; ++y)
+	{
+		int fileRow = topDown ? y : (ySize - 1 - y);
+		size_t rowOffset = dataOffset + (fileRow * rowSize);
+		for (int x=0; x<xSize; ++x)
+		{
+			size_t pixelOffset = rowOffset + (x * bytesPerPixel);
+			uint8_t *pixel = &m_pixels[((static_cast<size_t>(y) * xSize) + x) * 4];
+			if (bitsPerPixel == 8)
+			{
+				uint8_t index = data[pixelOffset];
+				uint32_t color = (index < palette.size()) ? palette[index] : 0;
+				pixel[0] = static_cast<uint8_t>(color >> 16);
+				pixel[1] = static_cast<uint8_t>(color >> 8);
+				pixel[2] = static_cast<uint8_t>(color);
+				pixel[3] = 255;
+			}
+			else
+			{
+				uint32_t value = 0;
+				for (int i=0; i<bytesPerPixel; ++i)
+					value |= static_cast<uint32_t>(data[pixelOffset + i]) << (8 * i);
+
+				pixel[0] = ExtractChannel(value, rMask, 0);
+				pixel[1] = ExtractChannel(value, gMask, 0);
+				pixel[2] = ExtractChannel(value, bMask, 0);
+				pixel[3] = ExtractChannel(value, aMask, 255);
+			}
+		}
+	}
+
+	return true;
+}
+
+// Function to save the image as a BMP file.
+bool qbRT::Bitmap::SaveBMP(const std::string &fileName) const
+{
+	return SaveBMP(fileName, m_pixels.data(), m_xSize, m_ySize, m_xSize * 4);
+}
+
+// Function to save a block of RGBA pixels as a BMP file.
+bool qbRT::Bitmap::SaveBMP(const std::string &fileName, const unsigned char *pixels, int xSize, int ySize, int pitch)
+{
+	size_t rowSize = ((static_cast<size_t>(xSize) * 3) + 3) & ~static_cast<size_t>(3);
+	uint32_t imageSize = static_cast<uint32_t>(rowSize * ySize);
+
+	std::vector<uint8_t> data;
+	data.reserve(54 + imageSize);
+
+	// The file header.
+	data.push_back('B');
+	data.push_back('M');
+	WriteU32(data, 54 + imageSize);
+	WriteU32(data, 0);
+	WriteU32(data, 54);
+
+	// The info header.
+	WriteU32(data, 40);
+	WriteU32(data, static_cast<uint32_t>(xSize));
+	WriteU32(data, static_cast<uint32_t>(ySize));
+	WriteU16(data, 1);
+	WriteU16(data, 24);
+	WriteU32(data, 0);
+	WriteU32(data, imageSize);
+	WriteU32(data, 2835);
+	WriteU32(data, 2835);
+	WriteU32(data, 0);
+	WriteU32(data, 0);
+
+	// The pixels, bottom row first, in BGR order.
+	for (int y=ySize-1; y>=0; --y)
+	{
+		const unsigned char *row = pixels + (static_cast<size_t>(y) * pitch);
+		for (int x=0; x<xSize; ++x)
+		{
+			data.push_back(row[(x * 4) + 2]);
+			data.push_back(row[(x * 4) + 1]);
+			data.push_back(row[x * 4]);
+		}
+		for (size_t i=static_cast<size_t>(xSize) * 3; i<rowSize; ++i)
+			data.push_back(0);
+	}
+
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Failed to open " << fileName << " for writing." << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return static_cast<bool>(file);
+}
+
+// Function to return the value of a pixel.
+void qbRT::Bitmap::GetPixel(int x, int y, uint8_t &red, uint8_t &green, uint8_t &blue, uint8_t &alpha) const
+{
+	if ((x >= 0) && (x < m_xSize) && (y >= 0) && (y < m_ySize))
+	{
+		const uint8_t *pixel = &m_pixels[((static_cast<size_t>(y) * m_xSize) + x) * 4];
+		red = pixel[0];
+		green = pixel[1];
+		blue = pixel[2];
+		alpha = pixel[3];
+	}
+}
+
+// Functions to return the size of the image.
+int qbRT::Bitmap::GetXSize() const
+{
+	return m_xSize;
+}
+
+int qbRT::Bitmap::GetYSize() const
+{
+	return m_ySize;
+}
@@ -0,0 +1,82 @@
+/* ***********************************************************
+	bitmap.hpp
+
+	The Bitmap class definition - A class to load and save images
+	in the Windows BMP format, so that the ray tracer itself does
+	not depend on SDL2.
+
+	The pixels are stored as 8-bit RGBA, top row first.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace qbRT
+{
+	class Bitmap
+	{
+		public:
+			// Default constructor.
+			Bitmap();
+
+			/*
+				Function to load a BMP file. Uncompressed 8-bit (palette),
+				24-bit and 32-bit images are supported, as well as 16 and
+				32-bit images with bit-field masks.
+			*/
+			bool LoadBMP(const std::string &fileName);
+
+			// Function to save the image as a 24-bit BMP file.
+			bool SaveBMP(const std::string &fileName) const;
+
+			/*
+				Function to save a block of 8-bit RGBA pixels (for example from the
+				frame buffer) as a 24-bit BMP file, without having to copy them into
+				a Bitmap first. The pitch is the number of bytes in one row.
+			*/
+			static bool SaveBMP(const std::string &fileName, const unsigned char *pixels, int xSize, int ySize, int pitch);
+
+			// Function to return the value of a pixel. Pixels outside the image are left unchanged.
+			void GetPixel(int x, int y, uint8_t &red, uint8_t &green, uint8_t &blue, uint8_t &alpha) const;
+
+			// Functions to return the size of the image.
+			int GetXSize() const;
+			int GetYSize() const;
+
+		private:
+			std::vector<uint8_t> m_pixels;
+			int m_xSize = 0;
+			int m_ySize = 0;
+	};
+}
+
+#endif
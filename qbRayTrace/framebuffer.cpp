@@ -0,0 +1,145 @@
+/* ***********************************************************
+	framebuffer.cpp
+
+	The FrameBuffer class implementation - A class to hold the final,
+	8-bit RGBA pixels for the whole frame.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "framebuffer.hpp"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// Default constructor.
+qbRT::FrameBuffer::FrameBuffer()
+{
+	SetMaxLevel(m_maxLevel);
+}
+
+// Function to initialize the frame buffer.
+void qbRT::FrameBuffer::Initialize(int xSize, int ySize)
+{
+	m_xSize = std::max(xSize, 0);
+	m_ySize = std::max(ySize, 0);
+	m_pixels.assign(m_xSize * m_ySize * 4, 255);
+}
+
+// Function to set the value used for gamma-correction.
+void qbRT::FrameBuffer::SetMaxLevel(double maxLevel)
+{
+	m_maxLevel = maxLevel;
+
+	// The conversion that the thresholds must reproduce exactly.
+	auto convert = [maxLevel](double value)
+	{
+		double level = std::max(std::min(std::pow(value, maxLevel), 1.0), 0.0);
+		return static_cast<int>(static_cast<unsigned char>(level * 255.0));
+	};
+
+	/*
+		For each level, search for the smallest value that converts to at
+		least that level. Positive doubles sort in the same order as their
+		bit patterns, so we can bisect on the bit patterns themselves to
+		find the threshold exactly.
+	*/
+	const double one = 1.0;
+	std::uint64_t oneBits;
+	std::memcpy(&oneBits, &one, sizeof(double));
+
+	m_levelThresholds.at(0) = -INFINITY;
+	for (int i=1; i<256; ++i)
+	{
+		std::uint64_t lowBits = 0;
+		std::uint64_t highBits = oneBits;
+		while ((highBits - lowBits) > 1)
+		{
+			std::uint64_t midBits = lowBits + ((highBits - lowBits) / 2);
+			double midValue;
+			std::memcpy(&midValue, &midBits, sizeof(double));
+			if (convert(midValue) >= i)
+				highBits = midBits;
+			else
+				lowBits = midBits;
+		}
+		std::memcpy(&m_levelThresholds.at(i), &highBits, sizeof(double));
+	}
+}
+
+// Function to set a pixel.
+void qbRT::FrameBuffer::SetPixel(int x, int y, const qbVector3<double> &color)
+{
+	unsigned char *pixel = &m_pixels[((y * m_xSize) + x) * 4];
+	pixel[0] = ConvertComponent(color.m_x);
+	pixel[1] = ConvertComponent(color.m_y);
+	pixel[2] = ConvertComponent(color.m_z);
+	pixel[3] = 255;
+}
+
+// Function to return the pixels.
+const unsigned char* qbRT::FrameBuffer::GetPixels() const
+{
+	return m_pixels.data();
+}
+
+// Function to return the pixels, starting from the given position.
+const unsigned char* qbRT::FrameBuffer::GetPixels(int x, int y) const
+{
+	return m_pixels.data() + (((y * m_xSize) + x) * 4);
+}
+
+// Function to return the number of bytes in one row.
+int qbRT::FrameBuffer::GetPitch() const
+{
+	return m_xSize * 4;
+}
+
+// Functions to return the size of the frame buffer.
+int qbRT::FrameBuffer::GetXSize() const
+{
+	return m_xSize;
+}
+
+int qbRT::FrameBuffer::GetYSize() const
+{
+	return m_ySize;
+}
+
+// Function to convert a single color component to 8-bits.
+unsigned char qbRT::FrameBuffer::ConvertComponent(double value) const
+{
+	// Binary search of the thresholds. Anything that is not a number ends up as zero.
+	int level = 0;
+	for (int step=128; step>0; step/=2)
+	{
+		if (value >= m_levelThresholds[level + step])
+			level += step;
+	}
+
+	return static_cast<unsigned char>(level);
+}
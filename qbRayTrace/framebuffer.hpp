@@ -0,0 +1,95 @@
+/* ***********************************************************
+	framebuffer.hpp
+
+	The FrameBuffer class definition - A class to hold the final,
+	8-bit RGBA pixels for the whole frame. The render threads write
+	into the frame buffer directly, so the display only has to copy
+	the regions that have changed into a texture.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <vector>
+#include <array>
+#include "./qbLinAlg/qbVector3.hpp"
+
+namespace qbRT
+{
+	class FrameBuffer
+	{
+		public:
+			// Default constructor.
+			FrameBuffer();
+
+			// Function to initialize the frame buffer (all pixels are set to white).
+			void Initialize(int xSize, int ySize);
+
+			/*
+				Function to set the value used for gamma-correction. Each color
+				component c is converted to an 8-bit value as
+				255 * min(max(c^maxLevel, 0), 1).
+			*/
+			void SetMaxLevel(double maxLevel);
+
+			// Function to set a pixel. It is safe for different threads to set different pixels.
+			void SetPixel(int x, int y, const qbVector3<double> &color);
+
+			// Functions to return the pixels. Each pixel is four bytes, in the
+			// order R, G, B, A (SDL_PIXELFORMAT_RGBA32), with the rows packed
+			// one after the other.
+			const unsigned char* GetPixels() const;
+			const unsigned char* GetPixels(int x, int y) const;
+
+			// Function to return the number of bytes in one row.
+			int GetPitch() const;
+
+			// Functions to return the size of the frame buffer.
+			int GetXSize() const;
+			int GetYSize() const;
+
+		private:
+			// Function to convert a single color component to 8-bits.
+			unsigned char ConvertComponent(double value) const;
+
+		private:
+			std::vector<unsigned char> m_pixels;
+			int m_xSize = 0;
+			int m_ySize = 0;
+
+			/*
+				m_levelThresholds[i] is the smallest component value that converts to
+				an 8-bit value of at least i. This lets us do the conversion with a
+				binary search rather than calling std::pow() for every component.
+			*/
+			std::array<double, 256> m_levelThresholds;
+			double m_maxLevel = 0.8;
+	};
+}
+
+#endif
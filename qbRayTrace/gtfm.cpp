@@ -175,6 +175,42 @@ qbRT::Ray qbRT::GTform::Apply(const qbRT::Ray &inputRay, bool dirFlag)
 	return outputRay;
 }
 
+// Function to apply the transform to a packet of rays.
+qbRT::RayPacket qbRT::GTform::Apply(const qbRT::RayPacket &inputPacket, bool dirFlag)
+{
+	// Extract the top three rows of the matrix (the last row is always 0, 0, 0, 1).
+	const qbMatrix44<double> &matrix = dirFlag ? m_fwdtfm : m_bcktfm;
+	double m[3][4];
+	for (int row=0; row<3; ++row)
+		for (int col=0; col<4; ++col)
+			m[row][col] = matrix.GetElement(row, col);
+
+	/* Transform both points of every ray, summing in the same order as the
+		matrix / vector product so that each ray ends up exactly as it would
+		if it were transformed on its own. */
+	qbRT::RayPacket outputPacket;
+	for (int i=0; i<RAY_PACKET_SIZE; ++i)
+	{
+		double x1 = inputPacket.m_point1X[i];
+		double y1 = inputPacket.m_point1Y[i];
+		double z1 = inputPacket.m_point1Z[i];
+		double x2 = inputPacket.m_point2X[i];
+		double y2 = inputPacket.m_point2Y[i];
+		double z2 = inputPacket.m_point2Z[i];
+		outputPacket.m_point1X[i] = (m[0][0] * x1) + (m[0][1] * y1) + (m[0][2] * z1) + m[0][3];
+		outputPacket.m_point1Y[i] = (m[1][0] * x1) + (m[1][1] * y1) + (m[1][2] * z1) + m[1][3];
+		outputPacket.m_point1Z[i] = (m[2][0] * x1) + (m[2][1] * y1) + (m[2][2] * z1) + m[2][3];
+		outputPacket.m_point2X[i] = (m[0][0] * x2) + (m[0][1] * y2) + (m[0][2] * z2) + m[0][3];
+		outputPacket.m_point2Y[i] = (m[1][0] * x2) + (m[1][1] * y2) + (m[1][2] * z2) + m[1][3];
+		outputPacket.m_point2Z[i] = (m[2][0] * x2) + (m[2][1] * y2) + (m[2][2] * z2) + m[2][3];
+		outputPacket.m_labX[i] = outputPacket.m_point2X[i] - outputPacket.m_point1X[i];
+		outputPacket.m_labY[i] = outputPacket.m_point2Y[i] - outputPacket.m_point1Y[i];
+		outputPacket.m_labZ[i] = outputPacket.m_point2Z[i] - outputPacket.m_point1Z[i];
+	}
+
+	return outputPacket;
+}
+
 qbVector3<double> qbRT::GTform::Apply(const qbVector3<double> &inputVector, bool dirFlag)
 {
 	// Convert inputVector to a 4-element vector.
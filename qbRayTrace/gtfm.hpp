@@ -45,6 +45,7 @@
 #include "./qbLinAlg/qbMatrix33.hpp"
 #include "./qbLinAlg/qbMatrix44.hpp"
 #include "ray.hpp"
+#include "raypacket.hpp"
 
 namespace qbRT
 {
@@ -78,6 +79,7 @@ namespace qbRT
 			
 			// Function to apply the transform.
 			qbRT::Ray Apply(const qbRT::Ray &inputRay, bool dirFlag);
+			qbRT::RayPacket Apply(const qbRT::RayPacket &inputPacket, bool dirFlag);
 			qbVector3<double> Apply(const qbVector3<double> &inputVector, bool dirFlag);
 			qbVector3<double> ApplyNorm(const qbVector3<double> &inputVector);
 			
@@ -0,0 +1,127 @@
+/* ***********************************************************
+	mappedfile.cpp
+
+	The MappedFile class implementation - A class to map a file into
+	memory (read-only), so that its contents can be used in place.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "mappedfile.hpp"
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Default constructor.
+qbRT::MappedFile::MappedFile()
+{
+
+}
+
+// The destructor.
+qbRT::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// Move constructor.
+qbRT::MappedFile::MappedFile(qbRT::MappedFile &&other)
+{
+	*this = std::move(other);
+}
+
+// Move assignment.
+qbRT::MappedFile& qbRT::MappedFile::operator=(qbRT::MappedFile &&other)
+{
+	if (this != &other)
+	{
+		Close();
+		m_pData = other.m_pData;
+		m_size = other.m_size;
+		other.m_pData = nullptr;
+		other.m_size = 0;
+	}
+
+	return *this;
+}
+
+// Function to map a file.
+bool qbRT::MappedFile::Open(const std::string &fileName)
+{
+	Close();
+
+	int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileInfo;
+	if ((fstat(fileDescriptor, &fileInfo) != 0) || (fileInfo.st_size <= 0))
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	// The mapping stays valid after the file has been closed.
+	size_t size = static_cast<size_t>(fileInfo.st_size);
+	void *pData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+	if (pData == MAP_FAILED)
+		return false;
+
+	m_pData = pData;
+	m_size = size;
+	return true;
+}
+
+// Function to unmap the file.
+void qbRT::MappedFile::Close()
+{
+	if (m_pData != nullptr)
+		munmap(m_pData, m_size);
+
+	m_pData = nullptr;
+	m_size = 0;
+}
+
+// Function to check whether a file is mapped.
+bool qbRT::MappedFile::IsOpen() const
+{
+	return m_pData != nullptr;
+}
+
+// Function to return the start of the file.
+const unsigned char* qbRT::MappedFile::GetData() const
+{
+	return static_cast<const unsigned char*>(m_pData);
+}
+
+// Function to return the size of the file.
+size_t qbRT::MappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,76 @@
+/* ***********************************************************
+	mappedfile.hpp
+
+	The MappedFile class definition - A class to map a file into
+	memory (read-only), so that its contents can be used in place
+	without being read into memory first. Pages of the file are
+	only loaded when they are first touched, and are shared with
+	any other process that maps the same file.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+namespace qbRT
+{
+	class MappedFile
+	{
+		public:
+			// Default constructor.
+			MappedFile();
+
+			// The destructor (unmaps the file).
+			~MappedFile();
+
+			// The mapping can't be shared between two objects, but it can be handed from one to another.
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile &&other);
+			MappedFile& operator=(MappedFile &&other);
+
+			// Function to map a file, unmapping any file that is already mapped.
+			bool Open(const std::string &fileName);
+
+			// Function to unmap the file.
+			void Close();
+
+			// Functions to return the contents of the file.
+			bool IsOpen() const;
+			const unsigned char* GetData() const;
+			size_t GetSize() const;
+
+		private:
+			void *m_pData = nullptr;
+			size_t m_size = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,705 @@
+/* ***********************************************************
+	bvh.cpp
+
+	The BVH class implementation - A bounding volume hierarchy
+	over the objects in a scene.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "bvh.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Default constructor.
+qbRT::ACCEL::BVH::BVH()
+{
+
+}
+
+// The destructor.
+qbRT::ACCEL::BVH::~BVH()
+{
+
+}
+
+// Function to build the hierarchy.
+bool qbRT::ACCEL::BVH::Build(const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	Clear();
+
+	/*
+		Get the (cached) world-space box for each object. Objects with extents
+		that are too large to be useful (or that haven't been set at all, which
+		leaves them at the +/-1e6 that ObjectBase::TransformBounds() starts from)
+		are kept out of the hierarchy and tested against every ray instead.
+	*/
+	for (int objectIndex=0; objectIndex<static_cast<int>(objectList.size()); ++objectIndex)
+	{
+		qbRT::ObjectBase *object = objectList.at(objectIndex).get();
+		qbRT::DATA::aabb bounds = object -> GetWorldBounds();
+
+		bool isBounded = true;
+		double maxExtent = 0.0;
+		for (int i=0; i<3; ++i)
+		{
+			if (!(bounds.min[i] <= bounds.max[i]) || (std::abs(bounds.min[i]) >= BVH_UNBOUNDED_LIMIT) || (std::abs(bounds.max[i]) >= BVH_UNBOUNDED_LIMIT))
+				isBounded = false;
+			maxExtent = std::max(maxExtent, std::max(std::abs(bounds.min[i]), std::abs(bounds.max[i])));
+		}
+
+		if (!isBounded)
+		{
+			m_unboundedObjects.push_back(object);
+			m_unboundedIndices.push_back(objectIndex);
+			continue;
+		}
+
+		// Pad the box slightly, so that rounding errors can't make us miss a hit right on its surface.
+		double padding = 1e-6 * (1.0 + maxExtent);
+		for (int i=0; i<3; ++i)
+		{
+			bounds.min[i] -= padding;
+			bounds.max[i] += padding;
+		}
+
+		m_objects.push_back(object);
+		m_objectBounds.push_back(bounds);
+		m_objectIndices.push_back(objectIndex);
+	}
+
+	// Build the tree.
+	int numObjects = static_cast<int>(m_objects.size());
+	BuildHierarchy();
+	if (numObjects > 0)
+	{
+		// Put the objects into the order that the leaves refer to them in.
+		std::vector<qbRT::ObjectBase*> orderedObjects (numObjects);
+		std::vector<qbRT::DATA::aabb> orderedBounds (numObjects);
+		std::vector<int> orderedIndices (numObjects);
+		for (int i=0; i<numObjects; ++i)
+		{
+			orderedObjects.at(i) = m_objects.at(m_objectOrder.at(i));
+			orderedBounds.at(i) = m_objectBounds.at(m_objectOrder.at(i));
+			orderedIndices.at(i) = m_objectIndices.at(m_objectOrder.at(i));
+		}
+		m_objects.swap(orderedObjects);
+		m_objectBounds.swap(orderedBounds);
+		m_objectIndices.swap(orderedIndices);
+		m_objectOrder.clear();
+	}
+
+	m_isBuilt = true;
+
+	std::chrono::duration<double> buildTime = std::chrono::steady_clock::now() - startTime;
+	m_buildTime = buildTime.count();
+	return true;
+}
+
+// Function to build just the tree over a list of boxes.
+bool qbRT::ACCEL::BVH::BuildTree(const std::vector<qbRT::DATA::aabb> &primitiveBounds, std::vector<int> &primitiveOrder)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	Clear();
+
+	m_objectBounds = primitiveBounds;
+	BuildHierarchy();
+
+	// Hand back the order of the primitives, and release the copy of their boxes.
+	primitiveOrder.swap(m_objectOrder);
+	m_objectOrder.clear();
+	std::vector<qbRT::DATA::aabb>().swap(m_objectBounds);
+
+	m_isBuilt = true;
+
+	std::chrono::duration<double> buildTime = std::chrono::steady_clock::now() - startTime;
+	m_buildTime = buildTime.count();
+	return true;
+}
+
+// Function to discard the hierarchy.
+void qbRT::ACCEL::BVH::Clear()
+{
+	m_nodes.clear();
+	m_objects.clear();
+	m_objectBounds.clear();
+	m_objectIndices.clear();
+	m_objectOrder.clear();
+	m_unboundedObjects.clear();
+	m_unboundedIndices.clear();
+	m_isBuilt = false;
+	m_buildTime = 0.0;
+	m_numLeaves = 0;
+	m_maxDepth = 0;
+	m_numPrimitives = 0;
+}
+
+// Function to check whether the hierarchy has been built.
+bool qbRT::ACCEL::BVH::IsBuilt() const
+{
+	return m_isBuilt;
+}
+
+// Function to return the nodes.
+const std::vector<qbRT::ACCEL::bvhNode>& qbRT::ACCEL::BVH::GetNodes() const
+{
+	return m_nodes;
+}
+
+// Function to return the memory used by the nodes.
+size_t qbRT::ACCEL::BVH::GetNodeMemory() const
+{
+	return m_nodes.size() * sizeof(qbRT::ACCEL::bvhNode);
+}
+
+// Function to find the closest intersection.
+bool qbRT::ACCEL::BVH::Intersect(	const qbRT::Ray &castRay, const qbRT::ObjectBase *skipObject,
+																	qbRT::ObjectBase *&closestObject,
+																	qbRT::DATA::hitData &closestHitData) const
+{
+	/* As with the linear search, we ignore anything further away than 1e6
+		(measured in units of the ray direction, m_lab). */
+	int closestIndex;
+	qbRT::ObjectBase *pClosestObject = FindClosest(castRay, skipObject, 1e6 / castRay.m_lab.norm(), closestHitData, closestIndex);
+	if (pClosestObject == nullptr)
+		return false;
+
+	// Fill in the rest of the hit data, for the closest intersection only.
+	closestObject = pClosestObject;
+	closestObject -> FinalizeHit(castRay, closestHitData);
+	return true;
+}
+
+// Function to find the closest intersection, without finalizing it.
+qbRT::ObjectBase* qbRT::ACCEL::BVH::FindClosest(	const qbRT::Ray &castRay, const qbRT::ObjectBase *skipObject, double maxT,
+																									qbRT::DATA::hitData &closestHitData, int &closestIndex) const
+{
+	qbRT::DATA::hitData hitData;
+	qbRT::ObjectBase *pClosestObject = nullptr;
+	closestIndex = -1;
+
+	/*
+		Everything here is measured in units of the ray direction (m_lab), and
+		each object is only asked for intersections that are no further away
+		than the closest one found so far. As with a linear search, the first
+		hit is accepted even if it is exactly at maxT.
+	*/
+	double minT = maxT;
+
+	// Test the objects that aren't in the tree first, so that they can help to cull it.
+	for (int i=0; i<static_cast<int>(m_unboundedObjects.size()); ++i)
+	{
+		qbRT::ObjectBase *object = m_unboundedObjects[i];
+		if ((object != skipObject) && object -> TestIntersection(castRay, hitData, minT))
+		{
+			if ((closestIndex < 0) || (hitData.t < minT) || ((hitData.t == minT) && (m_unboundedIndices[i] < closestIndex)))
+			{
+				minT = hitData.t;
+				pClosestObject = object;
+				closestIndex = m_unboundedIndices[i];
+				closestHitData = hitData;
+			}
+		}
+	}
+
+	if (!m_nodes.empty())
+	{
+		qbRT::ACCEL::slabRay ray;
+		qbRT::ACCEL::SetupSlabRay(castRay, ray);
+
+		// Traverse the tree front-to-back, skipping any node that starts beyond the closest hit so far.
+		int nodeStack[2 * BVH_MAX_DEPTH + 2];
+		double nearStack[2 * BVH_MAX_DEPTH + 2];
+		int stackSize = 0;
+		double tNear, tFar;
+		if (qbRT::ACCEL::IntersectSlabs(m_nodes.at(0).bounds, ray, 0.0, minT, tNear, tFar))
+		{
+			nodeStack[stackSize] = 0;
+			nearStack[stackSize] = tNear;
+			++stackSize;
+		}
+
+		while (stackSize > 0)
+		{
+			--stackSize;
+			if (nearStack[stackSize] > minT)
+				continue;
+
+			const bvhNode &node = m_nodes[nodeStack[stackSize]];
+			if (node.numObjects > 0)
+			{
+				// A leaf, so test each of its objects.
+				for (int i=node.firstIndex; i<(node.firstIndex + node.numObjects); ++i)
+				{
+					qbRT::ObjectBase *object = m_objects[i];
+					if ((object != skipObject) && object -> TestIntersection(castRay, hitData, minT))
+					{
+						if ((closestIndex < 0) || (hitData.t < minT) || ((hitData.t == minT) && (m_objectIndices[i] < closestIndex)))
+						{
+							minT = hitData.t;
+							pClosestObject = object;
+							closestIndex = m_objectIndices[i];
+							closestHitData = hitData;
+						}
+					}
+				}
+			}
+			else
+			{
+				// Visit the nearest child first (so it goes onto the stack last).
+				double tNear1, tNear2;
+				bool hit1 = qbRT::ACCEL::IntersectSlabs(m_nodes[node.firstIndex].bounds, ray, 0.0, minT, tNear1, tFar);
+				bool hit2 = qbRT::ACCEL::IntersectSlabs(m_nodes[node.firstIndex + 1].bounds, ray, 0.0, minT, tNear2, tFar);
+				if (hit1 && hit2)
+				{
+					int nearChild = (tNear1 <= tNear2) ? node.firstIndex : node.firstIndex + 1;
+					int farChild = (tNear1 <= tNear2) ? node.firstIndex + 1 : node.firstIndex;
+					nodeStack[stackSize] = farChild;
+					nearStack[stackSize] = std::max(tNear1, tNear2);
+					++stackSize;
+					nodeStack[stackSize] = nearChild;
+					nearStack[stackSize] = std::min(tNear1, tNear2);
+					++stackSize;
+				}
+				else if (hit1)
+				{
+					nodeStack[stackSize] = node.firstIndex;
+					nearStack[stackSize] = tNear1;
+					++stackSize;
+				}
+				else if (hit2)
+				{
+					nodeStack[stackSize] = node.firstIndex + 1;
+					nearStack[stackSize] = tNear2;
+					++stackSize;
+				}
+			}
+		}
+	}
+
+	return pClosestObject;
+}
+
+// Function to find the closest intersection for each ray of a packet.
+void qbRT::ACCEL::BVH::IntersectPacket(	const qbRT::RayPacket &castPacket, qbRT::ObjectBase *closestObject[],
+																				qbRT::DATA::hitData closestHitData[], bool intersectionFound[]) const
+{
+	constexpr int N = qbRT::RAY_PACKET_SIZE;
+	qbRT::Ray castRays[N];
+	qbRT::DATA::hitData hitData[N];
+	bool validInt[N];
+	bool active[N];
+	double minT[N];
+	int closestIndex[N];
+	for (int i=0; i<N; ++i)
+	{
+		castRays[i] = castPacket.GetRay(i);
+
+		// As in Intersect(), we ignore anything further away than 1e6.
+		double labLength = sqrt(	(castPacket.m_labX[i] * castPacket.m_labX[i]) + (castPacket.m_labY[i] * castPacket.m_labY[i]) +
+															(castPacket.m_labZ[i] * castPacket.m_labZ[i]));
+		minT[i] = 1e6 / labLength;
+		closestIndex[i] = -1;
+		closestObject[i] = nullptr;
+		active[i] = true;
+	}
+
+	// Test the objects that aren't in the tree first, so that they can help to cull it.
+	for (int j=0; j<static_cast<int>(m_unboundedObjects.size()); ++j)
+	{
+		qbRT::ObjectBase *object = m_unboundedObjects[j];
+		object -> TestPacketIntersection(castPacket, minT, active, hitData, validInt);
+		for (int i=0; i<N; ++i)
+		{
+			if (validInt[i] && ((closestIndex[i] < 0) || (hitData[i].t < minT[i]) || ((hitData[i].t == minT[i]) && (m_unboundedIndices[j] < closestIndex[i]))))
+			{
+				minT[i] = hitData[i].t;
+				closestObject[i] = object;
+				closestIndex[i] = m_unboundedIndices[j];
+				closestHitData[i] = hitData[i];
+			}
+		}
+	}
+
+	if (!m_nodes.empty())
+	{
+		qbRT::ACCEL::slabPacket packet;
+		qbRT::ACCEL::SetupSlabPacket(castPacket, packet);
+
+		/*
+			Traverse the tree front-to-back (ordered by the nearest ray), keeping
+			track of where each ray enters the nodes on the stack. Rays that miss
+			a node are given an entry point of BVH_PACKET_MISS, so a ray takes part
+			in a node only if it enters it before any hit that it has already found,
+			and so each ray tests exactly the objects that it would have tested on
+			its own.
+		*/
+		int nodeStack[2 * BVH_MAX_DEPTH + 2];
+		double nearStack[2 * BVH_MAX_DEPTH + 2][N];
+		int stackSize = 0;
+		bool hit[N];
+		if (qbRT::ACCEL::IntersectSlabs(m_nodes.at(0).bounds, packet, minT, hit, nearStack[0]))
+		{
+			for (int i=0; i<N; ++i)
+				nearStack[0][i] = hit[i] ? nearStack[0][i] : BVH_PACKET_MISS;
+
+			nodeStack[0] = 0;
+			stackSize = 1;
+		}
+
+		double tNear1[N], tNear2[N];
+		bool hit1[N], hit2[N];
+		while (stackSize > 0)
+		{
+			--stackSize;
+			int numActive = 0;
+			int lastActive = 0;
+			for (int i=0; i<N; ++i)
+			{
+				active[i] = nearStack[stackSize][i] <= minT[i];
+				if (active[i])
+				{
+					++numActive;
+					lastActive = i;
+				}
+			}
+
+			if (numActive == 0)
+				continue;
+
+			const bvhNode &node = m_nodes[nodeStack[stackSize]];
+			if (node.numObjects > 0)
+			{
+				/* A leaf, so test each of its objects against the active rays. If the
+					rays have diverged so that only one of them is left, then it is
+					quicker to test it on its own. */
+				for (int j=node.firstIndex; j<(node.firstIndex + node.numObjects); ++j)
+				{
+					qbRT::ObjectBase *object = m_objects[j];
+					if (numActive == 1)
+					{
+						for (int i=0; i<N; ++i)
+							validInt[i] = false;
+						validInt[lastActive] = object -> TestIntersection(castRays[lastActive], hitData[lastActive], minT[lastActive]);
+					}
+					else
+					{
+						object -> TestPacketIntersection(castPacket, minT, active, hitData, validInt);
+					}
+
+					for (int i=0; i<N; ++i)
+					{
+						if (validInt[i] && ((closestIndex[i] < 0) || (hitData[i].t < minT[i]) || ((hitData[i].t == minT[i]) && (m_objectIndices[j] < closestIndex[i]))))
+						{
+							minT[i] = hitData[i].t;
+							closestObject[i] = object;
+							closestIndex[i] = m_objectIndices[j];
+							closestHitData[i] = hitData[i];
+						}
+					}
+				}
+			}
+			else
+			{
+				// Test both children against the active rays.
+				bool anyHit1 = qbRT::ACCEL::IntersectSlabs(m_nodes[node.firstIndex].bounds, packet, minT, hit1, tNear1);
+				bool anyHit2 = qbRT::ACCEL::IntersectSlabs(m_nodes[node.firstIndex + 1].bounds, packet, minT, hit2, tNear2);
+				if (!anyHit1 && !anyHit2)
+					continue;
+
+				double nearest1 = BVH_PACKET_MISS;
+				double nearest2 = BVH_PACKET_MISS;
+				for (int i=0; i<N; ++i)
+				{
+					tNear1[i] = (hit1[i] && active[i]) ? tNear1[i] : BVH_PACKET_MISS;
+					tNear2[i] = (hit2[i] && active[i]) ? tNear2[i] : BVH_PACKET_MISS;
+					nearest1 = std::min(nearest1, tNear1[i]);
+					nearest2 = std::min(nearest2, tNear2[i]);
+				}
+
+				// Push the nearer child last, so that it is visited first.
+				bool firstIsNearer = nearest1 <= nearest2;
+				for (int k=0; k<2; ++k)
+				{
+					bool pushFirst = (k == 0) ? !firstIsNearer : firstIsNearer;
+					const double *tNear = pushFirst ? tNear1 : tNear2;
+					if ((pushFirst ? nearest1 : nearest2) >= BVH_PACKET_MISS)
+						continue;
+
+					nodeStack[stackSize] = pushFirst ? node.firstIndex : node.firstIndex + 1;
+					for (int i=0; i<N; ++i)
+						nearStack[stackSize][i] = tNear[i];
+
+					++stackSize;
+				}
+			}
+		}
+	}
+
+	// Fill in the rest of the hit data, for the closest intersection of each ray only.
+	for (int i=0; i<N; ++i)
+	{
+		intersectionFound[i] = (closestObject[i] != nullptr);
+		if (intersectionFound[i])
+			closestObject[i] -> FinalizeHit(castRays[i], closestHitData[i]);
+	}
+}
+
+// Function to test whether the ray is blocked.
+bool qbRT::ACCEL::BVH::IsOccluded(const qbRT::Ray &castRay, double maxDist, const qbRT::ObjectBase *skipObject) const
+{
+	// Convert maxDist into units of the ray direction.
+	double labLength = castRay.m_lab.norm();
+	double maxT = (maxDist < std::numeric_limits<double>::max()) ? maxDist / labLength : maxDist;
+	return TestOcclusion(castRay, maxT, skipObject);
+}
+
+// Function to test whether the ray is blocked, with the limit in units of the ray direction.
+bool qbRT::ACCEL::BVH::TestOcclusion(const qbRT::Ray &castRay, double maxT, const qbRT::ObjectBase *skipObject) const
+{
+	for (auto &object : m_unboundedObjects)
+	{
+		if ((object != skipObject) && object -> TestOcclusion(castRay, maxT))
+			return true;
+	}
+
+	if (m_nodes.empty())
+		return false;
+
+	qbRT::ACCEL::slabRay ray;
+	qbRT::ACCEL::SetupSlabRay(castRay, ray);
+
+	// Any hit will do, so the order in which we visit the nodes doesn't matter.
+	int nodeStack[2 * BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	double tNear, tFar;
+	while (stackSize > 0)
+	{
+		const bvhNode &node = m_nodes[nodeStack[--stackSize]];
+		if (!qbRT::ACCEL::IntersectSlabs(node.bounds, ray, 0.0, maxT, tNear, tFar))
+			continue;
+
+		if (node.numObjects > 0)
+		{
+			for (int i=node.firstIndex; i<(node.firstIndex + node.numObjects); ++i)
+			{
+				qbRT::ObjectBase *object = m_objects[i];
+				if ((object != skipObject) && object -> TestOcclusion(castRay, maxT))
+					return true;
+			}
+		}
+		else
+		{
+			nodeStack[stackSize++] = node.firstIndex + 1;
+			nodeStack[stackSize++] = node.firstIndex;
+		}
+	}
+
+	return false;
+}
+
+// Function to print the build statistics.
+void qbRT::ACCEL::BVH::PrintStats() const
+{
+	double objectsPerLeaf = (m_numLeaves > 0) ? static_cast<double>(m_numPrimitives) / static_cast<double>(m_numLeaves) : 0.0;
+	std::cout << "BVH build time: " << std::fixed << std::setprecision(3) << m_buildTime * 1000.0 << "ms";
+	std::cout << " (" << m_numPrimitives << " objects, " << m_unboundedObjects.size() << " unbounded, ";
+	std::cout << m_nodes.size() << " nodes, " << m_numLeaves << " leaves, max depth " << m_maxDepth << ", ";
+	std::cout << std::setprecision(2) << objectsPerLeaf << " objects per leaf)" << std::endl;
+}
+
+// PRIVATE FUNCTIONS.
+// Function to build the tree over m_objectBounds.
+void qbRT::ACCEL::BVH::BuildHierarchy()
+{
+	m_numPrimitives = static_cast<int>(m_objectBounds.size());
+	if (m_numPrimitives == 0)
+		return;
+
+	m_objectOrder.resize(m_numPrimitives);
+	for (int i=0; i<m_numPrimitives; ++i)
+		m_objectOrder.at(i) = i;
+
+	m_nodes.reserve(2 * m_numPrimitives);
+	m_nodes.emplace_back();
+	BuildNode(0, 0, m_numPrimitives, 1);
+}
+
+// Function to build a node.
+void qbRT::ACCEL::BVH::BuildNode(int nodeIndex, int first, int count, int depth)
+{
+	m_maxDepth = std::max(m_maxDepth, depth);
+
+	// Compute the bounds of the objects in this node, and of their centroids.
+	qbRT::DATA::aabb bounds;
+	qbRT::DATA::aabb centroidBounds;
+	for (int i=first; i<(first + count); ++i)
+	{
+		const qbRT::DATA::aabb &objectBounds = m_objectBounds[m_objectOrder[i]];
+		GrowBounds(bounds, objectBounds);
+		for (int axis=0; axis<3; ++axis)
+		{
+			double centroid = 0.5 * (objectBounds.min[axis] + objectBounds.max[axis]);
+			centroidBounds.min[axis] = std::min(centroidBounds.min[axis], centroid);
+			centroidBounds.max[axis] = std::max(centroidBounds.max[axis], centroid);
+		}
+	}
+	m_nodes[nodeIndex].bounds = bounds;
+	m_nodes[nodeIndex].firstIndex = first;
+	m_nodes[nodeIndex].numObjects = count;
+
+	if ((count <= 1) || (depth >= BVH_MAX_DEPTH))
+	{
+		++m_numLeaves;
+		return;
+	}
+
+	/*
+		Find the best split using the surface area heuristic. The centroids
+		are sorted into bins along each axis and we evaluate splitting
+		between each pair of neighbouring bins. The cost of a split is the
+		cost of testing the two children, weighted by the probability of a
+		ray that hits this node also hitting each child (the ratio of their
+		surface areas).
+	*/
+	double parentArea = SurfaceArea(bounds);
+	double bestCost = std::numeric_limits<double>::max();
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis=0; axis<3; ++axis)
+	{
+		double axisMin = centroidBounds.min[axis];
+		double axisExtent = centroidBounds.max[axis] - axisMin;
+		if (axisExtent <= 1e-12)
+			continue;
+
+		qbRT::DATA::aabb binBounds[BVH_NUM_BINS];
+		int binCounts[BVH_NUM_BINS] = {0};
+		double binScale = static_cast<double>(BVH_NUM_BINS) / axisExtent;
+		for (int i=first; i<(first + count); ++i)
+		{
+			const qbRT::DATA::aabb &objectBounds = m_objectBounds[m_objectOrder[i]];
+			double centroid = 0.5 * (objectBounds.min[axis] + objectBounds.max[axis]);
+			int bin = std::min(BVH_NUM_BINS - 1, static_cast<int>((centroid - axisMin) * binScale));
+			binCounts[bin]++;
+			GrowBounds(binBounds[bin], objectBounds);
+		}
+
+		// Sweep from the right to get the area and count to the right of each split.
+		double rightAreas[BVH_NUM_BINS];
+		int rightCounts[BVH_NUM_BINS];
+		qbRT::DATA::aabb rightBounds;
+		int rightCount = 0;
+		for (int bin=BVH_NUM_BINS - 1; bin>0; --bin)
+		{
+			GrowBounds(rightBounds, binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightAreas[bin] = (rightCount > 0) ? SurfaceArea(rightBounds) : 0.0;
+			rightCounts[bin] = rightCount;
+		}
+
+		// Then from the left, evaluating each split as we go.
+		qbRT::DATA::aabb leftBounds;
+		int leftCount = 0;
+		for (int split=1; split<BVH_NUM_BINS; ++split)
+		{
+			GrowBounds(leftBounds, binBounds[split - 1]);
+			leftCount += binCounts[split - 1];
+			if ((leftCount == 0) || (rightCounts[split] == 0))
+				continue;
+
+			double cost = BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST *
+										((SurfaceArea(leftBounds) * leftCount) + (rightAreas[split] * rightCounts[split])) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// Make a leaf if we can't split the objects, or if it isn't worth it.
+	double leafCost = BVH_INTERSECTION_COST * count;
+	if ((bestAxis < 0) || ((bestCost >= leafCost) && (count <= BVH_MAX_LEAF_SIZE)))
+	{
+		++m_numLeaves;
+		return;
+	}
+
+	// Partition the objects about the chosen split.
+	double axisMin = centroidBounds.min[bestAxis];
+	double binScale = static_cast<double>(BVH_NUM_BINS) / (centroidBounds.max[bestAxis] - axisMin);
+	auto middle = std::partition(m_objectOrder.begin() + first, m_objectOrder.begin() + first + count,
+															[&](int objectIndex)
+															{
+																const qbRT::DATA::aabb &objectBounds = m_objectBounds[objectIndex];
+																double centroid = 0.5 * (objectBounds.min[bestAxis] + objectBounds.max[bestAxis]);
+																int bin = std::min(BVH_NUM_BINS - 1, static_cast<int>((centroid - axisMin) * binScale));
+																return bin < bestSplit;
+															});
+	int leftCount = static_cast<int>(middle - (m_objectOrder.begin() + first));
+	if ((leftCount == 0) || (leftCount == count))
+	{
+		++m_numLeaves;
+		return;
+	}
+
+	// Create the children (always next to each other) and build them.
+	int leftIndex = static_cast<int>(m_nodes.size());
+	m_nodes.emplace_back();
+	m_nodes.emplace_back();
+	m_nodes[nodeIndex].firstIndex = leftIndex;
+	m_nodes[nodeIndex].numObjects = 0;
+
+	BuildNode(leftIndex, first, leftCount, depth + 1);
+	BuildNode(leftIndex + 1, first + leftCount, count - leftCount, depth + 1);
+}
+
+// Function to grow a box to include another.
+void qbRT::ACCEL::BVH::GrowBounds(qbRT::DATA::aabb &bounds, const qbRT::DATA::aabb &other)
+{
+	for (int i=0; i<3; ++i)
+	{
+		bounds.min[i] = std::min(bounds.min[i], other.min[i]);
+		bounds.max[i] = std::max(bounds.max[i], other.max[i]);
+	}
+}
+
+// Function to compute the surface area of a box.
+double qbRT::ACCEL::BVH::SurfaceArea(const qbRT::DATA::aabb &bounds)
+{
+	double dx = bounds.max[0] - bounds.min[0];
+	double dy = bounds.max[1] - bounds.min[1];
+	double dz = bounds.max[2] - bounds.min[2];
+	return 2.0 * ((dx * dy) + (dy * dz) + (dz * dx));
+}
@@ -0,0 +1,181 @@
+/* ***********************************************************
+	bvh.hpp
+
+	The BVH class definition - A bounding volume hierarchy over
+	the objects in a scene.
+
+	The hierarchy is built from the world-space extents of each
+	object (see ObjectBase::GetWorldBounds()), using a binned version
+	of the surface area heuristic (SAH) to choose the splits. Rays
+	then only need to be tested against the objects whose boxes
+	they pass through, rather than against every object in the
+	scene.
+
+	Objects that have no useful extents (for example a plane that
+	has been scaled to act as an infinite ground plane) are kept
+	in a separate list and tested against every ray.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <memory>
+#include <vector>
+#include "../qbutils.hpp"
+#include "../ray.hpp"
+#include "../qbPrimatives/objectbase.hpp"
+#include "slab.hpp"
+
+namespace qbRT
+{
+	namespace ACCEL
+	{
+		// Constants to control the SAH build.
+		constexpr int BVH_NUM_BINS = 12;
+		constexpr int BVH_MAX_LEAF_SIZE = 4;
+		constexpr int BVH_MAX_DEPTH = 48;
+		constexpr double BVH_TRAVERSAL_COST = 0.125;
+		constexpr double BVH_INTERSECTION_COST = 1.0;
+
+		// Objects with extents beyond this are treated as unbounded.
+		constexpr double BVH_UNBOUNDED_LIMIT = 1e5;
+
+		// The entry point given to rays in a packet that miss a node.
+		constexpr double BVH_PACKET_MISS = 1e300;
+
+		// Structure for a single node of the hierarchy.
+		struct bvhNode
+		{
+			qbRT::DATA::aabb bounds;
+
+			/*
+				For an inner node, the index of the first child node (the second
+				child always follows the first). For a leaf, the index of the
+				first object in the leaf.
+			*/
+			int firstIndex = 0;
+
+			// The number of objects in a leaf (zero for an inner node).
+			int numObjects = 0;
+		};
+
+		class BVH
+		{
+			public:
+				// Constructor / destructor.
+				BVH();
+				~BVH();
+
+				// Function to build the hierarchy over the given objects.
+				bool Build(const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList);
+
+				/* Function to build just the tree, over a list of boxes (for primitives other than
+					objects, such as the triangles of a mesh). On return, primitiveOrder lists the
+					boxes in the order that the leaves refer to them in. */
+				bool BuildTree(const std::vector<qbRT::DATA::aabb> &primitiveBounds, std::vector<int> &primitiveOrder);
+
+				// Function to discard the hierarchy.
+				void Clear();
+
+				// Function to check whether the hierarchy has been built.
+				bool IsBuilt() const;
+
+				// Functions to return the nodes, and the memory that they use.
+				const std::vector<bvhNode>& GetNodes() const;
+				size_t GetNodeMemory() const;
+
+				// Function to find the closest object that the ray intersects with (skipping skipObject).
+				bool Intersect(	const qbRT::Ray &castRay, const qbRT::ObjectBase *skipObject,
+												qbRT::ObjectBase *&closestObject,
+												qbRT::DATA::hitData &closestHitData) const;
+
+				/* Function to find the closest object that the ray intersects with (skipping skipObject),
+					no further away than maxT (in units of castRay.m_lab). The hit data is not finalized,
+					and closestIndex is set to the position of the object in the list passed to Build(). */
+				qbRT::ObjectBase* FindClosest(	const qbRT::Ray &castRay, const qbRT::ObjectBase *skipObject, double maxT,
+																				qbRT::DATA::hitData &closestHitData, int &closestIndex) const;
+
+				/* Function to find the closest object that each ray of a packet intersects with. The
+					packet is traced through the tree together, visiting each node that any of its rays
+					pass through, so the rays should be coherent. The result for each ray is the same
+					as Intersect() would give. */
+				void IntersectPacket(	const qbRT::RayPacket &castPacket, qbRT::ObjectBase *closestObject[],
+															qbRT::DATA::hitData closestHitData[], bool intersectionFound[]) const;
+
+				// Function to test whether any object (other than skipObject) blocks the ray within maxDist of its start.
+				bool IsOccluded(const qbRT::Ray &castRay, double maxDist, const qbRT::ObjectBase *skipObject) const;
+
+				// As above, but with the limit given in units of castRay.m_lab.
+				bool TestOcclusion(const qbRT::Ray &castRay, double maxT, const qbRT::ObjectBase *skipObject) const;
+
+				// Function to print the statistics from the last build.
+				void PrintStats() const;
+
+			private:
+				// Function to build the tree over m_objectBounds, leaving the order of the leaves in m_objectOrder.
+				void BuildHierarchy();
+
+				// Function to build the node at nodeIndex from count objects starting at first.
+				void BuildNode(int nodeIndex, int first, int count, int depth);
+
+				// Functions to work with boxes.
+				static void GrowBounds(qbRT::DATA::aabb &bounds, const qbRT::DATA::aabb &other);
+				static double SurfaceArea(const qbRT::DATA::aabb &bounds);
+
+			private:
+				// The nodes, with the root first.
+				std::vector<bvhNode> m_nodes;
+
+				/*
+					The bounded objects, in the order referred to by the leaves, and
+					their boxes. We also keep the position of each object in the
+					original object list, so that when two objects are hit at the same
+					distance we can pick the same one as a linear search would.
+				*/
+				std::vector<qbRT::ObjectBase*> m_objects;
+				std::vector<qbRT::DATA::aabb> m_objectBounds;
+				std::vector<int> m_objectIndices;
+				std::vector<int> m_objectOrder;
+
+				// The objects that are tested against every ray (and their positions in the object list).
+				std::vector<qbRT::ObjectBase*> m_unboundedObjects;
+				std::vector<int> m_unboundedIndices;
+
+				// Flag to indicate that the hierarchy has been built.
+				bool m_isBuilt = false;
+
+				// Statistics from the last build.
+				double m_buildTime = 0.0;
+				int m_numLeaves = 0;
+				int m_maxDepth = 0;
+				int m_numPrimitives = 0;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,125 @@
+/* ***********************************************************
+	slab.cpp
+
+	Functions to test a ray against an axis-aligned bounding box
+	using the slab method.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "slab.hpp"
+#include <cmath>
+#include <algorithm>
+
+// Function to set up a slabRay.
+void qbRT::ACCEL::SetupSlabRay(const qbRT::Ray &castRay, qbRT::ACCEL::slabRay &ray)
+{
+	for (int i=0; i<3; ++i)
+	{
+		ray.origin[i] = castRay.m_point1.GetElement(i);
+
+		/* We can't rely on infinities (we build with -Ofast), so a direction
+			component of zero is replaced with a very small one instead. */
+		double d = castRay.m_lab.GetElement(i);
+		if (std::abs(d) < 1e-12)
+			d = (d < 0.0) ? -1e-12 : 1e-12;
+		ray.invDir[i] = 1.0 / d;
+	}
+}
+
+// Function to test a ray against a box (the slab method).
+bool qbRT::ACCEL::IntersectSlabs(	const qbRT::DATA::aabb &bounds, const qbRT::ACCEL::slabRay &ray, double tMin, double tMax,
+																	double &tNear, double &tFar)
+{
+	double t0 = tMin;
+	double t1 = tMax;
+	for (int i=0; i<3; ++i)
+	{
+		double tA = (bounds.min[i] - ray.origin[i]) * ray.invDir[i];
+		double tB = (bounds.max[i] - ray.origin[i]) * ray.invDir[i];
+		t0 = std::max(t0, std::min(tA, tB));
+		t1 = std::min(t1, std::max(tA, tB));
+	}
+
+	tNear = t0;
+	tFar = t1;
+	return t0 <= t1;
+}
+
+// Function to set up a slabPacket.
+void qbRT::ACCEL::SetupSlabPacket(const qbRT::RayPacket &castPacket, qbRT::ACCEL::slabPacket &packet)
+{
+	// The same as SetupSlabRay(), for each ray.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		double d[3] = {castPacket.m_labX[i], castPacket.m_labY[i], castPacket.m_labZ[i]};
+		for (int j=0; j<3; ++j)
+		{
+			if (std::abs(d[j]) < 1e-12)
+				d[j] = (d[j] < 0.0) ? -1e-12 : 1e-12;
+		}
+
+		packet.originX[i] = castPacket.m_point1X[i];
+		packet.originY[i] = castPacket.m_point1Y[i];
+		packet.originZ[i] = castPacket.m_point1Z[i];
+		packet.invDirX[i] = 1.0 / d[0];
+		packet.invDirY[i] = 1.0 / d[1];
+		packet.invDirZ[i] = 1.0 / d[2];
+	}
+}
+
+// Function to test a packet of rays against a box.
+bool qbRT::ACCEL::IntersectSlabs(	const qbRT::DATA::aabb &bounds, const qbRT::ACCEL::slabPacket &packet, const double tMax[],
+																	bool hit[], double tNear[])
+{
+	// Copy the bounds first, so that the compiler knows they can't be changed by the loop.
+	const double minX = bounds.min[0], minY = bounds.min[1], minZ = bounds.min[2];
+	const double maxX = bounds.max[0], maxY = bounds.max[1], maxZ = bounds.max[2];
+
+	double t0[qbRT::RAY_PACKET_SIZE], t1[qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		double tAX = (minX - packet.originX[i]) * packet.invDirX[i];
+		double tBX = (maxX - packet.originX[i]) * packet.invDirX[i];
+		double tAY = (minY - packet.originY[i]) * packet.invDirY[i];
+		double tBY = (maxY - packet.originY[i]) * packet.invDirY[i];
+		double tAZ = (minZ - packet.originZ[i]) * packet.invDirZ[i];
+		double tBZ = (maxZ - packet.originZ[i]) * packet.invDirZ[i];
+		t0[i] = std::max(std::max(std::max(0.0, std::min(tAX, tBX)), std::min(tAY, tBY)), std::min(tAZ, tBZ));
+		t1[i] = std::min(std::min(std::min(tMax[i], std::max(tAX, tBX)), std::max(tAY, tBY)), std::max(tAZ, tBZ));
+	}
+
+	// Kept out of the loop above, so that the loop can be vectorized.
+	bool anyHit = false;
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		hit[i] = t0[i] <= t1[i];
+		tNear[i] = t0[i];
+		anyHit |= hit[i];
+	}
+
+	return anyHit;
+}
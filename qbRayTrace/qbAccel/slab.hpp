@@ -0,0 +1,86 @@
+/* ***********************************************************
+	slab.hpp
+
+	Functions to test a ray against an axis-aligned bounding box
+	using the slab method.
+
+	The ray is first converted into a slabRay, which holds the
+	start point and the reciprocal of the direction, so that the
+	same ray can be tested against many boxes without any
+	divisions. The test itself has no branches (other than the
+	final comparison) and returns the interval [tNear, tFar] over
+	which the ray is inside the box, measured in units of the ray
+	direction (m_lab), so that callers can use it to start and stop
+	their own searches.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "../qbutils.hpp"
+#include "../ray.hpp"
+#include "../raypacket.hpp"
+
+namespace qbRT
+{
+	namespace ACCEL
+	{
+		// Structure to hold a ray in the form used by the slab test.
+		struct slabRay
+		{
+			double origin[3];
+			double invDir[3];
+		};
+
+		// Function to set up a slabRay from a ray.
+		void SetupSlabRay(const qbRT::Ray &castRay, slabRay &ray);
+
+		/* Function to test a ray against a box, considering only tMin <= t <= tMax.
+			If the ray passes through the box, tNear and tFar are set to the part
+			of that range that is inside the box. */
+		bool IntersectSlabs(	const qbRT::DATA::aabb &bounds, const slabRay &ray, double tMin, double tMax,
+													double &tNear, double &tFar);
+
+		// Structure to hold a packet of rays in the form used by the slab test.
+		struct slabPacket
+		{
+			double originX[qbRT::RAY_PACKET_SIZE], originY[qbRT::RAY_PACKET_SIZE], originZ[qbRT::RAY_PACKET_SIZE];
+			double invDirX[qbRT::RAY_PACKET_SIZE], invDirY[qbRT::RAY_PACKET_SIZE], invDirZ[qbRT::RAY_PACKET_SIZE];
+		};
+
+		// Function to set up a slabPacket from a packet of rays.
+		void SetupSlabPacket(const qbRT::RayPacket &castPacket, slabPacket &packet);
+
+		/* Function to test every ray of a packet against a box, considering only
+			0 <= t <= tMax[i] for ray i. This gives exactly the same result for each
+			ray as IntersectSlabs(). Returns true if any of the rays hit the box. */
+		bool IntersectSlabs(const qbRT::DATA::aabb &bounds, const slabPacket &packet, const double tMax[], bool hit[], double tNear[]);
+	}
+}
+
+#endif
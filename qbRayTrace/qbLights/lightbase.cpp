@@ -51,8 +51,41 @@ qbRT::LightBase::~LightBase()
 // Function to compute illumination.
 bool qbRT::LightBase::ComputeIllumination(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																						const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																						const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																						qbRT::ObjectBase *currentObject,
+																						qbVector3<double> &color, double &intensity,
+																						const qbRT::DATA::shadingContext &context)
+{
+	return false;
+}
+
+// Function to compute illumination from a light sample.
+bool qbRT::LightBase::ComputeIllumination(	const qbRT::DATA::lightSample &lightSample, const qbVector3<double> &localNormal,
 																						qbVector3<double> &color, double &intensity)
 {
 	return false;
 }
+
+// Function to sample the light from a point.
+void qbRT::LightBase::SampleLight(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																		const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+																		const qbRT::ObjectBase *currentObject, const qbRT::DATA::shadingContext &context,
+																		qbRT::DATA::lightSample &lightSample)
+{
+	qbVector3<double> lightVector = m_location - intPoint;
+	lightSample.lightDist = lightVector.norm();
+	lightSample.lightDir = lightVector.Normalized();
+	
+	// Lights that don't need a shadow ray are never occluded.
+	qbRT::DATA::shadowRay shadowRay;
+	if (ComputeShadowRay(intPoint, localNormal, currentObject, shadowRay))
+		lightSample.occluded = qbRT::ShadowCache::IsOccluded(shadowRay, objectList, context);
+	else
+		lightSample.occluded = false;
+}
+
+// Function to compute the shadow ray.
+bool qbRT::LightBase::ComputeShadowRay(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																				const qbRT::ObjectBase *currentObject, qbRT::DATA::shadowRay &shadowRay)
+{
+	return false;
+}
@@ -40,9 +40,24 @@
 #include "../qbLinAlg/qbVector.h"
 #include "../ray.hpp"
 #include "../qbPrimatives/objectbase.hpp"
+#include "../shadowcache.hpp"
 
 namespace qbRT
 {
+	namespace DATA
+	{
+		/* Structure for what a point sees of one light: the direction (a unit vector) and distance
+			to the light, and whether anything is in the way. This is worked out once for each light
+			(see LightBase::SampleLight()) and then shared by all of the lighting terms at the point,
+			so that each shadow ray is only tested once. */
+		struct lightSample
+		{
+			qbVector3<double> lightDir {3};
+			double lightDist = 0.0;
+			bool occluded = false;
+		};
+	}
+
 	class LightBase
 	{
 		public:
@@ -53,8 +68,25 @@ namespace qbRT
 			// Function to compute illumination contribution.
 			virtual bool ComputeIllumination(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																				const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																				const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																				qbRT::ObjectBase *currentObject,
+																				qbVector3<double> &color, double &intensity,
+																				const qbRT::DATA::shadingContext &context);
+			
+			// Function to compute the illumination contribution from a light sample taken at the point.
+			virtual bool ComputeIllumination(	const qbRT::DATA::lightSample &lightSample, const qbVector3<double> &localNormal,
 																				qbVector3<double> &color, double &intensity);
+			
+			/* Function to sample this light from a point, testing the shadow ray returned by
+				ComputeShadowRay() (if there is one). */
+			void SampleLight(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+												const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+												const qbRT::ObjectBase *currentObject, const qbRT::DATA::shadingContext &context,
+												qbRT::DATA::lightSample &lightSample);
+			
+			/* Function to compute the shadow ray that ComputeIllumination() tests, so that it can be
+				traced in advance. Returns false if the light doesn't need one. */
+			virtual bool ComputeShadowRay(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																			const qbRT::ObjectBase *currentObject, qbRT::DATA::shadowRay &shadowRay);
 																				
 		public:
 			qbVector3<double>	m_color			{3};
@@ -54,51 +54,29 @@ qbRT::PointLight::~PointLight()
 // Function to compute illumination.
 bool qbRT::PointLight::ComputeIllumination(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																						const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																						const std::shared_ptr<qbRT::ObjectBase> &currentObject,
-																						qbVector3<double> &color, double &intensity)
+																						qbRT::ObjectBase *currentObject,
+																						qbVector3<double> &color, double &intensity,
+																						const qbRT::DATA::shadingContext &context)
 {
-	// Construct a vector pointing from the intersection point to the light.
-	qbVector3<double> lightDir = (m_location - intPoint).Normalized();
-	double lightDist = (m_location - intPoint).norm();
-	
-	// Compute a starting point.
-	qbVector3<double> startPoint = intPoint + (localNormal * 0.001);
-	
-	// Construct a ray from the point of intersection to the light.
-	qbRT::Ray lightRay (startPoint, startPoint + lightDir);
-	
-	/* Check for intersections with all of the objects
-		in the scene, except for the current one. */
-	qbRT::DATA::hitData hitData;
-	bool validInt = false;
-	for (auto sceneObject : objectList)
-	{
-		if (sceneObject != currentObject)
-		{
-			validInt = sceneObject -> TestIntersection(lightRay, hitData);
-			if (validInt)
-			{
-				double dist = (hitData.poi - startPoint).norm();
-				if (dist > lightDist)
-					validInt = false;
-			}
-		}
-		
-		/* If we have an intersection, then there is no point checking further
-			so we can break out of the loop. In other words, this object is
-			blocking light from this light source. */
-		if (validInt)
-			break;
-	}
+	/* Check for intersections with all of the objects in the scene, except
+		for the current one. */
+	qbRT::DATA::lightSample lightSample;
+	SampleLight(intPoint, localNormal, objectList, currentObject, context, lightSample);
+	return ComputeIllumination(lightSample, localNormal, color, intensity);
+}
 
+// Function to compute illumination from a light sample.
+bool qbRT::PointLight::ComputeIllumination(	const qbRT::DATA::lightSample &lightSample, const qbVector3<double> &localNormal,
+																						qbVector3<double> &color, double &intensity)
+{
 	/* Only continue to compute illumination if the light ray didn't
 		intersect with any objects in the scene. Ie. no objects are
 		casting a shadow from this light source. */
-	if (!validInt)
+	if (!lightSample.occluded)
 	{
 		// Compute the angle between the local normal and the light ray.
 		// Note that we assume that localNormal is a unit vector.
-		double angle = acos(qbVector3<double>::dot(localNormal, lightDir));
+		double angle = acos(qbVector3<double>::dot(localNormal, lightSample.lightDir));
 		
 		// If the normal is pointing away from the light, then we have no illumination.
 		if (angle > (M_PI/2.0))
@@ -125,22 +103,20 @@ bool qbRT::PointLight::ComputeIllumination(	const qbVector3<double> &intPoint, c
 	}
 }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+// Function to compute the shadow ray.
+bool qbRT::PointLight::ComputeShadowRay(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																					const qbRT::ObjectBase *currentObject, qbRT::DATA::shadowRay &shadowRay)
+{
+	// Construct a vector pointing from the intersection point to the light.
+	qbVector3<double> lightDir = (m_location - intPoint).Normalized();
+	double lightDist = (m_location - intPoint).norm();
+	
+	// Compute a starting point.
+	qbVector3<double> startPoint = intPoint + (localNormal * 0.001);
+	
+	// Construct a ray from the point of intersection to the light.
+	shadowRay.ray = qbRT::Ray (startPoint, startPoint + lightDir);
+	shadowRay.maxDist = lightDist;
+	shadowRay.skipObject = currentObject;
+	return true;
+}
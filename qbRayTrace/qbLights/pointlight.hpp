@@ -52,8 +52,17 @@ namespace qbRT
 			// Function to compute illumination.
 			virtual bool ComputeIllumination(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																				const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																				const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																				qbRT::ObjectBase *currentObject,
+																				qbVector3<double> &color, double &intensity,
+																				const qbRT::DATA::shadingContext &context) override;
+			
+			// Function to compute illumination from a light sample.
+			virtual bool ComputeIllumination(	const qbRT::DATA::lightSample &lightSample, const qbVector3<double> &localNormal,
 																				qbVector3<double> &color, double &intensity) override;
+			
+			// Function to compute the shadow ray.
+			virtual bool ComputeShadowRay(	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																			const qbRT::ObjectBase *currentObject, qbRT::DATA::shadowRay &shadowRay) override;
 	};
 }
 
@@ -33,12 +33,16 @@
 // materialbase.cpp
 
 #include "materialbase.hpp"
+#include "../qbAccel/bvh.hpp"
+#include "../rayqueue.hpp"
+#include "../raystack.hpp"
+#include <limits>
+#include <cstdint>
 
 // Constructor / destructor.
 qbRT::MaterialBase::MaterialBase()
 {
 	m_maxReflectionRays = 3;
-	m_reflectionRayCount = 0;
 }
 
 qbRT::MaterialBase::~MaterialBase()
@@ -49,10 +53,10 @@ qbRT::MaterialBase::~MaterialBase()
 // Function to compute the color of the material.
 qbVector3<double> qbRT::MaterialBase::ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																										const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																										const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																										qbRT::ObjectBase *currentObject,
 																										const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																										const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																										const qbRT::Ray &cameraRay)
+																										const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context)
 {
 	// Define an initial material color.
 	qbVector3<double> matColor;
@@ -63,9 +67,18 @@ qbVector3<double> qbRT::MaterialBase::ComputeColor(	const std::vector<std::share
 // Function to compute the diffuse color.
 qbVector3<double> qbRT::MaterialBase::ComputeDiffuseColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																													const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																													const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																													qbRT::ObjectBase *currentObject,
 																													const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																													const qbVector3<double> &baseColor)
+																													const qbVector3<double> &baseColor, const qbRT::DATA::shadingContext &context)
+{
+	// Each light is sampled once, and the diffuse color computed from that.
+	return ComputeDiffuseColor(lightList, SampleLights(objectList, lightList, intPoint, localNormal, context), localNormal, baseColor);
+}
+
+// Function to compute the diffuse color from the light samples.
+qbVector3<double> qbRT::MaterialBase::ComputeDiffuseColor(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																													const std::vector<qbRT::DATA::lightSample> &lightSamples,
+																													const qbVector3<double> &localNormal, const qbVector3<double> &baseColor)
 {
 	// Compute the color due to diffuse illumination.
 	qbVector3<double> diffuseColor;
@@ -76,9 +89,9 @@ qbVector3<double> qbRT::MaterialBase::ComputeDiffuseColor(	const std::vector<std
 	double blue = 0.0;
 	bool validIllum = false;
 	bool illumFound = false;
-	for (auto currentLight : lightList)
+	for (size_t i=0; i<lightList.size(); ++i)
 	{
-		validIllum = currentLight -> ComputeIllumination(intPoint, localNormal, objectList, NULL, color, intensity);
+		validIllum = lightList[i] -> ComputeIllumination(lightSamples[i], localNormal, color, intensity);
 		if (validIllum)
 		{
 			illumFound = true;
@@ -106,15 +119,38 @@ qbVector3<double> qbRT::MaterialBase::ComputeDiffuseColor(	const std::vector<std
 	
 }
 
+// Function to sample each of the lights from a point.
+const std::vector<qbRT::DATA::lightSample>& qbRT::MaterialBase::SampleLights(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+																																							const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																																							const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																																							const qbRT::DATA::shadingContext &context)
+{
+	/* This is called for every point that is shaded, so the buffer is kept from one call to
+		the next, rather than being allocated each time. */
+	thread_local std::vector<qbRT::DATA::lightSample> lightSamples;
+	
+	// The shadow rays are tested in the same order as GetDiffuseShadowRays() lists them.
+	lightSamples.resize(lightList.size());
+	for (size_t i=0; i<lightList.size(); ++i)
+		lightList[i] -> SampleLight(intPoint, localNormal, objectList, nullptr, context, lightSamples[i]);
+	
+	return lightSamples;
+}
+
 // Function to compute the color due to reflection.
 qbVector3<double> qbRT::MaterialBase::ComputeReflectionColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																															const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																															const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																															qbRT::ObjectBase *currentObject,
 																															const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																															const qbRT::Ray &incidentRay)
+																															const qbRT::Ray &incidentRay, qbRT::DATA::shadingContext &context)
 {
 	qbVector3<double> reflectionColor;
 	
+	// If this path has already been reflected as many times as we allow, then stop here.
+	qbVector3<double> matColor;
+	if (context.reflectionDepth >= m_maxReflectionRays)
+		return matColor;
+	
 	// Compute the reflection vector.
 	qbVector3<double> d = incidentRay.m_lab;
 	qbVector3<double> reflectionVector = d - (2.0 * qbVector3<double>::dot(d, localNormal) * localNormal);
@@ -123,19 +159,28 @@ qbVector3<double> qbRT::MaterialBase::ComputeReflectionColor(	const std::vector<
 	qbVector3<double> startPoint = intPoint + (localNormal * 0.001);
 	qbRT::Ray reflectionRay (startPoint, startPoint + reflectionVector);
 	
+	// The reflected ray gets its own context, one bounce further from the camera.
+	qbRT::DATA::shadingContext reflectionContext = ComputeSecondaryContext(context, qbRT::DATA::RAY_REFLECTION, m_reflectivity);
+	
+	// If the ray would add too little to the pixel to be worth tracing, then stop here.
+	double cullScale = CullRay(reflectionContext);
+	if (cullScale == 0.0)
+		return matColor;
+	
+	/* If the renderer will trace the ray for us, then hand it over. Its color will be added
+		to the pixel then, so it contributes nothing here. */
+	if (DeferRay(reflectionRay, nullptr, context, reflectionContext))
+		return matColor;
+	
 	/* Cast this ray into the scene and find the closest object that it intersects with. */
-	std::shared_ptr<qbRT::ObjectBase> closestObject;
+	qbRT::ObjectBase *closestObject = nullptr;
 	qbRT::DATA::hitData closestHitData;
-	bool intersectionFound = CastRay(reflectionRay, objectList, NULL, closestObject, closestHitData);
+	bool intersectionFound = CastRay(reflectionRay, objectList, NULL, closestObject, closestHitData, context);
 	
 	/* Compute illumination for closest object assuming that there was a
 		valid intersection. */
-	qbVector3<double> matColor;
-	if ((intersectionFound) && (m_reflectionRayCount < m_maxReflectionRays))
+	if (intersectionFound)
 	{
-		// Increment the reflectionRayCount.
-		m_reflectionRayCount++;
-		
 		// Check if a material has been assigned.
 		if (closestHitData.hitObject -> m_hasMaterial)
 		{
@@ -144,13 +189,14 @@ qbVector3<double> qbRT::MaterialBase::ComputeReflectionColor(	const std::vector<
 																																					closestHitData.hitObject, closestHitData.poi, 
 																																					closestHitData.normal, 
 																																					closestHitData.localPOI,
-																																					closestHitData.uvCoords, reflectionRay);
+																																					closestHitData.uvCoords, reflectionRay,
+																																					reflectionContext);
 		}
 		else
 		{
 			matColor = qbRT::MaterialBase::ComputeDiffuseColor(	objectList, lightList, closestHitData.hitObject, 
 																													closestHitData.poi, closestHitData.normal, 
-																													closestObject->m_baseColor);			
+																													closestObject->m_baseColor, reflectionContext);			
 		}
 	}
 	else
@@ -158,50 +204,152 @@ qbVector3<double> qbRT::MaterialBase::ComputeReflectionColor(	const std::vector<
 		// Leave matColor as it is.
 	}
 	
-	reflectionColor = matColor;
+	reflectionColor = matColor * cullScale;
 	return reflectionColor;
 }
 
+// Function to set up the shading context for a reflected or refracted ray.
+qbRT::DATA::shadingContext qbRT::MaterialBase::ComputeSecondaryContext(const qbRT::DATA::shadingContext &context, int rayType, double fraction)
+{
+	qbRT::DATA::shadingContext rayContext;
+	rayContext.depth = context.depth + 1;
+	rayContext.reflectionDepth = context.reflectionDepth;
+	rayContext.refractionDepth = context.refractionDepth;
+	if (rayType == qbRT::DATA::RAY_REFLECTION)
+		++rayContext.reflectionDepth;
+	else
+		++rayContext.refractionDepth;
+		
+	rayContext.weight = context.weight * fraction;
+	rayContext.rayType = rayType;
+	rayContext.bvh = context.bvh;
+	rayContext.pixelIndex = context.pixelIndex;
+	rayContext.imageIndex = context.imageIndex;
+	
+	return rayContext;
+}
+
+// Function to decide whether a reflected or refracted ray is worth tracing.
+double qbRT::MaterialBase::CullRay(qbRT::DATA::shadingContext &rayContext)
+{
+	++m_rayStats.secondaryRays;
+	if (rayContext.weight >= m_minRayWeight)
+		return 1.0;
+	
+	// Without Russian roulette, the ray is simply dropped.
+	if (!m_russianRoulette)
+	{
+		++m_rayStats.culledRays;
+		return 0.0;
+	}
+	
+	/* Otherwise it survives with a probability proportional to its weight. The random number
+		is a hash of the pixel and the ray's place in the path, so that it doesn't matter which
+		thread renders the pixel, or in what order. */
+	uint32_t hash = static_cast<uint32_t>(rayContext.imageIndex);
+	for (int value : {rayContext.reflectionDepth, rayContext.refractionDepth, rayContext.rayType})
+	{
+		hash ^= static_cast<uint32_t>(value) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+		hash ^= hash >> 16;
+		hash *= 0x7feb352du;
+		hash ^= hash >> 15;
+		hash *= 0x846ca68bu;
+		hash ^= hash >> 16;
+	}
+	double randomValue = static_cast<double>(hash) / 4294967296.0;
+	
+	double survivalProbability = rayContext.weight / m_minRayWeight;
+	if (randomValue >= survivalProbability)
+	{
+		++m_rayStats.culledRays;
+		return 0.0;
+	}
+	
+	// The rays that survive make up for the ones that didn't.
+	double cullScale = 1.0 / survivalProbability;
+	rayContext.weight *= cullScale;
+	return cullScale;
+}
+
+// Function to hand a reflected or refracted ray over to the renderer.
+bool qbRT::MaterialBase::DeferRay(	const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context,
+																		const qbRT::DATA::shadingContext &rayContext)
+{
+	// The queue (for binned rays) takes as many rays as we give it.
+	if (context.rayQueue != nullptr)
+	{
+		context.rayQueue -> Push(ray, skipObject, rayContext);
+		return true;
+	}
+	
+	// The stack has a fixed size, so it might be full.
+	if (context.rayStack != nullptr)
+		return context.rayStack -> Push(ray, skipObject, rayContext);
+		
+	return false;
+}
+
 // Function to cast a ray into the scene.
 bool qbRT::MaterialBase::CastRay( const qbRT::Ray &castRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																	const std::shared_ptr<qbRT::ObjectBase> &thisObject,
-																	std::shared_ptr<qbRT::ObjectBase> &closestObject,
-																	qbRT::DATA::hitData &closestHitData)
+																	qbRT::ObjectBase *thisObject,
+																	qbRT::ObjectBase *&closestObject,
+																	qbRT::DATA::hitData &closestHitData, const qbRT::DATA::shadingContext &context)
 {
-	// Test for intersections with all of the objects in the scene.
+	// If we have an acceleration structure, then use it to find the closest object.
+	if (context.bvh != nullptr)
+		return context.bvh -> Intersect(castRay, thisObject, closestObject, closestHitData);
+
+	// Otherwise, test for intersections with all of the objects in the scene.
 	qbRT::DATA::hitData hitData;
-	
-	double minDist = 1e6;
+	double minT = 1e6 / castRay.m_lab.norm();
 	bool intersectionFound = false;
-	for (auto currentObject : objectList)
+	for (auto &currentObject : objectList)
 	{
-		if (currentObject != thisObject)
+		if (currentObject.get() != thisObject)
 		{
-			bool validInt = currentObject -> TestIntersection(castRay, hitData);
+			// Only look for intersections that are no further away than the closest one found so far.
+			bool validInt = currentObject -> TestIntersection(castRay, hitData, minT);
 			
-			// If we have a valid intersection.
-			if (validInt)
+			// Store a reference to this object if it is the closest.
+			if (validInt && (hitData.t < minT))
 			{
-				// Set the flag to show that we found an intersection.
 				intersectionFound = true;
-				
-				// Compute the distance between the source and the intersection point.
-				double dist = (hitData.poi - castRay.m_point1).norm();
-				
-				// Store a reference to this object if it is the closest.
-				if (dist < minDist)
-				{
-					minDist = dist;
-					closestObject = currentObject;
-					closestHitData = hitData;
-				}
+				minT = hitData.t;
+				closestObject = currentObject.get();
+				closestHitData = hitData;
 			}
 		}
 	}
 	
+	// Fill in the rest of the hit data, for the closest intersection only.
+	if (intersectionFound)
+		closestObject -> FinalizeHit(castRay, closestHitData);
+	
 	return intersectionFound;
 }
 
+// Function to list the shadow rays that ComputeColor() will test.
+void qbRT::MaterialBase::GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																				const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																				const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays)
+{
+	// The base material doesn't test any.
+}
+
+// Function to list the shadow rays that ComputeDiffuseColor() will test.
+void qbRT::MaterialBase::GetDiffuseShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																								const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																								std::vector<qbRT::DATA::shadowRay> &shadowRays)
+{
+	// One for each light, in the same order as SampleLights() tests them.
+	qbRT::DATA::shadowRay shadowRay;
+	for (auto &currentLight : lightList)
+	{
+		if (currentLight -> ComputeShadowRay(intPoint, localNormal, nullptr, shadowRay))
+			shadowRays.push_back(shadowRay);
+	}
+}
+
 // Function to assign a texture.
 void qbRT::MaterialBase::AssignTexture(const std::shared_ptr<qbRT::Texture::TextureBase> &inputTexture)
 {
@@ -216,6 +364,13 @@ void qbRT::MaterialBase::AssignNormalMap(const std::shared_ptr<qbRT::Normal::Nor
 	m_hasNormalMap = true;
 }
 
+// Function to check whether the material uses UV coordinates.
+bool qbRT::MaterialBase::UsesUV() const
+{
+	// Both textures and normal maps are looked up by (u,v) coordinate.
+	return m_hasTexture || m_hasNormalMap;
+}
+
 // Function to return the color due to textures at the given (u,v) coordinate.
 qbVector3<double> qbRT::MaterialBase::GetTextureColor(const qbVector2<double> &uvCoords)
 {
@@ -267,9 +422,10 @@ qbVector3<double> qbRT::MaterialBase::PerturbNormal(const qbVector3<double> &nor
 // Function to compute combined specular and diffuse lighting components.
 qbVector3<double> qbRT::MaterialBase::ComputeSpecAndDiffuse(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																														const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																														const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																														qbRT::ObjectBase *currentObject,
 																														const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																														const qbVector3<double> &baseColor, const qbRT::Ray &cameraRay)
+																														const qbVector3<double> &baseColor, const qbRT::Ray &cameraRay,
+																														const qbRT::DATA::shadingContext &context)
 {
 	// Compute the color due to diffuse illumination and specular highlights.
 	qbVector3<double> outputColor;
@@ -286,9 +442,13 @@ qbVector3<double> qbRT::MaterialBase::ComputeSpecAndDiffuse(	const std::vector<s
 	double specB = 0.0;
 	bool validIllum = false;
 	bool illumFound = false;
-	for (auto currentLight : lightList)
+	
+	// Each light is sampled once, for both the diffuse and specular components.
+	const std::vector<qbRT::DATA::lightSample> &lightSamples = SampleLights(objectList, lightList, intPoint, localNormal, context);
+	for (size_t i=0; i<lightList.size(); ++i)
 	{
-		validIllum = currentLight -> ComputeIllumination(intPoint, localNormal, objectList, NULL, color, intensity);
+		const std::shared_ptr<qbRT::LightBase> &currentLight = lightList[i];
+		validIllum = currentLight -> ComputeIllumination(lightSamples[i], localNormal, color, intensity);
 		if (validIllum)
 		{
 			illumFound = true;
@@ -303,17 +463,8 @@ qbVector3<double> qbRT::MaterialBase::ComputeSpecAndDiffuse(	const std::vector<s
 			{
 				specIntensity = 0.0;
 				
-				// Construct a vector pointing from the intersection point to the light.
-				qbVector3<double> lightDir = (currentLight->m_location - intPoint).Normalized();
-				
-				// Compute a start point.
-				qbVector3<double> startPoint = intPoint + (lightDir * 0.001);
-				
-				// Construct a ray from the point of intersection to the light.
-				qbRT::Ray lightRay (startPoint, startPoint + lightDir);	
-				
-				// Compute the reflection vector.
-				qbVector3<double> d = lightRay.m_lab;
+				// Compute the reflection vector (of the direction to the light).
+				qbVector3<double> d = lightSamples[i].lightDir;
 				qbVector3<double> r = d - (2.0 * qbVector3<double>::dot(d, localNormal) * localNormal);
 				
 				// Compute the dot product.
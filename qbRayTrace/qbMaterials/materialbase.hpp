@@ -59,38 +59,81 @@ namespace qbRT
 			 and the UV coords respectively. */
 			virtual qbVector3<double> ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																							const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																							const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																							qbRT::ObjectBase *currentObject,
 																							const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																							const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																							const qbRT::Ray &cameraRay);
+																							const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context);
 																							
 			// Function to compute diffuse color.
 			static qbVector3<double> ComputeDiffuseColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																										const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																										const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																										qbRT::ObjectBase *currentObject,
 																										const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																										const qbVector3<double> &baseColor);
+																										const qbVector3<double> &baseColor, const qbRT::DATA::shadingContext &context);
+			
+			// Function to compute diffuse color from the light samples taken at the point (see SampleLights()).
+			static qbVector3<double> ComputeDiffuseColor(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																										const std::vector<qbRT::DATA::lightSample> &lightSamples,
+																										const qbVector3<double> &localNormal, const qbVector3<double> &baseColor);
+			
+			/* Function to sample each light in lightList from a point (see qbRT::DATA::lightSample), so
+				that every lighting term there can share the result of one shadow ray per light. The
+				samples are kept in a buffer that each thread reuses, so they are only valid until the
+				next call (on the same thread), and must be used up before shading anything else. */
+			static const std::vector<qbRT::DATA::lightSample>& SampleLights(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+																																	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																																	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																																	const qbRT::DATA::shadingContext &context);
 																										
 			// Function to compute the reflection color.
 			qbVector3<double> ComputeReflectionColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																								const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																								const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																								qbRT::ObjectBase *currentObject,
 																								const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																								const qbRT::Ray &incidentRay);
+																								const qbRT::Ray &incidentRay, qbRT::DATA::shadingContext &context);
 															
 			// *************************************************************************************																								
 			// Function that combines the computation of diffuse and specular components (faster).
 			qbVector3<double> ComputeSpecAndDiffuse(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																							const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																							const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																							qbRT::ObjectBase *currentObject,
 																							const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																							const qbVector3<double> &baseColor, const qbRT::Ray &cameraRay);																								
+																							const qbVector3<double> &baseColor, const qbRT::Ray &cameraRay,
+																							const qbRT::DATA::shadingContext &context);																								
 																										
+			/* Function to list the shadow rays that ComputeColor() will test at a point, in the order
+				that it will test them, so that they can be traced in advance (see qbRT::ShadowCache). */
+			virtual void GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																	const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays);
+			
+			// Function to list the shadow rays that SampleLights() will test.
+			static void GetDiffuseShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																				const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																				std::vector<qbRT::DATA::shadowRay> &shadowRays);
+										
+			/* Function to set up the shading context for a reflected or refracted ray (of the given
+				rayType) that carries the given fraction of the color seen along the current ray. */
+			static qbRT::DATA::shadingContext ComputeSecondaryContext(const qbRT::DATA::shadingContext &context, int rayType, double fraction);
+			
+			/* Function to decide whether a reflected or refracted ray adds enough to the pixel to be
+				worth tracing (see m_minRayWeight). Returns zero if the ray should be skipped. Otherwise,
+				returns the factor that the ray's color must be scaled by (more than one if it survived
+				Russian roulette), which has already been applied to the weight in rayContext. The roulette
+				is seeded from the pixel and the path, so it gives the same image however it is rendered. */
+			static double CullRay(qbRT::DATA::shadingContext &rayContext);
+			
+			/* Function to hand a reflected or refracted ray over to the renderer, to be traced later
+				(see qbRT::RayQueue and qbRT::RayStack). Returns false if there is nowhere to put it,
+				in which case the caller should trace the ray itself. */
+			static bool DeferRay(	const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context,
+														const qbRT::DATA::shadingContext &rayContext);
+										
 			// Function to cast a ray into the scene.
 			bool CastRay(	const qbRT::Ray &castRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-										const std::shared_ptr<qbRT::ObjectBase> &thisObject,
-										std::shared_ptr<qbRT::ObjectBase> &closestObject,
-										qbRT::DATA::hitData &closestHitData);
+										qbRT::ObjectBase *thisObject,
+										qbRT::ObjectBase *&closestObject,
+										qbRT::DATA::hitData &closestHitData, const qbRT::DATA::shadingContext &context);
 										
 			// Function to assign a texture.
 			void AssignTexture(const std::shared_ptr<qbRT::Texture::TextureBase> &inputTexture);
@@ -106,15 +149,26 @@ namespace qbRT
 			
 			// Function to blend RGBA colors (blends into color1).
 			void BlendColors(qbVector4<double> &color1, const qbVector4<double> &color2);			
+			
+			/* Function to check whether this material uses the UV coordinates of the
+				intersection, so that objects can avoid computing them when it doesn't. */
+			virtual bool UsesUV() const;
 										
 		public:
-			// Counter for the number of relection rays.
+			// The maximum number of reflections and refractions along a single path (see qbRT::DATA::shadingContext).
 			inline static int m_maxReflectionRays;
+			inline static int m_maxRefractionRays = 8;
+			
+			/* Reflected and refracted rays that carry less than this fraction of the pixel color (their
+				weight) are skipped, or, if m_russianRoulette is set, traced with a probability of
+				weight / m_minRayWeight and scaled up to match, which removes the bias at the cost of noise.
+				Zero (the default) traces every ray. */
+			inline static double m_minRayWeight = 0.0;
+			inline static bool m_russianRoulette = false;
 			
-			// ****
-			inline static int thread_local m_reflectionRayCount;
-			//inline static int m_reflectionRayCount;
-			// ****			
+			/* The number of reflected and refracted rays spawned, and how many of those were culled,
+				counted separately by each thread (see Scene::RenderTile()). */
+			inline static thread_local qbRT::DATA::rayStats m_rayStats;
 			
 			// The ambient lighting conditions.
 			inline static qbVector3<double> m_ambientColor {std::vector<double> {1.0, 1.0, 1.0}};
@@ -132,8 +186,8 @@ namespace qbRT
 			// *** Flag to indicate whether at least one normal map has been assigned.
 			bool m_hasNormalMap = false;
 		
-			// *** Store the material normal at the current point.
-			qbVector3<double> m_localNormal;		
+			// The reflectivity of the material.
+			double m_reflectivity = 0.0;
 			
 			// ***
 			// Values for specular hightlights.
@@ -33,6 +33,8 @@
 // simplematerial.cpp
 
 #include "simplematerial.hpp"
+#include "../qbAccel/bvh.hpp"
+#include <limits>
 
 qbRT::SimpleMaterial::SimpleMaterial()
 {
@@ -49,31 +51,21 @@ qbRT::SimpleMaterial::~SimpleMaterial()
  and the UV coords respectively. */
 qbVector3<double> qbRT::SimpleMaterial::ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																											const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																											const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																											qbRT::ObjectBase *currentObject,
 																											const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																											const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																											const qbRT::Ray &cameraRay)
+																											const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context)
 {
 	// Define the initial material colors.
 	qbVector3<double> matColor;
 	qbVector3<double> refColor;
 	qbVector3<double> difColor;
-	qbVector3<double> spcColor;
 	
 	// *** Apply any normals maps that may have been assigned.
-	qbVector3<double> newNormal = localNormal;
-	if (m_hasNormalMap)
-	{
-		qbVector3<double> upVector = std::vector<double> {0.0, 0.0, -1.0};
-		//newNormal = PerturbNormal(newNormal, currentObject -> m_uvCoords, upVector);
-		/* We modify this code to get the UV coords directly from the hitData structure,
-			as they are no longer stored in the object itself. */
-		newNormal = PerturbNormal(newNormal, uvCoords, upVector);
-		
-	}
+	qbVector3<double> newNormal = ComputeMaterialNormal(localNormal, uvCoords);
 	
 	// *** Store the current local normal, in case it is needed elsewhere.
-	m_localNormal = newNormal;	
+	context.localNormal = newNormal;	
 	
 	/* Note the change of localNormal to newNormal wherever the normal is used
 		in the code below. */
@@ -81,7 +73,7 @@ qbVector3<double> qbRT::SimpleMaterial::ComputeColor(	const std::vector<std::sha
 	// Compute the diffuse component.
 	if (!m_hasTexture)
 	{
-		difColor = ComputeSpecAndDiffuse(objectList, lightList, currentObject, intPoint, newNormal, m_baseColor, cameraRay);
+		difColor = ComputeSpecAndDiffuse(objectList, lightList, currentObject, intPoint, newNormal, m_baseColor, cameraRay, context);
 	}
 	else
 	{
@@ -89,125 +81,40 @@ qbVector3<double> qbRT::SimpleMaterial::ComputeColor(	const std::vector<std::sha
 		/* We modify this code to get the UV coords directly from the hitData structure,
 			as they are no longer stored in the object itself. */
 		qbVector3<double> textureColor = GetTextureColor(uvCoords);		
-		difColor = ComputeSpecAndDiffuse(objectList, lightList, currentObject, intPoint, newNormal, textureColor, cameraRay);		
+		difColor = ComputeSpecAndDiffuse(objectList, lightList, currentObject, intPoint, newNormal, textureColor, cameraRay, context);		
 	}
 	
 	// Compute the reflection component.
 	if (m_reflectivity > 0.0)
-		refColor = ComputeReflectionColor(objectList, lightList, currentObject, intPoint, newNormal, cameraRay);
+		refColor = ComputeReflectionColor(objectList, lightList, currentObject, intPoint, newNormal, cameraRay, context);
 		
 	// Combine reflection and diffuse components.
 	matColor = (refColor * m_reflectivity) + (difColor * (1 - m_reflectivity));
 	
-	/*
-	// Compute the specular component.
-	if (m_shininess > 0.0)
-		spcColor = ComputeSpecular(objectList, lightList, intPoint, newNormal, cameraRay);
-		
-	// Add the specular component to the final color.
-	matColor = matColor + spcColor;
-	*/
-	
 	return matColor;
 }
 
-// Function to compute the specular highlights.
-qbVector3<double> qbRT::SimpleMaterial::ComputeSpecular(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																												const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																												const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																												const qbRT::Ray &cameraRay)
+// Function to list the shadow rays that ComputeColor() will test.
+void qbRT::SimpleMaterial::GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																					const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																					const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays)
 {
-	qbVector3<double> spcColor	{3};
-	double red = 0.0;
-	double green = 0.0;
-	double blue = 0.0;
-	
-	// Loop through all of the lights in the scene.
-	for (auto currentLight : lightList)
+	// The lights are tested from the point with the normal maps applied (see ComputeSpecAndDiffuse()).
+	GetDiffuseShadowRays(lightList, intPoint, ComputeMaterialNormal(localNormal, uvCoords), shadowRays);
+}
+
+// Function to apply any normal maps to the object normal.
+qbVector3<double> qbRT::SimpleMaterial::ComputeMaterialNormal(const qbVector3<double> &localNormal, const qbVector2<double> &uvCoords)
+{
+	qbVector3<double> newNormal = localNormal;
+	if (m_hasNormalMap)
 	{
-		/* Check for intersections with all objects in the scene. */
-		double intensity = 0.0;
-		
-		// Construct a vector pointing from the intersection point to the light.
-		qbVector3<double> lightDir = (currentLight->m_location - intPoint).Normalized();
-		
-		// Compute a start point.
-		qbVector3<double> startPoint = intPoint + (lightDir * 0.001);
-		
-		// Construct a ray from the point of intersection to the light.
-		qbRT::Ray lightRay (startPoint, startPoint + lightDir);
-		
-		/* Loop through all objects in the scene to check if any
-			obstruct light from this source. */
-		//qbVector3<double> poi				{3};
-		//qbVector3<double> poiNormal	{3};
-		//qbVector3<double> poiColor		{3};
-		qbRT::DATA::hitData hitData;
-		bool validInt = false;
-		for (auto sceneObject : objectList)
-		{
-			validInt = sceneObject -> TestIntersection(lightRay, hitData);
-			if (validInt)
-				break;
-		}
-		
-		/* If no intersections were found, then proceed with
-			computing the specular component. */
-		if (!validInt)
-		{
-			// Compute the reflection vector.
-			qbVector3<double> d = lightRay.m_lab;
-			qbVector3<double> r = d - (2 * qbVector3<double>::dot(d, localNormal) * localNormal);
-			r.Normalize();
-			
-			// Compute the dot product.
-			qbVector3<double> v = cameraRay.m_lab;
-			v.Normalize();
-			double dotProduct = qbVector3<double>::dot(r, v);
-			
-			// Only proceed if the dot product is positive.
-			if (dotProduct > 0.0)
-			{
-				intensity = m_reflectivity * std::pow(dotProduct, m_shininess);
-			}
-		}
-		
-		red += currentLight->m_color.GetElement(0) * intensity;
-		green += currentLight->m_color.GetElement(1) * intensity;
-		blue += currentLight->m_color.GetElement(2) * intensity;
+		qbVector3<double> upVector = std::vector<double> {0.0, 0.0, -1.0};
+		//newNormal = PerturbNormal(newNormal, currentObject -> m_uvCoords, upVector);
+		/* We modify this code to get the UV coords directly from the hitData structure,
+			as they are no longer stored in the object itself. */
+		newNormal = PerturbNormal(newNormal, uvCoords, upVector);
 	}
 	
-	spcColor.SetElement(0, red);
-	spcColor.SetElement(1, green);
-	spcColor.SetElement(2, blue);
-	return spcColor;
+	return newNormal;
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
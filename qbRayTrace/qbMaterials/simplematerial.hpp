@@ -55,20 +55,22 @@ namespace qbRT
 			 and the UV coords respectively. */			
 			virtual qbVector3<double> ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																							const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																							const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																							qbRT::ObjectBase *currentObject,
 																							const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																							const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																							const qbRT::Ray &cameraRay) override;
+																							const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context) override;
 																							
-			// Function to compute specular highlights.
-			qbVector3<double> ComputeSpecular(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																				const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																				const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																				const qbRT::Ray &cameraRay);
+			// Function to list the shadow rays that ComputeColor() will test.
+			virtual void GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																	const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays) override;
+
+		private:
+			// Function to apply any normal maps to the object normal.
+			qbVector3<double> ComputeMaterialNormal(const qbVector3<double> &localNormal, const qbVector2<double> &uvCoords);
 																				
 		public:
 			qbVector3<double> m_baseColor {std::vector<double> {1.0, 0.0, 1.0}};
-			double m_reflectivity = 0.0;
 			double m_shininess = 0.0;
 	};
 }
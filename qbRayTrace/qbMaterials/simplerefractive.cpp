@@ -35,6 +35,8 @@
 ***********************************************************/
 
 #include "simplerefractive.hpp"
+#include "../qbAccel/bvh.hpp"
+#include <limits>
 
 qbRT::SimpleRefractive::SimpleRefractive()
 {
@@ -49,10 +51,10 @@ qbRT::SimpleRefractive::~SimpleRefractive()
 // Function to return the color.
 qbVector3<double> qbRT::SimpleRefractive::ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																												const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																												const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																												qbRT::ObjectBase *currentObject,
 																												const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																												const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																												const qbRT::Ray &cameraRay)
+																												const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context)
 {
 	// Define the initial material colors.
 	qbVector3<double> matColor;
@@ -61,51 +63,82 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeColor(	const std::vector<std::s
 	qbVector3<double> spcColor;
 	qbVector3<double> trnColor;
 	
+	// Sample each light once, for both the diffuse and specular components.
+	const std::vector<qbRT::DATA::lightSample> &lightSamples = SampleLights(objectList, lightList, intPoint, localNormal, context);
+	
 	// Compute the diffuse component.
 	if (!m_hasTexture)
 	{
-		difColor = ComputeDiffuseColor(objectList, lightList, currentObject, intPoint, localNormal, m_baseColor);
+		difColor = ComputeDiffuseColor(lightList, lightSamples, localNormal, m_baseColor);
 	}
 	else
 	{
 		//qbVector3<double> textureColor = GetTextureColor(currentObject->m_uvCoords);
 		qbVector3<double> textureColor = GetTextureColor(uvCoords);
-		difColor = ComputeDiffuseColor(objectList, lightList, currentObject, intPoint, localNormal, textureColor);
+		difColor = ComputeDiffuseColor(lightList, lightSamples, localNormal, textureColor);
 	}
+	
+	/* Compute the specular component (which is added on at the end). This is done now, as
+		the light samples don't last past shading any reflected or refracted rays below. */
+	if (m_shininess > 0.0)
+		spcColor = ComputeSpecular(lightList, lightSamples, localNormal, cameraRay);
 		
-	// Compute the reflection component.
+	/* Compute the reflection component. This ends up scaled by (1 - m_translucency) below,
+		so the reflected ray's share of the final color is reduced to match. */
 	if (m_reflectivity > 0.0)
-		refColor = ComputeReflectionColor(objectList, lightList, currentObject, intPoint, localNormal, cameraRay);
+	{
+		qbRT::DATA::shadingContext reflectionContext = context;
+		reflectionContext.weight = context.weight * (1.0 - m_translucency);
+		refColor = ComputeReflectionColor(objectList, lightList, currentObject, intPoint, localNormal, cameraRay, reflectionContext);
+	}
 		
 	// Combine the reflection and diffuse components.
 	matColor = (refColor * m_reflectivity) + (difColor * (1.0 - m_reflectivity));
 	
 	// Compute the refractive component.
 	if (m_translucency > 0.0)
-		trnColor = ComputeTranslucency(objectList, lightList, currentObject, intPoint, localNormal, cameraRay);
+		trnColor = ComputeTranslucency(objectList, lightList, currentObject, intPoint, localNormal, cameraRay, context);
 		
 	// And combine with the current color.
 	matColor = (trnColor * m_translucency) + (matColor * (1.0 - m_translucency));
 	
-	// And compute the specular component.
-	if (m_shininess > 0.0)
-		spcColor = ComputeSpecular(objectList, lightList, intPoint, localNormal, cameraRay);
-		
 	// Finally, add the specular component.
 	matColor = matColor + spcColor;
 	
 	return matColor;
 }
 
+// Function to list the shadow rays that ComputeColor() will test.
+void qbRT::SimpleRefractive::GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																						const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																						const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays)
+{
+	// One for each light, shared by the diffuse component and the specular highlights.
+	GetDiffuseShadowRays(lightList, intPoint, localNormal, shadowRays);
+}
+
 // Function to compute the color due to translucency.
 qbVector3<double> qbRT::SimpleRefractive::ComputeTranslucency(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																															const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																															const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																															qbRT::ObjectBase *currentObject,
 																															const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																															const qbRT::Ray &incidentRay)
+																															const qbRT::Ray &incidentRay, qbRT::DATA::shadingContext &context)
 {
 	qbVector3<double> trnColor {3};
 	
+	// If this path has already been refracted as many times as we allow, then stop here.
+	if (context.refractionDepth >= m_maxRefractionRays)
+		return trnColor;
+	
+	// The refracted ray gets its own context, one bounce further from the camera.
+	qbRT::DATA::shadingContext refractionContext = ComputeSecondaryContext(context, qbRT::DATA::RAY_REFRACTION, m_translucency);
+	
+	/* If the ray would add too little to the pixel to be worth tracing, then stop here (before
+		tracing it through the object). */
+	double cullScale = CullRay(refractionContext);
+	if (cullScale == 0.0)
+		return trnColor;
+	
 	// Compute the refracted vector.
 	qbVector3<double> p = incidentRay.m_lab;
 	p.Normalize();
@@ -124,14 +157,17 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeTranslucency(	const std::vector
 	qbRT::Ray refractedRay (intPoint + (refractedVector * 0.01), intPoint + refractedVector);
 	
 	// Test for secondary intersection with this object.
-	std::shared_ptr<qbRT::ObjectBase> closestObject;
+	qbRT::ObjectBase *closestObject = nullptr;
 	qbRT::DATA::hitData closestHitData;
 	qbRT::DATA::hitData hitData;	
-	bool test = currentObject -> TestIntersection(refractedRay, hitData);
+	bool test = currentObject -> TestIntersection(refractedRay, hitData, std::numeric_limits<double>::max());
 	bool intersectionFound = false;
 	qbRT::Ray finalRay;
 	if (test)
 	{
+		// We need the point of intersection and the normal.
+		currentObject -> FinalizeHit(refractedRay, hitData);
+		
 		// Compute the refracted vector.
 		qbVector3<double> p2 = refractedRay.m_lab;
 		p2.Normalize();
@@ -148,17 +184,22 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeTranslucency(	const std::vector
 		// Compute the refracted ray.
 		qbRT::Ray refractedRay2 (hitData.poi + (refractedVector2 * 0.01), hitData.poi + refractedVector2);
 		
-		// Cast this ray into the scene.
-		intersectionFound = CastRay(refractedRay2, objectList, currentObject, closestObject, closestHitData);
 		finalRay = refractedRay2;
 	}
 	else
 	{
 		/* No secondary intersections were found, so continue the original refracted ray. */
-		intersectionFound = CastRay(refractedRay, objectList, currentObject, closestObject, closestHitData);
 		finalRay = refractedRay;
 	}
 	
+	/* If the renderer will trace the ray for us, then hand it over. Its color will be added
+		to the pixel then, so it contributes nothing here. */
+	if (DeferRay(finalRay, currentObject, context, refractionContext))
+		return trnColor;
+	
+	// Cast this ray into the scene.
+	intersectionFound = CastRay(finalRay, objectList, currentObject, closestObject, closestHitData, context);
+	
 	// Compute the color for closest object.
 	qbVector3<double> matColor	{3};
 	if (intersectionFound)
@@ -172,14 +213,14 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeTranslucency(	const std::vector
 																																					closestHitData.normal, 
 																																					closestHitData.localPOI,
 																																					closestHitData.uvCoords,
-																																					finalRay);
+																																					finalRay, refractionContext);
 		}
 		else
 		{
 			matColor = qbRT::MaterialBase::ComputeDiffuseColor(	objectList, lightList, 
 																													closestHitData.hitObject, 
 																													closestHitData.poi, 
-																													closestHitData.normal, closestObject->m_baseColor);
+																													closestHitData.normal, closestObject->m_baseColor, refractionContext);
 		}
 	}
 	else
@@ -187,15 +228,14 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeTranslucency(	const std::vector
 		// Leave matColor as it is.
 	}
 	
-	trnColor = matColor;
+	trnColor = matColor * cullScale;
 	return trnColor;
 }
 
 // Function to compute the specular highlights.
-qbVector3<double> qbRT::SimpleRefractive::ComputeSpecular(const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																													const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																													const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																													const qbRT::Ray &cameraRay)
+qbVector3<double> qbRT::SimpleRefractive::ComputeSpecular(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																													const std::vector<qbRT::DATA::lightSample> &lightSamples,
+																													const qbVector3<double> &localNormal, const qbRT::Ray &cameraRay)
 {
 	qbVector3<double> spcColor	{3};
 	double red = 0.0;
@@ -203,40 +243,17 @@ qbVector3<double> qbRT::SimpleRefractive::ComputeSpecular(const std::vector<std:
 	double blue = 0.0;
 	
 	// Loop through all of the lights in the scene.
-	for (auto currentLight : lightList)
+	for (size_t i=0; i<lightList.size(); ++i)
 	{
-		/* Check for intersections with all objects in the scene. */
+		const std::shared_ptr<qbRT::LightBase> &currentLight = lightList[i];
 		double intensity = 0.0;
 		
-		// Construct a vector pointing from the intersection point to the light.
-		qbVector3<double> lightDir = (currentLight->m_location - intPoint).Normalized();
-		
-		// Compute a start point.
-		qbVector3<double> startPoint = intPoint + (lightDir * 0.001);
-		
-		// Construct a ray from the point of intersection to the light.
-		qbRT::Ray lightRay (startPoint, startPoint + lightDir);
-		
-		/* Loop through all objects in the scene to check if any
-			obstruct light from this source. */
-		//qbVector3<double> poi				{3};
-		//qbVector3<double> poiNormal	{3};
-		//qbVector3<double> poiColor		{3};
-		qbRT::DATA::hitData hitData;
-		bool validInt = false;
-		for (auto sceneObject : objectList)
-		{
-			validInt = sceneObject -> TestIntersection(lightRay, hitData);
-			if (validInt)
-				break;
-		}
-		
-		/* If no intersections were found, then proceed with
+		/* If no objects in the scene obstruct light from this source, then proceed with
 			computing the specular component. */
-		if (!validInt)
+		if (!lightSamples[i].occluded)
 		{
 			// Compute the reflection vector.
-			qbVector3<double> d = lightRay.m_lab;
+			qbVector3<double> d = lightSamples[i].lightDir;
 			qbVector3<double> r = d - (2 * qbVector3<double>::dot(d, localNormal) * localNormal);
 			r.Normalize();
 			
@@ -51,27 +51,30 @@ namespace qbRT
 			// Function to return the color.
 			virtual qbVector3<double> ComputeColor(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																							const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																							const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																							qbRT::ObjectBase *currentObject,
 																							const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
 																							const qbVector3<double> &localPOI, const qbVector2<double> &uvCoords,
-																							const qbRT::Ray &cameraRay) override;
+																							const qbRT::Ray &cameraRay, qbRT::DATA::shadingContext &context) override;
 																							
-			// Function to compute specular highlights.
-			qbVector3<double> ComputeSpecular(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
-																				const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																				const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																				const qbRT::Ray &cameraRay);
+			// Function to compute specular highlights from the light samples taken at the point (see SampleLights()).
+			qbVector3<double> ComputeSpecular(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																				const std::vector<qbRT::DATA::lightSample> &lightSamples,
+																				const qbVector3<double> &localNormal, const qbRT::Ray &cameraRay);
+																				
+			// Function to list the shadow rays that ComputeColor() will test.
+			virtual void GetShadowRays(	const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
+																	const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
+																	const qbVector2<double> &uvCoords, std::vector<qbRT::DATA::shadowRay> &shadowRays) override;
 																				
 		 	// Function to compute translucency.
 		 	qbVector3<double> ComputeTranslucency(	const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
 																						const std::vector<std::shared_ptr<qbRT::LightBase>> &lightList,
-																						const std::shared_ptr<qbRT::ObjectBase> &currentObject,
+																						qbRT::ObjectBase *currentObject,
 																						const qbVector3<double> &intPoint, const qbVector3<double> &localNormal,
-																						const qbRT::Ray &incidentRay);
+																						const qbRT::Ray &incidentRay, qbRT::DATA::shadingContext &context);
 																						
 		public:
 			qbVector3<double> m_baseColor {std::vector<double> {1.0, 0.0, 1.0}};
-			double m_reflectivity = 0.0;
 			double m_shininess = 0.0;
 			double m_translucency = 0.0;
 			double m_ior = 1.0;
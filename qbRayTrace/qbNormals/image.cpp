@@ -67,8 +67,6 @@ qbVector3<double> qbRT::Normal::Image::ComputePerturbation(const qbVector3<doubl
 		double ysd = static_cast<double>(m_ySize);
 		double xF = ((u + 1.0) / 2.0) * xsd;
 		double yF = ysd - (((v + 1.0) / 2.0) * ysd);
-		int x = static_cast<int>(round(xF));
-		int y = static_cast<int>(round(yF));
 		int xMin = static_cast<int>(floor(xF));
 		int yMin = static_cast<int>(floor(yF));
 		int xMax = static_cast<int>(ceil(xF));
@@ -108,25 +106,17 @@ qbVector3<double> qbRT::Normal::Image::ComputePerturbation(const qbVector3<doubl
 // ************************************************************************
 bool qbRT::Normal::Image::LoadImage(std::string fileName)
 {
-	if (m_imageLoaded)
-		SDL_FreeSurface(m_imageSurface);
-	
 	m_fileName = fileName;
-	m_imageSurface = SDL_LoadBMP(fileName.c_str());
-	
-	if (!m_imageSurface)
+	m_imageLoaded = false;
+	if (!m_image.LoadBMP(fileName))
 	{
-		std::cout << "Failed to load image. " << SDL_GetError() << "." << std::endl;
-		m_imageLoaded = false;
+		std::cout << "Failed to load image " << fileName << "." << std::endl;
 		return false;
 	}
 
 	// Extract useful information.
-	m_xSize = m_imageSurface->w;
-	m_ySize = m_imageSurface->h;
-	m_pitch = m_imageSurface->pitch;
-	m_pixelFormat = m_imageSurface->format;
-	m_bytesPerPixel = m_pixelFormat->BytesPerPixel;
+	m_xSize = m_image.GetXSize();
+	m_ySize = m_image.GetYSize();
 
 	m_imageLoaded = true;
 	return true;	
@@ -141,35 +131,9 @@ void qbRT::Normal::Image::GetPixelValue(int x, int y, double &red, double &green
 {
 	if ((x >= 0) && (x < m_xSize) && (y >= 0) && (y < m_ySize))
 	{	
-		// Convert (x,y) to a linear index, in bytes.
-		int pixelIndex = (x * m_bytesPerPixel) + (y * m_pitch);
-			
-		// Get a pointer to the pixel data.
-		uint8_t *pixels = (uint8_t *)m_imageSurface->pixels;
-			
-		// Extract the current pixel value.
-		std::array<uint8_t, 4> byteValues;
-		uint32_t currentPixel = 0;
-		for (int i=0; i<m_bytesPerPixel; ++i)
-		{
-			byteValues.at(i) = pixels[pixelIndex+i];
-		}
-
-		// Assemble the final pixel value, according to the number of bytes per pixel.
-		switch (m_bytesPerPixel)
-		{
-			case 3:
-				currentPixel = byteValues.at(0) | (byteValues.at(1) << 8) | (byteValues.at(2) << 16);
-				break;
-				
-			case 4:
-				currentPixel = byteValues.at(0) | (byteValues.at(1) << 8) | (byteValues.at(2) << 16) | (byteValues.at(3) << 24);
-				break;
-		}
-			
-		// Convert to RGB.
-		uint8_t r, g, b, a;
-		SDL_GetRGBA(currentPixel, m_imageSurface->format, &r, &g, &b, &a);
+		// Get the RGBA value of the pixel.
+		uint8_t r = 0, g = 0, b = 0, a = 255;
+		m_image.GetPixel(x, y, r, g, b, a);
 			
 		// Return the color.		
 		red = static_cast<double>(r - 128) / 128.0;
@@ -34,7 +34,7 @@
 #define Image_H
 
 #include "normalbase.hpp"
-#include <SDL2/SDL.h>
+#include "../bitmap.hpp"
 #include <random>
 
 namespace qbRT
@@ -76,13 +76,11 @@ namespace qbRT
 				// TO BE DELETED.			
 				std::shared_ptr<std::mt19937> m_p_randGen;
 				
-				// SDL2 stuff to handle the image.
+				// The image.
 				std::string m_fileName;
-				SDL_Surface *m_imageSurface;
-				SDL_PixelFormat *m_pixelFormat;
+				qbRT::Bitmap m_image;
 				bool m_imageLoaded = false;
-				int m_xSize, m_ySize, m_pitch;
-				uint8_t m_bytesPerPixel;				
+				int m_xSize, m_ySize;
 				
 		};
 	}
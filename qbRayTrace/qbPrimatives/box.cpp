@@ -44,6 +44,9 @@ qbRT::Box::Box()
 	m_boundingBoxTransform.SetTransform(	qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{1.0, 1.0, 1.0}});
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // The destructor.
@@ -53,7 +56,7 @@ qbRT::Box::~Box()
 }
 
 // Function to test for intersections.
-bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	if (!m_isVisible)
 		return false;
@@ -140,82 +143,29 @@ bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &
 	}
 	
 	// Find the index of the smallest non-negative value of t.
-	double finalU = 0.0;
-	double finalV = 0.0;
 	double finalT = 100e6;
 	int finalIndex = 0;
 	bool validIntersection = false;
 	for (int i=0; i<6; ++i)
 	{
-		if ((t[i] < finalT) && (t[i] > 0.0) && (abs(u[i]) <= 1.0) && (abs(v[i]) <= 1.0))
+		if ((t[i] < finalT) && (t[i] > 0.0) && (std::abs(u[i]) <= 1.0) && (std::abs(v[i]) <= 1.0))
 		{
 			finalT = t[i];
 			finalIndex = i;
-			finalU = u[i];
-			finalV = v[i];
 			validIntersection = true;
 		}
 	}
 	
+	// If the closest intersection is further away than maxT, then there is nothing more to do.
+	if (validIntersection && (finalT > maxT))
+		validIntersection = false;
+	
 	if (validIntersection)
 	{
-		// Compute the point of intersection.
-		qbVector3<double> poi = bckRay.m_point1 + finalT * k;	
-	
-		// Compute the normal vector
-		qbVector3<double> normalVector	{3};
-		switch (finalIndex)
-		{
-			case 0:
-				normalVector = std::vector<double>{0.0, 0.0, 1.0}; // Down.
-				break;
-				
-			case 1:
-				normalVector = std::vector<double>{0.0, 0.0, -1.0}; // Up.
-				break;
-				
-			case 2:
-				normalVector = std::vector<double>{-1.0, 0.0, 0.0}; // Left.
-				break;
-				
-			case 3:
-				normalVector = std::vector<double>{1.0, 0.0, 0.0}; // Right.
-				break;
-				
-			case 4:
-				normalVector = std::vector<double>{0.0, -1.0, 0.0}; // Backwards (towards the camera).
-				break;
-				
-			case 5:
-				normalVector = std::vector<double>{0.0, 1.0, 0.0}; // Forwards (away from the camera).
-				break;
-				
-		}
-		
-		// Transform the intersection point back into world coordinates.
-		hitData.poi = m_transformMatrix.Apply(poi, qbRT::FWDTFORM);
-			
-		// Transform the normal vector.
-		hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
-		hitData.normal.Normalize();
-			
-		// Return the base color.
-		hitData.color = m_baseColor;
-		
-		// Return the local point of intersection.
-		hitData.localPOI = poi;				
-
-		// Compute and return the UV coordinates.
-		//ComputeUV(poi, m_uvCoords);
-		//hitData.uvCoords = m_uvCoords;
-		/* Instead of storing the UV coordinates in the member variable,
-			we now assign the result of ComputeUV directly to the 
-			hitData structure. */
-		ComputeUV(poi, hitData.uvCoords);
-		
-		// Return a reference to this object.
-		hitData.hitObject = this -> shared_from_this();
-		
+		// Return the distance, the local point of intersection and which face was hit.
+		hitData.t = finalT;
+		hitData.localPOI = bckRay.m_point1 + finalT * k;
+		hitData.partIndex = finalIndex;
 		return true;
 	}
 	else
@@ -224,6 +174,57 @@ bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &
 	}
 }
 
+// Function to finalize the hit data.
+void qbRT::Box::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Compute the normal vector
+	qbVector3<double> normalVector	{3};
+	switch (hitData.partIndex)
+	{
+		case 0:
+			normalVector = std::vector<double>{0.0, 0.0, 1.0}; // Down.
+			break;
+			
+		case 1:
+			normalVector = std::vector<double>{0.0, 0.0, -1.0}; // Up.
+			break;
+			
+		case 2:
+			normalVector = std::vector<double>{-1.0, 0.0, 0.0}; // Left.
+			break;
+			
+		case 3:
+			normalVector = std::vector<double>{1.0, 0.0, 0.0}; // Right.
+			break;
+			
+		case 4:
+			normalVector = std::vector<double>{0.0, -1.0, 0.0}; // Backwards (towards the camera).
+			break;
+			
+		case 5:
+			normalVector = std::vector<double>{0.0, 1.0, 0.0}; // Forwards (away from the camera).
+			break;
+			
+	}
+	
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+		
+	// Transform the normal vector.
+	hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
+	hitData.normal.Normalize();
+		
+	// Return the base color.
+	hitData.color = m_baseColor;
+	
+	// Compute the UV coordinates, if they are needed.
+	if (NeedsUV())
+		ComputeUV(hitData.localPOI, hitData.uvCoords);
+	
+	// Return a reference to this object.
+	hitData.hitObject = this;
+}
+
 bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay)
 {
 	if (!m_isVisible)
@@ -289,7 +290,7 @@ bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay)
 	int i = 0;
 	while ((i < 6) && (!validIntersection))
 	{
-		if ((t[i] < 100e6) && (t[i] > 0.0) && (abs(u[i]) <= 1.0) && (abs(v[i]) <= 1.0))
+		if ((t[i] < 100e6) && (t[i] > 0.0) && (std::abs(u[i]) <= 1.0) && (std::abs(v[i]) <= 1.0))
 		{
 			validIntersection = true;
 		}
@@ -299,3 +300,137 @@ bool qbRT::Box::TestIntersection(const qbRT::Ray &castRay)
 	
 	return validIntersection;
 }
+
+// Function to test for occlusion.
+bool qbRT::Box::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	if (!m_isVisible)
+		return false;
+	
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	// Extract values of a and k.
+	double a[3] = {bckRay.m_point1.GetElement(0), bckRay.m_point1.GetElement(1), bckRay.m_point1.GetElement(2)};
+	double k[3] = {bckRay.m_lab.GetElement(0), bckRay.m_lab.GetElement(1), bckRay.m_lab.GetElement(2)};
+	
+	/* Test each pair of faces in turn (the faces normal to axis i). We can stop
+		as soon as we find any face that is hit within maxT, as we don't need to
+		know which face is the closest. */
+	for (int i=0; i<3; ++i)
+	{
+		if (CloseEnough(k[i], 0.0))
+			continue;
+			
+		int uAxis = (i + 1) % 3;
+		int vAxis = (i + 2) % 3;
+		for (double face : {-1.0, 1.0})
+		{
+			double t = (a[i] - face) / -k[i];
+			if ((t > 0.0) && (t <= maxT))
+			{
+				double u = a[uAxis] + k[uAxis] * t;
+				double v = a[vAxis] + k[vAxis] * t;
+				if ((std::abs(u) <= 1.0) && (std::abs(v) <= 1.0))
+					return true;
+			}
+		}
+	}
+	
+	return false;
+}
+
+// Function to test a packet of rays for intersections.
+void qbRT::Box::TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																				qbRT::DATA::hitData hitData[], bool validInt[])
+{
+	if (!m_isVisible)
+	{
+		for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+			validInt[i] = false;
+		return;
+	}
+
+	// Apply the backwards transform to every ray.
+	qbRT::RayPacket bckPacket = m_transformMatrix.Apply(castPacket, qbRT::BCKTFORM);
+
+	// Rays parallel to a pair of faces can't hit either of them.
+	bool parallel[3][qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		parallel[0][i] = CloseEnough(bckPacket.m_labX[i], 0.0);
+		parallel[1][i] = CloseEnough(bckPacket.m_labY[i], 0.0);
+		parallel[2][i] = CloseEnough(bckPacket.m_labZ[i], 0.0);
+	}
+
+	/* Find the closest face hit by each ray, with the faces in the same order
+		(and the same tests) as TestIntersection(). */
+	double finalT[qbRT::RAY_PACKET_SIZE];
+	int finalIndex[qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		double ax = bckPacket.m_point1X[i];
+		double ay = bckPacket.m_point1Y[i];
+		double az = bckPacket.m_point1Z[i];
+		double kx = bckPacket.m_labX[i];
+		double ky = bckPacket.m_labY[i];
+		double kz = bckPacket.m_labZ[i];
+		double t[6], u[6], v[6];
+
+		// Top and bottom.
+		double kzSafe = parallel[2][i] ? 1.0 : kz;
+		t[0] = parallel[2][i] ? 100e6 : (az - 1.0) / -kzSafe;
+		t[1] = parallel[2][i] ? 100e6 : (az + 1.0) / -kzSafe;
+		u[0] = ax + kx * t[0];
+		v[0] = ay + ky * t[0];
+		u[1] = ax + kx * t[1];
+		v[1] = ay + ky * t[1];
+
+		// Left and right.
+		double kxSafe = parallel[0][i] ? 1.0 : kx;
+		t[2] = parallel[0][i] ? 100e6 : (ax + 1.0) / -kxSafe;
+		t[3] = parallel[0][i] ? 100e6 : (ax - 1.0) / -kxSafe;
+		u[2] = az + kz * t[2];
+		v[2] = ay + ky * t[2];
+		u[3] = az + kz * t[3];
+		v[3] = ay + ky * t[3];
+
+		// Front and back.
+		double kySafe = parallel[1][i] ? 1.0 : ky;
+		t[4] = parallel[1][i] ? 100e6 : (ay + 1.0) / -kySafe;
+		t[5] = parallel[1][i] ? 100e6 : (ay - 1.0) / -kySafe;
+		u[4] = ax + kx * t[4];
+		v[4] = az + kz * t[4];
+		u[5] = ax + kx * t[5];
+		v[5] = az + kz * t[5];
+
+		// Find the index of the smallest positive value of t.
+		finalT[i] = 100e6;
+		finalIndex[i] = 0;
+		validInt[i] = false;
+		for (int j=0; j<6; ++j)
+		{
+			if ((t[j] < finalT[i]) && (t[j] > 0.0) && (std::abs(u[j]) <= 1.0) && (std::abs(v[j]) <= 1.0))
+			{
+				finalT[i] = t[j];
+				finalIndex[i] = j;
+				validInt[i] = true;
+			}
+		}
+
+		validInt[i] = validInt[i] && active[i] && (finalT[i] <= maxT[i]);
+	}
+
+	// Return the distance, the local point of intersection and which face was hit.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		if (!validInt[i])
+			continue;
+
+		hitData[i].t = finalT[i];
+		hitData[i].localPOI = qbVector3<double>{	bckPacket.m_point1X[i] + (bckPacket.m_labX[i] * finalT[i]),
+																							bckPacket.m_point1Y[i] + (bckPacket.m_labY[i] * finalT[i]),
+																							bckPacket.m_point1Z[i] + (bckPacket.m_labZ[i] * finalT[i])};
+		hitData[i].partIndex = finalIndex[i];
+	}
+}
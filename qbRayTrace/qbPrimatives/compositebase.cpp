@@ -44,6 +44,9 @@ qbRT::SHAPES::CompositeBase::CompositeBase()
 	m_xLim = std::vector<double>{1e6, -1e6};
 	m_yLim = std::vector<double>{1e6, -1e6};
 	m_zLim = std::vector<double>{1e6, -1e6};
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // Destructor.
@@ -96,6 +99,12 @@ void qbRT::SHAPES::CompositeBase::AddSubShape(std::shared_ptr<qbRT::ObjectBase>
 
 	// Add the sub-shape to the list of sub-shapes.
 	m_shapeList.push_back(subShape);
+	
+	// Update the cached extents of the composite shape.
+	UpdateExtents();
+	
+	// And rebuild the hierarchy over the sub-shapes.
+	m_bvh.Build(m_shapeList);
 }
 
 // Function to update the bounds.
@@ -147,54 +156,27 @@ void qbRT::SHAPES::CompositeBase::UpdateBounds()
 	// And modify the bounding box.
 	m_boundingBox.SetTransformMatrix(m_boundingBoxTransform);	
 	
+	// Update the cached extents of the composite shape.
+	UpdateExtents();
+	
+	// And rebuild the hierarchy over the sub-shapes.
+	m_bvh.Build(m_shapeList);
 }
 
-// Override the function to return the extents.
-void qbRT::SHAPES::CompositeBase::GetExtents(qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim)
+// Function to compute the bounding box in local coordinates.
+void qbRT::SHAPES::CompositeBase::ComputeLocalBounds(qbRT::DATA::aabb &localBounds)
 {
-	// Construct corners of a cube based on the current limits.
-	std::vector<qbVector3<double>> cornerPoints = ConstructCube(	m_xLim.GetElement(0), m_xLim.GetElement(1), 
-																															m_yLim.GetElement(0), m_yLim.GetElement(1), 
-																															m_zLim.GetElement(0), m_zLim.GetElement(1));
-	
-	// Apply the transforms to the unit cube corner points and compute limits.
-	double minX = 1e6;
-	double minY = 1e6;
-	double minZ = 1e6;
-	double maxX = -1e6;
-	double maxY = -1e6;
-	double maxZ = -1e6;
-	for (int i=0; i<8; ++i)
-	{
-		cornerPoints.at(i) = m_transformMatrix.Apply(cornerPoints.at(i), qbRT::FWDTFORM);
-		
-		if (cornerPoints.at(i).GetElement(0) < minX)
-			minX = cornerPoints.at(i).GetElement(0);
-		if (cornerPoints.at(i).GetElement(0) > maxX)
-			maxX = cornerPoints.at(i).GetElement(0);
-			
-		if (cornerPoints.at(i).GetElement(1) < minY)
-			minY = cornerPoints.at(i).GetElement(1);
-		if (cornerPoints.at(i).GetElement(1) > maxY)
-			maxY = cornerPoints.at(i).GetElement(1);
-			
-		if (cornerPoints.at(i).GetElement(2) < minZ)
-			minZ = cornerPoints.at(i).GetElement(2);
-		if (cornerPoints.at(i).GetElement(2) > maxZ)
-			maxZ = cornerPoints.at(i).GetElement(2);					
-	}
-	
-	// Return the limits.
-	xLim.SetElement(0, minX);
-	xLim.SetElement(1, maxX);
-	yLim.SetElement(0, minY);
-	yLim.SetElement(1, maxY);
-	zLim.SetElement(0, minZ);
-	zLim.SetElement(1, maxZ);	
+	// This is just the limits of the sub-shapes (plus any padding).
+	localBounds.min[0] = m_xLim.GetElement(0) - m_boundingBoxPadding;
+	localBounds.max[0] = m_xLim.GetElement(1) + m_boundingBoxPadding;
+	localBounds.min[1] = m_yLim.GetElement(0) - m_boundingBoxPadding;
+	localBounds.max[1] = m_yLim.GetElement(1) + m_boundingBoxPadding;
+	localBounds.min[2] = m_zLim.GetElement(0) - m_boundingBoxPadding;
+	localBounds.max[2] = m_zLim.GetElement(1) + m_boundingBoxPadding;
 }
 
 // Test for intersections.
-bool qbRT::SHAPES::CompositeBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::SHAPES::CompositeBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	// Check if the object is visible.
 	if (!m_isVisible)
@@ -203,29 +185,26 @@ bool qbRT::SHAPES::CompositeBase::TestIntersection(	const qbRT::Ray &castRay, qb
 	// Copy the ray and apply the backwards transform.
 	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
 	
-	// Check for intersection with the bounding box.
-	if (!m_useBoundingBox || m_boundingBox.TestIntersection(bckRay))
+	/* Check for intersection with the bounding box. This is the same as the
+		local bounding box of this shape, so we can use the slab test directly
+		on bckRay, and skip the shape entirely if the box starts beyond maxT. */
+	double tNear, tFar;
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	if (!m_useBoundingBox || qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
 	{
 		// We intersected with the bounding box, so check everything else.
-		qbVector3<double> worldIntPoint;
-		double currentDist = 100e6;
 		qbRT::DATA::hitData tempHitData;
-		int validShapeIndex = TestIntersections(castRay, bckRay, worldIntPoint, currentDist, tempHitData);
+		int validShapeIndex = TestIntersections(bckRay, maxT, tempHitData);
 		if (validShapeIndex > -1)
 		{
-			// An intersection with an internal sub-shape.
-			qbVector3<double> newNormal = m_transformMatrix.ApplyNorm(tempHitData.normal);
-			newNormal.Normalize();
-			tempHitData.hitObject -> ComputeUV(tempHitData.localPOI, hitData.uvCoords);
-			//m_uvCoords = hitData.uvCoords;
-			
-			
-			// Return these values.
-			hitData.poi = worldIntPoint;
-			hitData.normal = newNormal;
-			hitData.color = tempHitData.color;
-			hitData.localPOI = tempHitData.localPOI;
-			hitData.hitObject = tempHitData.hitObject;
+			/* An intersection with an internal sub-shape. We finalize the hit data
+				for the sub-shape here, while we still know which one it was. This
+				leaves the point of intersection and the normal in the local coordinates
+				of this shape, and FinalizeHit() transforms them into world coordinates. */
+			m_shapeList.at(validShapeIndex) -> FinalizeHit(bckRay, tempHitData);
+			hitData = tempHitData;
+			hitData.partIndex = validShapeIndex;
 			
 			return true;
 		}
@@ -244,38 +223,76 @@ bool qbRT::SHAPES::CompositeBase::TestIntersection(	const qbRT::Ray &castRay, qb
 	return false;
 }
 
+// Function to finalize the hit data.
+void qbRT::SHAPES::CompositeBase::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Transform the point of intersection and the normal from the sub-shape into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.poi, qbRT::FWDTFORM);
+	hitData.normal = m_transformMatrix.ApplyNorm(hitData.normal);
+	hitData.normal.Normalize();
+}
+
+// Test for occlusion.
+bool qbRT::SHAPES::CompositeBase::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	// Check if the object is visible.
+	if (!m_isVisible)
+		return false;
+		
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	// Check for intersection with the bounding box (within maxT).
+	double tNear, tFar;
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	if (m_useBoundingBox && !qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
+		return false;
+		
+	/* Any sub-shape will do. Note that as the transform is affine, maxT
+		applies equally to bckRay. */
+	if (m_useBoundingBox && m_bvh.IsBuilt())
+		return m_bvh.TestOcclusion(bckRay, maxT, nullptr);
+		
+	for (auto &shape : m_shapeList)
+	{
+		if (shape -> m_isVisible && shape -> TestOcclusion(bckRay, maxT))
+			return true;
+	}
+	
+	return false;
+}
+
 // Test for intersections with the sub-object list.
-int qbRT::SHAPES::CompositeBase::TestIntersections(	const qbRT::Ray &castRay,
-																										const qbRT::Ray &bckRay,
-																										qbVector3<double> &worldIntPoint,
-																										double &currentDist,
-																										qbRT::DATA::hitData &tempHitData	)
+int qbRT::SHAPES::CompositeBase::TestIntersections(	const qbRT::Ray &bckRay, double maxT, qbRT::DATA::hitData &tempHitData	)
 {
-	// Test for intersections with the sub-shapes.
-	int numShapes = m_shapeList.size();
+	/* Use the hierarchy if we have one. This visits the sub-shapes front-to-back,
+		and skips any that start beyond the closest intersection found so far. */
 	int validShapeIndex = -1;
+	if (m_useBoundingBox && m_bvh.IsBuilt())
+	{
+		m_bvh.FindClosest(bckRay, nullptr, maxT, tempHitData, validShapeIndex);
+		return validShapeIndex;
+	}
+	
+	// Otherwise, test for intersections with every sub-shape.
+	int numShapes = m_shapeList.size();
 	qbRT::DATA::hitData hitData;
 	for (int i=0; i<numShapes; ++i)
 	{
 		if (m_shapeList.at(i) -> m_isVisible)
 		{
-			bool shapeTest = m_shapeList.at(i) -> TestIntersection(bckRay, hitData);
-			if (shapeTest)
+			/* Only look for intersections that are no further away than the closest
+				one found so far. Note that as the transform is affine, t is the same
+				for bckRay as it is for the original ray. */
+			bool shapeTest = m_shapeList.at(i) -> TestIntersection(bckRay, hitData, maxT);
+			
+			// If closest, then this is the shape to use.
+			if (shapeTest && ((validShapeIndex < 0) || (hitData.t < maxT)))
 			{
-				// Transform the intersection point back into world coordinates.
-				qbVector3<double> intPoint = m_transformMatrix.Apply(hitData.poi, qbRT::FWDTFORM);
-				
-				// Compute the distance.
-				double dist = (intPoint - castRay.m_point1).norm();
-				
-				// If closest, then this is the shape to use.
-				if (dist < currentDist)
-				{
-					currentDist = dist;
-					validShapeIndex = i;
-					worldIntPoint = intPoint;
-					tempHitData = hitData;
-				}
+				maxT = hitData.t;
+				validShapeIndex = i;
+				tempHitData = hitData;
 			}
 		}
 	}
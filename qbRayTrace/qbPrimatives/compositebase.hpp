@@ -40,6 +40,8 @@
 
 #include "../qbPrimatives/objectbase.hpp"
 #include "../qbPrimatives/box.hpp"
+#include "../qbAccel/slab.hpp"
+#include "../qbAccel/bvh.hpp"
 
 namespace qbRT
 {
@@ -57,27 +59,35 @@ namespace qbRT
 				// Function to add a sub-shape.
 				void AddSubShape(std::shared_ptr<qbRT::ObjectBase> subShape);
 				
-				// Override the GetExtents function.
-				virtual void GetExtents(qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim) override;
-				
 				// Override the function to test for intersections.
-				virtual bool TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+				virtual bool TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT) override;
+				
+				// Override the function to finalize the hit data.
+				virtual void FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+				
+				// Override the function to test for occlusion.
+				virtual bool TestOcclusion(const qbRT::Ray &castRay, double maxT) override;
 																
 				// Function to update the bounds after sub-shapes have been modified.
 				void UpdateBounds();
 				
+			protected:
+				// Override the function to compute the bounding box in local coordinates.
+				virtual void ComputeLocalBounds(qbRT::DATA::aabb &localBounds) override;
+				
 			private:
 				// Test for intersections with the list of sub-objects.
-				int TestIntersections(	const qbRT::Ray &castRay,
-																const qbRT::Ray &bckRay,
-																qbVector3<double> &intPoint,
-																double &currentDist,
-																qbRT::DATA::hitData &hitData	);			
+				int TestIntersections(const qbRT::Ray &bckRay, double maxT, qbRT::DATA::hitData &hitData);			
 																
 			public:
-				// Bounding box.
+				/* Bounding box. If m_useBoundingBox is set, the sub-shapes are also
+					tested using a BVH over their extents (in the local coordinates of
+					this shape), otherwise every sub-shape is tested against every ray. */
 				qbRT::Box m_boundingBox = qbRT::Box();
 				bool m_useBoundingBox = true;
+				
+				// The hierarchy over the sub-shapes (rebuilt by AddSubShape() and UpdateBounds()).
+				qbRT::ACCEL::BVH m_bvh;
 			
 				// List of sub-objects.
 				std::vector<std::shared_ptr<qbRT::ObjectBase>> m_shapeList;
@@ -47,6 +47,9 @@ qbRT::Cylinder::Cylinder()
 	m_boundingBoxTransform.SetTransform(	qbVector3<double>{0.0, 0.0, 0.0},
 																				qbVector3<double>{0.0, 0.0, 0.0},
 																				qbVector3<double>{1.0, 1.0, 1.0});
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // The destructor.
@@ -56,16 +59,24 @@ qbRT::Cylinder::~Cylinder()
 }
 
 // The function to test for intersections.
-bool qbRT::Cylinder::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::Cylinder::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	if (!m_isVisible)
 		return false;
 		
 	// Copy the ray and apply the backwards transform.
 	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
-	
-	// Copy the m_lab vector from bckRay and normalize it.
+	return TestLocalIntersection(bckRay, hitData, maxT);
+}
+
+// Function to test for intersections with a ray in local coordinates.
+bool qbRT::Cylinder::TestLocalIntersection(const qbRT::Ray &bckRay, qbRT::DATA::hitData &hitData, double maxT)
+{
+	/* Copy the m_lab vector from bckRay and normalize it. As we work with the
+		normalized vector, the values of t below are scaled by the length of
+		m_lab, so we keep the length to convert back again. */
 	qbVector3<double> v = bckRay.m_lab;
+	double labLength = v.norm();
 	v.Normalize();
 	
 	// Compute a, b and c.
@@ -177,35 +188,20 @@ bool qbRT::Cylinder::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 		}
 	}
 	
+	// If the closest intersection is further away than maxT, then there is nothing more to do.
+	double tHit = minValue / labLength;
+	if (tHit > maxT)
+		return false;
+	
 	/* If minIndex is either 0 or 1, then we have a valid intersection
 		with the cylinder itself. */
 	qbVector3<double> validPOI = poi.at(minIndex);
 	if (minIndex < 2)
 	{
-		// Transform the intersection point back into world coordinates.
-		hitData.poi = m_transformMatrix.Apply(validPOI, qbRT::FWDTFORM);
-		
-		// Compute the local normal.
-		qbVector3<double> orgNormal;
-		orgNormal.SetElement(0, validPOI.m_x);
-		orgNormal.SetElement(1, validPOI.m_y);
-		orgNormal.SetElement(2, 0.0);
-		hitData.normal = m_transformMatrix.ApplyNorm(orgNormal);
-		hitData.normal.Normalize();
-
-		// Return the base color.
-		hitData.color = m_baseColor;
-		
-		// Return the local POI.
+		// Return the distance and the local point of intersection.
+		hitData.t = tHit;
 		hitData.localPOI = validPOI;
-		
-		// Compute the (u,v) coordinates.
-		ComputeUV(validPOI, hitData.uvCoords);
-		//hitData.uvCoords = m_uvCoords;
-		
-		// Return a reference to this object.
-		hitData.hitObject = this -> shared_from_this();
-		
+		hitData.partIndex = 0;
 		return true;
 	}
 	else
@@ -216,26 +212,10 @@ bool qbRT::Cylinder::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 			// Check if we are inside the disk.
 			if (sqrtf(std::pow(validPOI.GetElement(0), 2.0) + std::pow(validPOI.GetElement(1), 2.0)) < 1.0)
 			{
-				// Transform the intersection point back into world coordinates.
-				hitData.poi = m_transformMatrix.Apply(validPOI, qbRT::FWDTFORM);
-				
-				qbVector3<double> normalVector {0.0, 0.0, validPOI.m_z};
-				hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
-				hitData.normal.Normalize();
-				
-				// Return the base color.
-				hitData.color = m_baseColor;
-				
-				// Return the local POI.
+				// Return the distance and the local point of intersection.
+				hitData.t = tHit;
 				hitData.localPOI = validPOI;
-				
-				// Compute the UV coordinates
-				ComputeUV(validPOI, hitData.uvCoords);
-				//hitData.uvCoords = m_uvCoords;
-				
-				// Return a reference to this object.
-				hitData.hitObject = this -> shared_from_this();
-				
+				hitData.partIndex = 1;
 				return true;
 			}
 			else
@@ -252,6 +232,102 @@ bool qbRT::Cylinder::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 	return false;
 }
 
+// Function to finalize the hit data.
+void qbRT::Cylinder::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+	
+	// Compute the local normal, either for the cylinder itself or for one of the end caps.
+	qbVector3<double> orgNormal;
+	if (hitData.partIndex == 0)
+	{
+		orgNormal.SetElement(0, hitData.localPOI.m_x);
+		orgNormal.SetElement(1, hitData.localPOI.m_y);
+		orgNormal.SetElement(2, 0.0);
+	}
+	else
+	{
+		orgNormal = qbVector3<double> {0.0, 0.0, hitData.localPOI.m_z};
+	}
+	hitData.normal = m_transformMatrix.ApplyNorm(orgNormal);
+	hitData.normal.Normalize();
+	
+	// Return the base color.
+	hitData.color = m_baseColor;
+	
+	// Compute the (u,v) coordinates, if they are needed.
+	if (NeedsUV())
+		ComputeUV(hitData.localPOI, hitData.uvCoords);
+	
+	// Return a reference to this object.
+	hitData.hitObject = this;
+}
+
+bool qbRT::Cylinder::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	if (!m_isVisible)
+		return false;
+		
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	/* Copy the m_lab vector from bckRay and normalize it. As we work with the
+		normalized vector, the values of t below are scaled by the length of
+		m_lab, so we scale maxT to match. */
+	qbVector3<double> v = bckRay.m_lab;
+	double maxDist = maxT * v.norm();
+	v.Normalize();
+	
+	// Test for intersections with the cylinder itself.
+	double a = (v.m_x * v.m_x) + (v.m_y * v.m_y);
+	double b = 2.0 * (bckRay.m_point1.m_x * v.m_x + bckRay.m_point1.m_y * v.m_y);
+	double c = ((bckRay.m_point1.m_x * bckRay.m_point1.m_x) + (bckRay.m_point1.m_y * bckRay.m_point1.m_y)) - 1.0;
+	double numSQRT = sqrt((b*b) - 4.0 * a * c);
+	if (numSQRT > 0.0)
+	{
+		for (double t : {(-b + numSQRT) / (2 * a), (-b - numSQRT) / (2 * a)})
+		{
+			if ((t > 0.0) && (t <= maxDist) && (fabs(bckRay.m_point1.m_z + v.m_z * t) < 1.0))
+				return true;
+		}
+	}
+	
+	// And the end caps.
+	if (!CloseEnough(v.GetElement(2), 0.0))
+	{
+		for (double t : {(bckRay.m_point1.m_z - 1.0) / -v.m_z, (bckRay.m_point1.m_z + 1.0) / -v.m_z})
+		{
+			if ((t > 0.0) && (t <= maxDist))
+			{
+				qbVector3<double> poi = bckRay.m_point1 + t * v;
+				if (sqrtf(std::pow(poi.GetElement(0), 2.0) + std::pow(poi.GetElement(1), 2.0)) < 1.0)
+					return true;
+			}
+		}
+	}
+	
+	return false;
+}
+
+// Function to test a packet of rays for intersections.
+void qbRT::Cylinder::TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																				qbRT::DATA::hitData hitData[], bool validInt[])
+{
+	if (!m_isVisible)
+	{
+		for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+			validInt[i] = false;
+		return;
+	}
+
+	/* Apply the backwards transform to every ray at once, and then solve for
+		each ray in turn (the end caps make the solution too branchy to share). */
+	qbRT::RayPacket bckPacket = m_transformMatrix.Apply(castPacket, qbRT::BCKTFORM);
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+		validInt[i] = active[i] && TestLocalIntersection(bckPacket.GetRay(i), hitData[i], maxT[i]);
+}
+
 
 
 
@@ -0,0 +1,149 @@
+/* ***********************************************************
+	instance.cpp
+
+	The instance class implementation
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "instance.hpp"
+
+// Default constructor.
+qbRT::SHAPES::Instance::Instance()
+{
+
+}
+
+// Constructor with the object to be instanced.
+qbRT::SHAPES::Instance::Instance(const std::shared_ptr<qbRT::ObjectBase> &object)
+{
+	SetObject(object);
+}
+
+// Destructor.
+qbRT::SHAPES::Instance::~Instance()
+{
+
+}
+
+// Function to set the object to be instanced.
+void qbRT::SHAPES::Instance::SetObject(const std::shared_ptr<qbRT::ObjectBase> &object)
+{
+	m_pObject = object;
+	m_hasObject = (object != nullptr);
+	if (!m_hasObject)
+		return;
+
+	// Start with the appearance of the object.
+	m_baseColor = object -> m_baseColor;
+	m_uvMapType = object -> m_uvMapType;
+	m_pMaterial = object -> m_pMaterial;
+	m_hasMaterial = object -> m_hasMaterial;
+
+	// Our local bounding box is the bounding box of the object.
+	UpdateExtents();
+}
+
+// Test for intersections.
+bool qbRT::SHAPES::Instance::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
+{
+	// Check if the object is visible.
+	if (!m_isVisible || !m_hasObject)
+		return false;
+
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+
+	// Check for intersection with the bounding box (within maxT).
+	double tNear, tFar;
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	if (!qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
+		return false;
+
+	// As the transform is affine, t is the same for bckRay as it is for castRay.
+	return m_pObject -> TestIntersection(bckRay, hitData, maxT);
+}
+
+// Function to finalize the hit data.
+void qbRT::SHAPES::Instance::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Let the object fill in the hit data, in our local coordinates.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	m_pObject -> FinalizeHit(bckRay, hitData);
+
+	// Transform the point of intersection and the normal into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.poi, qbRT::FWDTFORM);
+	hitData.normal = m_transformMatrix.ApplyNorm(hitData.normal);
+	hitData.normal.Normalize();
+
+	/* If we have a material of our own, then shade the hit as this object.
+		Otherwise (eg. for a composite shape), the hit is shaded using the
+		material of whichever part of the object was actually hit. */
+	if (m_hasMaterial)
+	{
+		hitData.color = m_baseColor;
+		if (NeedsUV())
+			ComputeUV(hitData.localPOI, hitData.uvCoords);
+
+		hitData.hitObject = this;
+	}
+}
+
+// Test for occlusion.
+bool qbRT::SHAPES::Instance::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	// Check if the object is visible.
+	if (!m_isVisible || !m_hasObject)
+		return false;
+
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+
+	// Check for intersection with the bounding box (within maxT).
+	double tNear, tFar;
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	if (!qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
+		return false;
+
+	return m_pObject -> TestOcclusion(bckRay, maxT);
+}
+
+// Function to compute the bounding box in local coordinates.
+void qbRT::SHAPES::Instance::ComputeLocalBounds(qbRT::DATA::aabb &localBounds)
+{
+	if (m_hasObject)
+	{
+		// The object's own transform is applied within ours, so its world box is our local box.
+		localBounds = m_pObject -> GetWorldBounds();
+	}
+	else
+	{
+		// Nothing to contain yet.
+		ObjectBase::ComputeLocalBounds(localBounds);
+	}
+}
@@ -0,0 +1,97 @@
+/* ***********************************************************
+	instance.hpp
+
+	The instance class definition
+
+	A class to allow a single object (often a composite shape)
+	to appear in the scene many times without being copied. Each
+	instance refers to a shared object and has its own geometric
+	transform, and can optionally have its own material. The
+	shared object is tested in the local coordinates of the
+	instance, so the scene BVH only needs to be built over the
+	instances (the top level), whilst a composite shape keeps its
+	own BVH over its sub-shapes (the bottom level), which is built
+	just once no matter how many instances there are.
+
+	Note that the shared object should not be added to the scene
+	itself, and that if it is modified after the instance has been
+	created, UpdateExtents() should be called on the instance.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <memory>
+#include "../qbPrimatives/objectbase.hpp"
+#include "../qbAccel/slab.hpp"
+
+namespace qbRT
+{
+	namespace SHAPES
+	{
+		class Instance : public ObjectBase
+		{
+			public:
+				// Default constructor.
+				Instance();
+
+				// Constructor with the object to be instanced.
+				Instance(const std::shared_ptr<qbRT::ObjectBase> &object);
+
+				// The destructor.
+				virtual ~Instance() override;
+
+				/* Function to set the object to be instanced. The material, base color and
+					UV mapping of the object are used for the instance, unless they are
+					changed afterwards. */
+				void SetObject(const std::shared_ptr<qbRT::ObjectBase> &object);
+
+				// Override the function to test for intersections.
+				virtual bool TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT) override;
+
+				// Override the function to finalize the hit data.
+				virtual void FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+
+				// Override the function to test for occlusion.
+				virtual bool TestOcclusion(const qbRT::Ray &castRay, double maxT) override;
+
+			protected:
+				// Override the function to compute the bounding box in local coordinates.
+				virtual void ComputeLocalBounds(qbRT::DATA::aabb &localBounds) override;
+
+			public:
+				// The object being instanced (this may be shared with many other instances).
+				std::shared_ptr<qbRT::ObjectBase> m_pObject;
+
+				// A flag to indicate whether an object has been set.
+				bool m_hasObject = false;
+		};
+	}
+}
+
+#endif
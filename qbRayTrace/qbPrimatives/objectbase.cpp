@@ -33,6 +33,7 @@
 // objectbase.cpp
 
 #include "objectbase.hpp"
+#include "../qbMaterials/materialbase.hpp"
 #include <math.h>
 
 #define EPSILON 1e-6f;
@@ -40,7 +41,8 @@
 // Default constructor.
 qbRT::ObjectBase::ObjectBase()
 {
-
+	// Set up the cached bounding boxes for the default (identity) transforms.
+	UpdateExtents();
 }
 
 // The destructor.
@@ -50,14 +52,40 @@ qbRT::ObjectBase::~ObjectBase()
 }
 
 // Function to test for intersections.
-bool qbRT::ObjectBase::TestIntersection(const Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::ObjectBase::TestIntersection(const Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	return false;
 }
 
+// Function to finalize the hit data.
+void qbRT::ObjectBase::FinalizeHit(const Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// By default, assume that TestIntersection() has already filled everything in.
+}
+
+// Function to test for occlusion.
+bool qbRT::ObjectBase::TestOcclusion(const Ray &castRay, double maxT)
+{
+	// By default, fall back to the full intersection test.
+	qbRT::DATA::hitData hitData;
+	return TestIntersection(castRay, hitData, maxT);
+}
+
+// Function to test a packet of rays for intersections.
+void qbRT::ObjectBase::TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																								qbRT::DATA::hitData hitData[], bool validInt[])
+{
+	// By default, fall back to testing each ray on its own.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+		validInt[i] = active[i] && TestIntersection(castPacket.GetRay(i), hitData[i], maxT[i]);
+}
+
 void qbRT::ObjectBase::SetTransformMatrix(const qbRT::GTform &transformMatrix)
 {
 	m_transformMatrix = transformMatrix;
+	
+	// The world-space bounding box depends on the transform, so update it now.
+	UpdateExtents();
 }
 
 qbRT::GTform qbRT::ObjectBase::GetTransformMatrix()
@@ -68,91 +96,93 @@ qbRT::GTform qbRT::ObjectBase::GetTransformMatrix()
 // Function to compute the extents of the object.
 void qbRT::ObjectBase::GetExtents(qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim)
 {
-	// Construct an array of corner points for a unit cube.
-	std::vector<qbVector3<double>> cornerPoints = ConstructCube(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
-	
-	// Form the combined object and bounding box transform matrix.
-	qbRT::GTform combinedTransform = m_transformMatrix * m_boundingBoxTransform;
+	// Return the cached limits.
+	xLim.SetElement(0, m_worldBounds.min[0]);
+	xLim.SetElement(1, m_worldBounds.max[0]);
+	yLim.SetElement(0, m_worldBounds.min[1]);
+	yLim.SetElement(1, m_worldBounds.max[1]);
+	zLim.SetElement(0, m_worldBounds.min[2]);
+	zLim.SetElement(1, m_worldBounds.max[2]);
+}
+
+// Function to compute the extents of the object, accepting an additional transform matrix as input.
+void qbRT::ObjectBase::GetExtents(const qbRT::GTform &parentTransform, qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim)
+{
+	// Form the combined transform and apply it to the local bounding box.
+	qbRT::GTform combinedTransform = parentTransform * m_transformMatrix;
+	qbRT::DATA::aabb bounds;
+	TransformBounds(combinedTransform, m_localBounds, bounds);
 	
-	// Apply the transforms to the unit cube corner points and compute limits.
-	double minX = 1e6;
-	double minY = 1e6;
-	double minZ = 1e6;
-	double maxX = -1e6;
-	double maxY = -1e6;
-	double maxZ = -1e6;
-	for (int i=0; i<8; ++i)
+	// Return the limits.
+	xLim.SetElement(0, bounds.min[0]);
+	xLim.SetElement(1, bounds.max[0]);
+	yLim.SetElement(0, bounds.min[1]);
+	yLim.SetElement(1, bounds.max[1]);
+	zLim.SetElement(0, bounds.min[2]);
+	zLim.SetElement(1, bounds.max[2]);
+}
+
+// Function to return the cached world-space bounding box.
+const qbRT::DATA::aabb& qbRT::ObjectBase::GetWorldBounds() const
+{
+	return m_worldBounds;
+}
+
+// Function to return the cached local bounding box.
+const qbRT::DATA::aabb& qbRT::ObjectBase::GetLocalBounds() const
+{
+	return m_localBounds;
+}
+
+// Function to update the cached bounding boxes.
+void qbRT::ObjectBase::UpdateExtents()
+{
+	ComputeLocalBounds(m_localBounds);
+	TransformBounds(m_transformMatrix, m_localBounds, m_worldBounds);
+}
+
+// Function to compute the bounding box in local coordinates.
+void qbRT::ObjectBase::ComputeLocalBounds(qbRT::DATA::aabb &localBounds)
+{
+	// By default, this is a unit cube (plus any padding), transformed by m_boundingBoxTransform.
+	qbRT::DATA::aabb unitCube;
+	for (int i=0; i<3; ++i)
 	{
-		cornerPoints.at(i) = combinedTransform.Apply(cornerPoints.at(i), qbRT::FWDTFORM);
-		
-		if (cornerPoints.at(i).GetElement(0) < minX)
-			minX = cornerPoints.at(i).GetElement(0);
-		if (cornerPoints.at(i).GetElement(0) > maxX)
-			maxX = cornerPoints.at(i).GetElement(0);
-			
-		if (cornerPoints.at(i).GetElement(1) < minY)
-			minY = cornerPoints.at(i).GetElement(1);
-		if (cornerPoints.at(i).GetElement(1) > maxY)
-			maxY = cornerPoints.at(i).GetElement(1);
-			
-		if (cornerPoints.at(i).GetElement(2) < minZ)
-			minZ = cornerPoints.at(i).GetElement(2);
-		if (cornerPoints.at(i).GetElement(2) > maxZ)
-			maxZ = cornerPoints.at(i).GetElement(2);					
+		unitCube.min[i] = -1.0 - m_boundingBoxPadding;
+		unitCube.max[i] = 1.0 + m_boundingBoxPadding;
 	}
 	
-	// Return the limits.
-	xLim.SetElement(0, minX);
-	xLim.SetElement(1, maxX);
-	yLim.SetElement(0, minY);
-	yLim.SetElement(1, maxY);
-	zLim.SetElement(0, minZ);
-	zLim.SetElement(1, maxZ);
+	TransformBounds(m_boundingBoxTransform, unitCube, localBounds);
 }
 
-// Function to compute the extents of the object, accepting an additional transform matrix as input.
-void qbRT::ObjectBase::GetExtents(const qbRT::GTform &parentTransform, qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim)
+// Function to apply a transform to a box.
+void qbRT::ObjectBase::TransformBounds(qbRT::GTform &transformMatrix, const qbRT::DATA::aabb &inputBounds, qbRT::DATA::aabb &outputBounds)
 {
-	// Construct an array of corner points for a unit cube.
-	std::vector<qbVector3<double>> cornerPoints = ConstructCube(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
-	
-	// Form the combined object and bounding box transform matrix.
-	qbRT::GTform combinedTransform = parentTransform * m_transformMatrix * m_boundingBoxTransform;
+	/* Transform each of the eight corners and find the limits of the result. As with
+		the rest of the extents code, we start from +/-1e6 so that an object whose limits
+		have never been set ends up with extents that are too large to be useful. */
+	for (int i=0; i<3; ++i)
+	{
+		outputBounds.min[i] = 1e6;
+		outputBounds.max[i] = -1e6;
+	}
 	
-	// Apply the transforms to the unit cube corner points and compute limits.
-	double minX = 1e6;
-	double minY = 1e6;
-	double minZ = 1e6;
-	double maxX = -1e6;
-	double maxY = -1e6;
-	double maxZ = -1e6;
-	for (int i=0; i<8; ++i)
+	for (int corner=0; corner<8; ++corner)
 	{
-		cornerPoints.at(i) = combinedTransform.Apply(cornerPoints.at(i), qbRT::FWDTFORM);
+		qbVector3<double> cornerPoint {	(corner & 1) ? inputBounds.max[0] : inputBounds.min[0],
+																		(corner & 2) ? inputBounds.max[1] : inputBounds.min[1],
+																		(corner & 4) ? inputBounds.max[2] : inputBounds.min[2]};
+		cornerPoint = transformMatrix.Apply(cornerPoint, qbRT::FWDTFORM);
 		
-		if (cornerPoints.at(i).GetElement(0) < minX)
-			minX = cornerPoints.at(i).GetElement(0);
-		if (cornerPoints.at(i).GetElement(0) > maxX)
-			maxX = cornerPoints.at(i).GetElement(0);
-			
-		if (cornerPoints.at(i).GetElement(1) < minY)
-			minY = cornerPoints.at(i).GetElement(1);
-		if (cornerPoints.at(i).GetElement(1) > maxY)
-			maxY = cornerPoints.at(i).GetElement(1);
-			
-		if (cornerPoints.at(i).GetElement(2) < minZ)
-			minZ = cornerPoints.at(i).GetElement(2);
-		if (cornerPoints.at(i).GetElement(2) > maxZ)
-			maxZ = cornerPoints.at(i).GetElement(2);					
+		for (int i=0; i<3; ++i)
+		{
+			double value = cornerPoint.GetElement(i);
+			if (value < outputBounds.min[i])
+				outputBounds.min[i] = value;
+			if (value > outputBounds.max[i])
+				outputBounds.max[i] = value;
+		}
 	}
-	
-	// Return the limits.
-	xLim.SetElement(0, minX);
-	xLim.SetElement(1, maxX);
-	yLim.SetElement(0, minY);
-	yLim.SetElement(1, maxY);
-	zLim.SetElement(0, minZ);
-	zLim.SetElement(1, maxZ);
 }
 
 // Function to construct a unit cube.
@@ -179,6 +209,16 @@ bool qbRT::ObjectBase::AssignMaterial(const std::shared_ptr<qbRT::MaterialBase>
 	return m_hasMaterial;
 }
 
+// Function to check whether the assigned material needs UV coordinates.
+bool qbRT::ObjectBase::NeedsUV()
+{
+	// Without a material, we only use the base color.
+	if (!m_hasMaterial)
+		return false;
+		
+	return m_pMaterial -> UsesUV();
+}
+
 // Function to test whether two floating-point numbers are close to being equal.
 bool qbRT::ObjectBase::CloseEnough(const double f1, const double f2)
 {
@@ -42,6 +42,7 @@
 #include "../qbLinAlg/qbVector3.hpp"
 #include "../qbLinAlg/qbVector4.hpp"
 #include "../ray.hpp"
+#include "../raypacket.hpp"
 #include "../gtfm.hpp"
 
 namespace qbRT
@@ -63,8 +64,31 @@ namespace qbRT
 			ObjectBase();
 			virtual ~ObjectBase();
 			
-			// Function to test for intersections.
-			virtual bool TestIntersection(const Ray &castRay, qbRT::DATA::hitData &hitData);
+			/* Function to test for intersections. Only intersections no further away
+				than maxT (measured in units of castRay.m_lab) are returned, so that when
+				searching for the closest object we can pass in the distance to the
+				closest intersection found so far, and derived classes can skip
+				computing the hit data for anything further away. Only t, localPOI and
+				partIndex need to be filled in here. */
+			virtual bool TestIntersection(const Ray &castRay, qbRT::DATA::hitData &hitData, double maxT);
+			
+			/* Function to fill in the rest of the hit data (the point of intersection,
+				normal, color, UV coordinates and hitObject) for an intersection returned
+				by TestIntersection(). This is only called for the closest intersection. */
+			virtual void FinalizeHit(const Ray &castRay, qbRT::DATA::hitData &hitData);
+			
+			/* Function to test whether the ray hits the object anywhere between its start
+				point and maxT (measured in units of castRay.m_lab). This is all that a
+				shadow ray needs to know, so derived classes should avoid computing the
+				point of intersection, normal, UV coordinates etc. */
+			virtual bool TestOcclusion(const Ray &castRay, double maxT);
+			
+			/* Function to test a packet of rays for intersections. This is the same as
+				TestIntersection(), but for each of the active rays in the packet at once
+				(validInt is false for the others). By default, each ray is simply tested
+				on its own. Simple shapes override this to test all of the rays together. */
+			virtual void TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																						qbRT::DATA::hitData hitData[], bool validInt[]);
 			
 			// ***
 			// Function to get the extents of the object.
@@ -72,6 +96,21 @@ namespace qbRT
 			virtual void GetExtents(const qbRT::GTform &parentTransformMatrix, qbVector2<double> &xLim, qbVector2<double> &yLim, qbVector2<double> &zLim);
 			std::vector<qbVector3<double>> ConstructCube(double xMin, double xMax, double yMin, double yMax, double zMin, double zMax);			
 			
+			/* Functions to get the cached bounding boxes of the object, in world
+				coordinates and in the local coordinates of the object. These are kept
+				up to date by UpdateExtents(), so they are cheap enough to use when
+				building acceleration structures or culling. */
+			const qbRT::DATA::aabb& GetWorldBounds() const;
+			const qbRT::DATA::aabb& GetLocalBounds() const;
+			
+			/* Function to recompute the cached bounding boxes. This is called by
+				SetTransformMatrix(), and derived classes must call it whenever they
+				change their local bounds (eg. m_boundingBoxTransform). */
+			void UpdateExtents();
+			
+			// Function to apply a transform to a box, returning the box that contains the result.
+			static void TransformBounds(qbRT::GTform &transformMatrix, const qbRT::DATA::aabb &inputBounds, qbRT::DATA::aabb &outputBounds);
+			
 			// Function to set the transform matrix.
 			void SetTransformMatrix(const qbRT::GTform &transformMatrix);
 			qbRT::GTform GetTransformMatrix();
@@ -85,6 +124,13 @@ namespace qbRT
 			// Function to compute UV space.
 			void ComputeUV(const qbVector3<double> &localPOI, qbVector2<double> &uvCoords);			
 			
+			// Function to check whether the material assigned to this object needs UV coordinates.
+			bool NeedsUV();
+			
+		protected:
+			// Function to compute the bounding box of the object in local coordinates.
+			virtual void ComputeLocalBounds(qbRT::DATA::aabb &localBounds);
+			
 		// Public member variables.
 		public:
 			// The user-defined tag for this object.
@@ -117,6 +163,11 @@ namespace qbRT
 			
 			// Bounding box padding.
 			double m_boundingBoxPadding = 0.0;			
+			
+		protected:
+			// The cached bounding boxes (see UpdateExtents()).
+			qbRT::DATA::aabb m_localBounds;
+			qbRT::DATA::aabb m_worldBounds;
 	};
 }
 
@@ -50,6 +50,9 @@ qbRT::ObjPlane::ObjPlane()
 	m_boundingBoxTransform.SetTransform(	qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{1.0, 1.0, 0.01}});
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // The destructor.
@@ -59,7 +62,7 @@ qbRT::ObjPlane::~ObjPlane()
 }
 
 // The function to test for intersections.
-bool qbRT::ObjPlane::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::ObjPlane::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	if (!m_isVisible)
 		return false;
@@ -75,8 +78,9 @@ bool qbRT::ObjPlane::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 		double t = bckRay.m_point1.GetElement(2) / -bckRay.m_lab.GetElement(2);
 		
 		/* If t is negative, then the intersection point must be behind
-			the camera and we can ignore it. */
-		if (t > 0.0)
+			the camera and we can ignore it. Likewise if it is further away
+			than maxT. */
+		if ((t > 0.0) && (t <= maxT))
 		{
 			// Compute the values for u and v.
 			double u = bckRay.m_point1.GetElement(0) + (bckRay.m_lab.GetElement(0) * t);
@@ -84,32 +88,12 @@ bool qbRT::ObjPlane::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 			
 			/* If the magnitude of both u and v is less than or equal to one
 				then we must be in the plane. */
-			if ((abs(u) < 1.0) && (abs(v) < 1.0))
+			if ((std::abs(u) < 1.0) && (std::abs(v) < 1.0))
 			{
-				// Compute the point of intersection.
-				qbVector3<double> poi = bckRay.m_point1 + t * bckRay.m_lab;
-				
-				// Transform the intersection point back into world coordinates.
-				hitData.poi = m_transformMatrix.Apply(poi, qbRT::FWDTFORM);
-								
-				qbVector3<double> normalVector {0.0, 0.0, -1.0};
-				hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
-				hitData.normal.Normalize();
-				
-				// Return the base color.
-				hitData.color = m_baseColor;
-				
-				// Return the local point of intersection.
-				hitData.localPOI = poi;				
-				
-				// Compute the UV coordinates.
-				//m_uvCoords.SetElement(0, u);
-				//m_uvCoords.SetElement(1, v);
-				ComputeUV(poi, hitData.uvCoords);
-				//hitData.uvCoords = m_uvCoords;
-				
-				// Return a reference to this object.
-				hitData.hitObject = this -> shared_from_this();
+				// Return the distance and the local point of intersection.
+				hitData.t = t;
+				hitData.localPOI = bckRay.m_point1 + t * bckRay.m_lab;
+				hitData.partIndex = 0;
 				
 				return true;
 			}
@@ -127,6 +111,96 @@ bool qbRT::ObjPlane::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hit
 	return false;
 }
 
+// Function to finalize the hit data.
+void qbRT::ObjPlane::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+	
+	// Compute the normal.
+	qbVector3<double> normalVector {0.0, 0.0, -1.0};
+	hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
+	hitData.normal.Normalize();
+	
+	// Return the base color.
+	hitData.color = m_baseColor;
+	
+	// Compute the UV coordinates, if they are needed.
+	if (NeedsUV())
+		ComputeUV(hitData.localPOI, hitData.uvCoords);
+	
+	// Return a reference to this object.
+	hitData.hitObject = this;
+}
+
+// Function to test for occlusion.
+bool qbRT::ObjPlane::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	if (!m_isVisible)
+		return false;
+		
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	// A ray parallel to the plane can't hit it.
+	if (CloseEnough(bckRay.m_lab.GetElement(2), 0.0))
+		return false;
+	
+	// The intersection must be in front of the ray and no further than maxT.
+	double t = bckRay.m_point1.GetElement(2) / -bckRay.m_lab.GetElement(2);
+	if ((t <= 0.0) || (t > maxT))
+		return false;
+		
+	// And it must be within the bounds of the plane.
+	double u = bckRay.m_point1.GetElement(0) + (bckRay.m_lab.GetElement(0) * t);
+	double v = bckRay.m_point1.GetElement(1) + (bckRay.m_lab.GetElement(1) * t);
+	return (std::abs(u) < 1.0) && (std::abs(v) < 1.0);
+}
+
+// Function to test a packet of rays for intersections.
+void qbRT::ObjPlane::TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																							qbRT::DATA::hitData hitData[], bool validInt[])
+{
+	if (!m_isVisible)
+	{
+		for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+			validInt[i] = false;
+		return;
+	}
+
+	// Apply the backwards transform to every ray.
+	qbRT::RayPacket bckPacket = m_transformMatrix.Apply(castPacket, qbRT::BCKTFORM);
+
+	// Rays parallel to the plane can't hit it.
+	bool parallel[qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+		parallel[i] = CloseEnough(bckPacket.m_labZ[i], 0.0);
+
+	// Compute the point of intersection with the plane, and check that it is within the bounds of the plane.
+	double tHit[qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		double t = bckPacket.m_point1Z[i] / -(parallel[i] ? 1.0 : bckPacket.m_labZ[i]);
+		double u = bckPacket.m_point1X[i] + (bckPacket.m_labX[i] * t);
+		double v = bckPacket.m_point1Y[i] + (bckPacket.m_labY[i] * t);
+		validInt[i] = active[i] && !parallel[i] && (t > 0.0) && (t <= maxT[i]) && (std::abs(u) < 1.0) && (std::abs(v) < 1.0);
+		tHit[i] = t;
+	}
+
+	// Return the distance and the local point of intersection for each hit.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		if (!validInt[i])
+			continue;
+
+		hitData[i].t = tHit[i];
+		hitData[i].localPOI = qbVector3<double>{	bckPacket.m_point1X[i] + (bckPacket.m_labX[i] * tHit[i]),
+																							bckPacket.m_point1Y[i] + (bckPacket.m_labY[i] * tHit[i]),
+																							bckPacket.m_point1Z[i] + (bckPacket.m_labZ[i] * tHit[i])};
+		hitData[i].partIndex = 0;
+	}
+}
+
 
 
 
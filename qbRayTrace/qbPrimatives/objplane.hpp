@@ -54,7 +54,17 @@ namespace qbRT
 			virtual ~ObjPlane() override;
 		
 			// Override the function to test for intersections.
-			virtual bool TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+			virtual bool TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT) override;
+			
+			// Override the function to finalize the hit data.
+			virtual void FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+			
+			// Override the function to test for occlusion.
+			virtual bool TestOcclusion(const qbRT::Ray &castRay, double maxT) override;
+			
+			// Override the function to test a packet of rays for intersections.
+			virtual void TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																						qbRT::DATA::hitData hitData[], bool validInt[]) override;
 																			
 		private:
 		
@@ -37,6 +37,7 @@
 // objsphere.cpp
 
 #include "objsphere.hpp"
+#include <algorithm>
 #include <cmath>
 
 // The default constructor.
@@ -49,6 +50,9 @@ qbRT::ObjSphere::ObjSphere()
 	m_boundingBoxTransform.SetTransform(	qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																				qbVector3<double>{std::vector<double>{1.0, 1.0, 1.0}});
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // The destructor.
@@ -58,7 +62,7 @@ qbRT::ObjSphere::~ObjSphere()
 }
 
 // Function to test for intersections.
-bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
 {
 	if (!m_isVisible)
 		return false;
@@ -87,9 +91,9 @@ bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hit
 	// Test whether we actually have an intersection.
 	double intTest = (b*b) - 4.0 * a * c;
 	
-	qbVector3<double> poi;
 	if (intTest > 0.0)
 	{
+		double tHit = 0.0;
 		double numSQRT = sqrt(intTest);
 		double t1 = (-b + numSQRT) / 2.0;
 		double t2 = (-b - numSQRT) / 2.0;
@@ -107,13 +111,13 @@ bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hit
 			{
 				if (t1 > 0.0)
 				{
-					poi = bckRay.m_point1 + (vhat * t1);
+					tHit = t1;
 				}
 				else
 				{
 					if (t2 > 0.0)
 					{
-						poi = bckRay.m_point1 + (vhat * t2);
+						tHit = t2;
 					}
 					else
 					{
@@ -125,13 +129,13 @@ bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hit
 			{
 				if (t2 > 0.0)
 				{
-					poi = bckRay.m_point1 + (vhat * t2);
+					tHit = t2;
 				}
 				else
 				{
 					if (t1 > 0.0)
 					{
-						poi = bckRay.m_point1 + (vhat * t1);
+						tHit = t1;
 					}
 					else
 					{
@@ -140,29 +144,16 @@ bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hit
 				}
 			}
 			
-			// Transform the intersection point back into world coordinates.
-			hitData.poi = m_transformMatrix.Apply(poi, qbRT::FWDTFORM);
-			
-			// Compute the local normal (easy for a sphere at the origin!).
-			qbVector3<double> normalVector = poi;
-
-			hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
-			hitData.normal.Normalize();
-
-			
-			// Return the base color.
-			hitData.color = m_baseColor;
-			
-			// Return the local point of intersection.
-			hitData.localPOI = poi;			
-			
-			// Compute the UV coordinates.
-			ComputeUV(poi, hitData.uvCoords);
-			//hitData.uvCoords = m_uvCoords;
-			
-			// Return a reference to this object.
-			hitData.hitObject = this -> shared_from_this();
+			/* If the intersection is further away than maxT, then there is no
+				need to compute anything else. Note that as the transform is affine,
+				t is the same in local and world space. */
+			if (tHit > maxT)
+				return false;
 			
+			// Return the distance and the local point of intersection.
+			hitData.t = tHit;
+			hitData.localPOI = bckRay.m_point1 + (vhat * tHit);
+			hitData.partIndex = 0;
 		}
 		
 		return true;
@@ -174,6 +165,109 @@ bool qbRT::ObjSphere::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hit
 	
 }
 
+// Function to finalize the hit data.
+void qbRT::ObjSphere::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+	
+	// Compute the local normal (easy for a sphere at the origin!).
+	qbVector3<double> normalVector = hitData.localPOI;
+	hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
+	hitData.normal.Normalize();
+	
+	// Return the base color.
+	hitData.color = m_baseColor;
+	
+	// Compute the UV coordinates, if they are needed.
+	if (NeedsUV())
+		ComputeUV(hitData.localPOI, hitData.uvCoords);
+	
+	// Return a reference to this object.
+	hitData.hitObject = this;
+}
+
+// Function to test for occlusion.
+bool qbRT::ObjSphere::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	if (!m_isVisible)
+		return false;
+
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	// Compute the values of a, b and c, exactly as in TestIntersection().
+	qbVector3<double> vhat = bckRay.m_lab;
+	double a = qbVector3<double>::dot(vhat, vhat);
+	double b = 2.0 * qbVector3<double>::dot(bckRay.m_point1, vhat);
+	double c = qbVector3<double>::dot(bckRay.m_point1, bckRay.m_point1) - 1.0;
+	double intTest = (b*b) - 4.0 * a * c;
+	if (intTest <= 0.0)
+		return false;
+		
+	/* Find the closest point of intersection in front of the ray. As
+		the transform is affine, t is the same in local and world space. */
+	double numSQRT = sqrt(intTest);
+	double t1 = (-b + numSQRT) / 2.0;
+	double t2 = (-b - numSQRT) / 2.0;
+	if (t2 > 0.0)
+		return t2 <= maxT;
+	if (t1 > 0.0)
+		return t1 <= maxT;
+		
+	return false;
+}
+
+// Function to test a packet of rays for intersections.
+void qbRT::ObjSphere::TestPacketIntersection(	const qbRT::RayPacket &castPacket, const double maxT[], const bool active[],
+																							qbRT::DATA::hitData hitData[], bool validInt[])
+{
+	if (!m_isVisible)
+	{
+		for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+			validInt[i] = false;
+		return;
+	}
+
+	// Apply the backwards transform to every ray.
+	qbRT::RayPacket bckPacket = m_transformMatrix.Apply(castPacket, qbRT::BCKTFORM);
+
+	// Find the closest point of intersection in front of each ray (this is the same calculation as TestIntersection()).
+	double tHit[qbRT::RAY_PACKET_SIZE];
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		double px = bckPacket.m_point1X[i];
+		double py = bckPacket.m_point1Y[i];
+		double pz = bckPacket.m_point1Z[i];
+		double vx = bckPacket.m_labX[i];
+		double vy = bckPacket.m_labY[i];
+		double vz = bckPacket.m_labZ[i];
+		double a = (vx * vx) + (vy * vy) + (vz * vz);
+		double b = 2.0 * ((px * vx) + (py * vy) + (pz * vz));
+		double c = ((px * px) + (py * py) + (pz * pz)) - 1.0;
+		double intTest = (b*b) - 4.0 * a * c;
+		double numSQRT = sqrt(std::max(intTest, 0.0));
+		double t1 = (-b + numSQRT) / 2.0;
+		double t2 = (-b - numSQRT) / 2.0;
+		double t = (t1 < t2) ? ((t1 > 0.0) ? t1 : t2) : ((t2 > 0.0) ? t2 : t1);
+		validInt[i] = active[i] && (intTest > 0.0) && (t > 0.0) && (t <= maxT[i]);
+		tHit[i] = t;
+	}
+
+	// Return the distance and the local point of intersection for each hit.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		if (!validInt[i])
+			continue;
+
+		hitData[i].t = tHit[i];
+		hitData[i].localPOI = qbVector3<double>{	bckPacket.m_point1X[i] + (bckPacket.m_labX[i] * tHit[i]),
+																							bckPacket.m_point1Y[i] + (bckPacket.m_labY[i] * tHit[i]),
+																							bckPacket.m_point1Z[i] + (bckPacket.m_labZ[i] * tHit[i])};
+		hitData[i].partIndex = 0;
+	}
+}
+
 
 
 
@@ -0,0 +1,960 @@
+/* ***********************************************************
+	trianglemesh.cpp
+
+	The TriangleMesh class implementation
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "trianglemesh.hpp"
+#include "../qbAccel/slab.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+// The sections of a mesh cache file.
+static constexpr int CACHE_VX = 0;
+static constexpr int CACHE_VY = 1;
+static constexpr int CACHE_VZ = 2;
+static constexpr int CACHE_NX = 3;
+static constexpr int CACHE_NY = 4;
+static constexpr int CACHE_NZ = 5;
+static constexpr int CACHE_U = 6;
+static constexpr int CACHE_V = 7;
+static constexpr int CACHE_VERTEX_INDICES = 8;
+static constexpr int CACHE_NORMAL_INDICES = 9;
+static constexpr int CACHE_UV_INDICES = 10;
+static constexpr int CACHE_NODES = 11;
+static const char CACHE_MAGIC[8] = {'Q', 'B', 'M', 'E', 'S', 'H', 0, 0};
+
+// The default constructor.
+qbRT::TriangleMesh::TriangleMesh()
+{
+	// Define the default uv mapping (only used if the mesh has no UV coordinates of its own).
+	m_uvMapType = qbRT::uvPLANE;
+}
+
+// The destructor.
+qbRT::TriangleMesh::~TriangleMesh()
+{
+
+}
+
+// Function to load the mesh from a Wavefront OBJ file.
+bool qbRT::TriangleMesh::LoadOBJ(const std::string &fileName)
+{
+	std::ifstream inputFile (fileName);
+	if (!inputFile.is_open())
+	{
+		std::cout << "Unable to open " << fileName << std::endl;
+		return false;
+	}
+
+	Clear();
+
+	/*
+		We only need the vertices (v), normals (vn), texture coordinates (vt)
+		and faces (f). Everything else (groups, materials etc.) is ignored.
+		Faces with more than three vertices are split into a fan of triangles.
+	*/
+	std::string line;
+	int lineNumber = 0;
+	std::vector<int> faceV, faceT, faceN;
+	while (std::getline(inputFile, line))
+	{
+		++lineNumber;
+		const char *p = line.c_str();
+		while ((*p == ' ') || (*p == '\t'))
+			++p;
+
+		if ((p[0] == 'v') && ((p[1] == ' ') || (p[1] == '\t')))
+		{
+			char *end;
+			double x = std::strtod(p + 1, &end);
+			double y = std::strtod(end, &end);
+			double z = std::strtod(end, &end);
+			AddVertex(x, y, z);
+		}
+		else if ((p[0] == 'v') && (p[1] == 'n'))
+		{
+			char *end;
+			double x = std::strtod(p + 2, &end);
+			double y = std::strtod(end, &end);
+			double z = std::strtod(end, &end);
+			AddNormal(x, y, z);
+		}
+		else if ((p[0] == 'v') && (p[1] == 't'))
+		{
+			char *end;
+			double u = std::strtod(p + 2, &end);
+			double v = std::strtod(end, &end);
+			AddUV(u, v);
+		}
+		else if ((p[0] == 'f') && ((p[1] == ' ') || (p[1] == '\t')))
+		{
+			// Each vertex of a face is v, v/vt, v//vn or v/vt/vn (negative indices count back from the end).
+			faceV.clear();
+			faceT.clear();
+			faceN.clear();
+			char *end = const_cast<char*>(p + 1);
+			while (true)
+			{
+				while ((*end == ' ') || (*end == '\t'))
+					++end;
+				if ((*end == '\0') || (*end == '\r') || (*end == '#'))
+					break;
+
+				char *start = end;
+				long vIndex = std::strtol(start, &end, 10);
+				long tIndex = 0;
+				long nIndex = 0;
+				if (end == start)
+				{
+					std::cout << "Invalid face in " << fileName << " at line " << lineNumber << std::endl;
+					Clear();
+					return false;
+				}
+				if (*end == '/')
+				{
+					++end;
+					if (*end != '/')
+						tIndex = std::strtol(end, &end, 10);
+					if (*end == '/')
+					{
+						++end;
+						nIndex = std::strtol(end, &end, 10);
+					}
+				}
+
+				faceV.push_back((vIndex < 0) ? static_cast<int>(m_vx.size()) + static_cast<int>(vIndex) : static_cast<int>(vIndex) - 1);
+				faceT.push_back((tIndex < 0) ? static_cast<int>(m_u.size()) + static_cast<int>(tIndex) : static_cast<int>(tIndex) - 1);
+				faceN.push_back((nIndex < 0) ? static_cast<int>(m_nx.size()) + static_cast<int>(nIndex) : static_cast<int>(nIndex) - 1);
+			}
+
+			for (int i=1; i<(static_cast<int>(faceV.size()) - 1); ++i)
+			{
+				if (!AddTriangle(	faceV[0], faceV[i], faceV[i+1],
+													faceN[0], faceN[i], faceN[i+1],
+													faceT[0], faceT[i], faceT[i+1]))
+				{
+					std::cout << "Invalid face in " << fileName << " at line " << lineNumber << std::endl;
+					Clear();
+					return false;
+				}
+			}
+		}
+	}
+
+	if (m_vertexIndices.empty())
+	{
+		std::cout << "No triangles found in " << fileName << std::endl;
+		Clear();
+		return false;
+	}
+
+	UpdateMesh();
+	PrintStats();
+	return true;
+}
+
+// Function to save the mesh to a cache file.
+bool qbRT::TriangleMesh::SaveCache(const std::string &fileName) const
+{
+	if ((m_numTriangles == 0) || (m_numNodes == 0))
+	{
+		std::cout << "Unable to save " << fileName << ", the mesh has not been built." << std::endl;
+		return false;
+	}
+
+	// Set up the header.
+	qbRT::meshCacheHeader header {};
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.byteOrder = MESH_CACHE_BYTE_ORDER;
+	header.nodeSize = sizeof(qbRT::ACCEL::bvhNode);
+	header.numVertices = static_cast<uint32_t>(m_numVertices);
+	header.numNormals = static_cast<uint32_t>(m_numNormals);
+	header.numUVs = static_cast<uint32_t>(m_numUVs);
+	header.numTriangles = static_cast<uint32_t>(m_numTriangles);
+	header.numNodes = static_cast<uint32_t>(m_numNodes);
+	header.bounds = m_meshBounds;
+
+	// The contents of each section (missing arrays are left empty).
+	const void *sectionData[MESH_CACHE_NUM_SECTIONS] = {	m_pvx, m_pvy, m_pvz, m_pnx, m_pny, m_pnz, m_pu, m_pv,
+																												m_pVertexIndices, m_pNormalIndices, m_pUVIndices, m_pNodes};
+	uint64_t indexSize = 3 * static_cast<uint64_t>(m_numTriangles) * sizeof(int);
+	uint64_t sectionSize[MESH_CACHE_NUM_SECTIONS] = {
+		m_numVertices * sizeof(float), m_numVertices * sizeof(float), m_numVertices * sizeof(float),
+		m_numNormals * sizeof(float), m_numNormals * sizeof(float), m_numNormals * sizeof(float),
+		m_numUVs * sizeof(float), m_numUVs * sizeof(float),
+		indexSize, (m_pNormalIndices != nullptr) ? indexSize : 0, (m_pUVIndices != nullptr) ? indexSize : 0,
+		m_numNodes * sizeof(qbRT::ACCEL::bvhNode)};
+
+	// Lay the sections out one after another, each aligned.
+	uint64_t offset = sizeof(header);
+	for (int i=0; i<MESH_CACHE_NUM_SECTIONS; ++i)
+	{
+		offset = ((offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT) * MESH_CACHE_ALIGNMENT;
+		header.sectionOffset[i] = offset;
+		header.sectionSize[i] = sectionSize[i];
+		offset += sectionSize[i];
+	}
+
+	/* Write to a temporary file and then rename it, so that another process
+		that has the old cache mapped keeps a complete copy of it. */
+	std::string tempFileName = fileName + ".tmp";
+	std::ofstream outputFile (tempFileName, std::ios::binary | std::ios::trunc);
+	if (!outputFile.is_open())
+	{
+		std::cout << "Unable to write " << fileName << std::endl;
+		return false;
+	}
+
+	outputFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t position = sizeof(header);
+	const char padding[MESH_CACHE_ALIGNMENT] = {};
+	for (int i=0; i<MESH_CACHE_NUM_SECTIONS; ++i)
+	{
+		outputFile.write(padding, static_cast<std::streamsize>(header.sectionOffset[i] - position));
+		if (sectionSize[i] > 0)
+			outputFile.write(static_cast<const char*>(sectionData[i]), static_cast<std::streamsize>(sectionSize[i]));
+		position = header.sectionOffset[i] + sectionSize[i];
+	}
+	outputFile.close();
+
+	std::error_code error;
+	if (!outputFile || (std::filesystem::rename(tempFileName, fileName, error), error))
+	{
+		std::cout << "Unable to write " << fileName << std::endl;
+		std::filesystem::remove(tempFileName, error);
+		return false;
+	}
+
+	return true;
+}
+
+// Function to load the mesh from a cache file.
+bool qbRT::TriangleMesh::LoadCache(const std::string &fileName)
+{
+	qbRT::MappedFile cacheFile;
+	if (!cacheFile.Open(fileName))
+	{
+		std::cout << "Unable to open " << fileName << std::endl;
+		return false;
+	}
+
+	/*
+		Check that the file was written by this version of the code, on a
+		machine with the same byte order, and that every section is where it
+		should be. The contents themselves are trusted, as checking them would
+		mean reading the whole file.
+	*/
+	const unsigned char *pData = cacheFile.GetData();
+	uint64_t fileSize = cacheFile.GetSize();
+	qbRT::meshCacheHeader header;
+	bool isValid = fileSize >= sizeof(header);
+	if (isValid)
+	{
+		std::memcpy(&header, pData, sizeof(header));
+		isValid = (std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0) &&
+							(header.version == MESH_CACHE_VERSION) &&
+							(header.byteOrder == MESH_CACHE_BYTE_ORDER) &&
+							(header.nodeSize == sizeof(qbRT::ACCEL::bvhNode)) &&
+							(header.numTriangles > 0) && (header.numNodes > 0) &&
+							(header.numVertices <= INT32_MAX) && (header.numNormals <= INT32_MAX) && (header.numUVs <= INT32_MAX) &&
+							(header.numTriangles <= INT32_MAX / 3) && (header.numNodes <= INT32_MAX);
+	}
+
+	if (isValid)
+	{
+		uint64_t indexSize = 3 * static_cast<uint64_t>(header.numTriangles) * sizeof(int);
+		uint64_t expectedSize[MESH_CACHE_NUM_SECTIONS] = {
+			header.numVertices * sizeof(float), header.numVertices * sizeof(float), header.numVertices * sizeof(float),
+			header.numNormals * sizeof(float), header.numNormals * sizeof(float), header.numNormals * sizeof(float),
+			header.numUVs * sizeof(float), header.numUVs * sizeof(float),
+			indexSize, header.sectionSize[CACHE_NORMAL_INDICES], header.sectionSize[CACHE_UV_INDICES],
+			header.numNodes * sizeof(qbRT::ACCEL::bvhNode)};
+
+		for (int i=0; i<MESH_CACHE_NUM_SECTIONS; ++i)
+		{
+			uint64_t offset = header.sectionOffset[i];
+			uint64_t size = header.sectionSize[i];
+			if ((size != expectedSize[i]) || (offset % MESH_CACHE_ALIGNMENT != 0) || (offset < sizeof(header)) ||
+					(size > fileSize) || (offset > fileSize - size))
+				isValid = false;
+		}
+
+		if ((header.sectionSize[CACHE_NORMAL_INDICES] != 0) && (header.sectionSize[CACHE_NORMAL_INDICES] != indexSize))
+			isValid = false;
+		if ((header.sectionSize[CACHE_UV_INDICES] != 0) && (header.sectionSize[CACHE_UV_INDICES] != indexSize))
+			isValid = false;
+	}
+
+	if (!isValid)
+	{
+		std::cout << fileName << " is not a valid mesh cache file." << std::endl;
+		return false;
+	}
+
+	// Replace the current mesh with the contents of the file, which we use in place.
+	Clear();
+	m_cacheFile = std::move(cacheFile);
+	m_meshBounds = header.bounds;
+	BindArrays();
+	UpdateExtents();
+	return true;
+}
+
+// Function to load the mesh from the cache file, or from the OBJ file if the cache is out of date.
+bool qbRT::TriangleMesh::LoadCached(const std::string &objFileName, const std::string &cacheFileName)
+{
+	std::error_code error;
+	auto cacheTime = std::filesystem::last_write_time(cacheFileName, error);
+	bool haveCache = !error;
+	auto objTime = std::filesystem::last_write_time(objFileName, error);
+	if (!error && haveCache && (cacheTime >= objTime) && LoadCache(cacheFileName))
+	{
+		PrintStats();
+		return true;
+	}
+
+	// We have to load the OBJ file itself, so save the result for next time.
+	if (!LoadOBJ(objFileName))
+		return false;
+
+	SaveCache(cacheFileName);
+	return true;
+}
+
+// Function to add a vertex.
+int qbRT::TriangleMesh::AddVertex(double x, double y, double z)
+{
+	DetachCache();
+	m_vx.push_back(static_cast<float>(x));
+	m_vy.push_back(static_cast<float>(y));
+	m_vz.push_back(static_cast<float>(z));
+	BindArrays();
+	return static_cast<int>(m_vx.size()) - 1;
+}
+
+// Function to add a normal.
+int qbRT::TriangleMesh::AddNormal(double x, double y, double z)
+{
+	DetachCache();
+	m_nx.push_back(static_cast<float>(x));
+	m_ny.push_back(static_cast<float>(y));
+	m_nz.push_back(static_cast<float>(z));
+	BindArrays();
+	return static_cast<int>(m_nx.size()) - 1;
+}
+
+// Function to add a set of UV coordinates.
+int qbRT::TriangleMesh::AddUV(double u, double v)
+{
+	DetachCache();
+	m_u.push_back(static_cast<float>(u));
+	m_v.push_back(static_cast<float>(v));
+	BindArrays();
+	return static_cast<int>(m_u.size()) - 1;
+}
+
+// Function to add a triangle.
+bool qbRT::TriangleMesh::AddTriangle(int v0, int v1, int v2, int n0, int n1, int n2, int t0, int t1, int t2)
+{
+	DetachCache();
+
+	// Check that the vertices exist.
+	int numVertices = static_cast<int>(m_vx.size());
+	if ((v0 < 0) || (v1 < 0) || (v2 < 0) || (v0 >= numVertices) || (v1 >= numVertices) || (v2 >= numVertices))
+		return false;
+
+	// Normals and UV coordinates are optional, but if given they must exist.
+	int numNormals = static_cast<int>(m_nx.size());
+	bool hasNormals = (n0 >= 0) && (n1 >= 0) && (n2 >= 0);
+	if (hasNormals && ((n0 >= numNormals) || (n1 >= numNormals) || (n2 >= numNormals)))
+		return false;
+
+	int numUVs = static_cast<int>(m_u.size());
+	bool hasUVs = (t0 >= 0) && (t1 >= 0) && (t2 >= 0);
+	if (hasUVs && ((t0 >= numUVs) || (t1 >= numUVs) || (t2 >= numUVs)))
+		return false;
+
+	/* The normal and UV indices are only stored once the first triangle that
+		uses them is added, so meshes without them don't pay for them. */
+	int numTriangles = static_cast<int>(m_vertexIndices.size()) / 3;
+	if (hasNormals || !m_normalIndices.empty())
+	{
+		m_normalIndices.resize(3 * numTriangles, -1);
+		m_normalIndices.push_back(hasNormals ? n0 : -1);
+		m_normalIndices.push_back(hasNormals ? n1 : -1);
+		m_normalIndices.push_back(hasNormals ? n2 : -1);
+	}
+
+	if (hasUVs || !m_uvIndices.empty())
+	{
+		m_uvIndices.resize(3 * numTriangles, -1);
+		m_uvIndices.push_back(hasUVs ? t0 : -1);
+		m_uvIndices.push_back(hasUVs ? t1 : -1);
+		m_uvIndices.push_back(hasUVs ? t2 : -1);
+	}
+
+	m_vertexIndices.push_back(v0);
+	m_vertexIndices.push_back(v1);
+	m_vertexIndices.push_back(v2);
+	BindArrays();
+	return true;
+}
+
+// Function to discard the mesh.
+void qbRT::TriangleMesh::Clear()
+{
+	m_vx.clear();
+	m_vy.clear();
+	m_vz.clear();
+	m_nx.clear();
+	m_ny.clear();
+	m_nz.clear();
+	m_u.clear();
+	m_v.clear();
+	m_vertexIndices.clear();
+	m_normalIndices.clear();
+	m_uvIndices.clear();
+	m_bvh.Clear();
+	m_cacheFile.Close();
+	m_meshBounds = qbRT::DATA::aabb();
+	BindArrays();
+	UpdateExtents();
+}
+
+// Function to build the BVH and update the extents.
+void qbRT::TriangleMesh::UpdateMesh()
+{
+	DetachCache();
+	int numTriangles = static_cast<int>(m_vertexIndices.size()) / 3;
+
+	// Make sure that the normal and UV indices (if we have them) cover every triangle.
+	if (!m_normalIndices.empty())
+		m_normalIndices.resize(3 * numTriangles, -1);
+	if (!m_uvIndices.empty())
+		m_uvIndices.resize(3 * numTriangles, -1);
+
+	// Compute the box around each triangle, and around the whole mesh.
+	m_meshBounds = qbRT::DATA::aabb();
+	std::vector<qbRT::DATA::aabb> triangleBounds (numTriangles);
+	for (int i=0; i<numTriangles; ++i)
+	{
+		qbRT::DATA::aabb &bounds = triangleBounds[i];
+		double maxExtent = 0.0;
+		for (int j=0; j<3; ++j)
+		{
+			int vertex = m_vertexIndices[3*i + j];
+			double position[3] = {m_vx[vertex], m_vy[vertex], m_vz[vertex]};
+			for (int axis=0; axis<3; ++axis)
+			{
+				bounds.min[axis] = std::min(bounds.min[axis], position[axis]);
+				bounds.max[axis] = std::max(bounds.max[axis], position[axis]);
+				maxExtent = std::max(maxExtent, std::abs(position[axis]));
+			}
+		}
+
+		for (int axis=0; axis<3; ++axis)
+		{
+			m_meshBounds.min[axis] = std::min(m_meshBounds.min[axis], bounds.min[axis]);
+			m_meshBounds.max[axis] = std::max(m_meshBounds.max[axis], bounds.max[axis]);
+		}
+
+		/* Pad the box slightly, so that rounding errors can't make us miss a hit
+			right on its surface (triangles that lie in the plane of an axis have
+			boxes with no thickness at all). */
+		double padding = 1e-6 * (1.0 + maxExtent);
+		for (int axis=0; axis<3; ++axis)
+		{
+			bounds.min[axis] -= padding;
+			bounds.max[axis] += padding;
+		}
+	}
+
+	// Build the BVH.
+	std::vector<int> triangleOrder;
+	m_bvh.BuildTree(triangleBounds, triangleOrder);
+
+	// Put the triangles into the order that the leaves refer to them in.
+	std::vector<int> orderedIndices (m_vertexIndices.size());
+	for (int i=0; i<numTriangles; ++i)
+		for (int j=0; j<3; ++j)
+			orderedIndices[3*i + j] = m_vertexIndices[3*triangleOrder[i] + j];
+	m_vertexIndices.swap(orderedIndices);
+
+	if (!m_normalIndices.empty())
+	{
+		for (int i=0; i<numTriangles; ++i)
+			for (int j=0; j<3; ++j)
+				orderedIndices[3*i + j] = m_normalIndices[3*triangleOrder[i] + j];
+		m_normalIndices.swap(orderedIndices);
+	}
+
+	if (!m_uvIndices.empty())
+	{
+		for (int i=0; i<numTriangles; ++i)
+			for (int j=0; j<3; ++j)
+				orderedIndices[3*i + j] = m_uvIndices[3*triangleOrder[i] + j];
+		m_uvIndices.swap(orderedIndices);
+	}
+
+	// And update the extents of the object.
+	BindArrays();
+	UpdateExtents();
+}
+
+// Function to return the number of triangles.
+int qbRT::TriangleMesh::GetNumTriangles() const
+{
+	return m_numTriangles;
+}
+
+// Function to return the number of vertices.
+int qbRT::TriangleMesh::GetNumVertices() const
+{
+	return m_numVertices;
+}
+
+// Function to return the memory used by the mesh (in bytes).
+size_t qbRT::TriangleMesh::GetMemoryUsage() const
+{
+	size_t memory = static_cast<size_t>(3 * m_numVertices) * sizeof(float);
+	memory += static_cast<size_t>(3 * m_numNormals) * sizeof(float);
+	memory += static_cast<size_t>(2 * m_numUVs) * sizeof(float);
+	memory += static_cast<size_t>(3 * m_numTriangles) * sizeof(int);
+	if (m_pNormalIndices != nullptr)
+		memory += static_cast<size_t>(3 * m_numTriangles) * sizeof(int);
+	if (m_pUVIndices != nullptr)
+		memory += static_cast<size_t>(3 * m_numTriangles) * sizeof(int);
+	memory += static_cast<size_t>(m_numNodes) * sizeof(qbRT::ACCEL::bvhNode);
+	return memory;
+}
+
+// Function to check whether the mesh is being used in place from a cache file.
+bool qbRT::TriangleMesh::IsMapped() const
+{
+	return m_cacheFile.IsOpen();
+}
+
+// Function to print the size of the mesh and the memory that it uses.
+void qbRT::TriangleMesh::PrintStats() const
+{
+	int numTriangles = GetNumTriangles();
+	size_t memory = GetMemoryUsage();
+	double bytesPerTriangle = (numTriangles > 0) ? static_cast<double>(memory) / static_cast<double>(numTriangles) : 0.0;
+	std::cout << "Mesh: " << numTriangles << " triangles, " << GetNumVertices() << " vertices, ";
+	std::cout << std::fixed << std::setprecision(2) << static_cast<double>(memory) / (1024.0 * 1024.0) << "MB ";
+	std::cout << "(" << std::setprecision(1) << bytesPerTriangle << " bytes per triangle)";
+	if (IsMapped())
+		std::cout << ", mapped from the cache file";
+	std::cout << std::endl;
+
+	if (m_bvh.IsBuilt())
+		m_bvh.PrintStats();
+}
+
+// Function to test for intersections.
+bool qbRT::TriangleMesh::TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT)
+{
+	if (!m_isVisible || (m_numTriangles == 0) || (m_numNodes == 0))
+		return false;
+
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+
+	// Find the closest triangle.
+	double t;
+	int triangle = Traverse(bckRay, maxT, false, t);
+	if (triangle < 0)
+		return false;
+
+	// Return the distance, the local point of intersection and the triangle.
+	hitData.t = t;
+	hitData.localPOI = bckRay.m_point1 + (bckRay.m_lab * t);
+	hitData.partIndex = triangle;
+	return true;
+}
+
+// Function to finalize the hit data.
+void qbRT::TriangleMesh::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	int triangle = hitData.partIndex;
+
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+
+	// Find where in the triangle we are.
+	double b0, b1, b2;
+	Barycentric(triangle, hitData.localPOI, b0, b1, b2);
+
+	// Compute the normal, either from the vertex normals or from the triangle itself.
+	qbVector3<double> normalVector;
+	const int *n = (m_pNormalIndices == nullptr) ? nullptr : &m_pNormalIndices[3*triangle];
+	if ((n != nullptr) && (n[0] >= 0))
+	{
+		normalVector = qbVector3<double>{	(b0 * m_pnx[n[0]]) + (b1 * m_pnx[n[1]]) + (b2 * m_pnx[n[2]]),
+																			(b0 * m_pny[n[0]]) + (b1 * m_pny[n[1]]) + (b2 * m_pny[n[2]]),
+																			(b0 * m_pnz[n[0]]) + (b1 * m_pnz[n[1]]) + (b2 * m_pnz[n[2]])};
+	}
+	else
+	{
+		const int *v = &m_pVertexIndices[3*triangle];
+		qbVector3<double> p0 {m_pvx[v[0]], m_pvy[v[0]], m_pvz[v[0]]};
+		qbVector3<double> p1 {m_pvx[v[1]], m_pvy[v[1]], m_pvz[v[1]]};
+		qbVector3<double> p2 {m_pvx[v[2]], m_pvy[v[2]], m_pvz[v[2]]};
+		normalVector = qbVector3<double>::cross(p1 - p0, p2 - p0);
+	}
+	hitData.normal = m_transformMatrix.ApplyNorm(normalVector);
+	hitData.normal.Normalize();
+
+	// Return the base color.
+	hitData.color = m_baseColor;
+
+	// Compute the UV coordinates, if they are needed.
+	if (NeedsUV())
+	{
+		const int *uv = (m_pUVIndices == nullptr) ? nullptr : &m_pUVIndices[3*triangle];
+		if ((uv != nullptr) && (uv[0] >= 0))
+		{
+			hitData.uvCoords.SetElement(0, (b0 * m_pu[uv[0]]) + (b1 * m_pu[uv[1]]) + (b2 * m_pu[uv[2]]));
+			hitData.uvCoords.SetElement(1, (b0 * m_pv[uv[0]]) + (b1 * m_pv[uv[1]]) + (b2 * m_pv[uv[2]]));
+		}
+		else
+		{
+			ComputeUV(hitData.localPOI, hitData.uvCoords);
+		}
+	}
+
+	// Return a pointer to this object.
+	hitData.hitObject = this;
+}
+
+// Function to test for occlusion.
+bool qbRT::TriangleMesh::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	if (!m_isVisible || (m_numTriangles == 0) || (m_numNodes == 0))
+		return false;
+
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+
+	// Any triangle will do.
+	double t;
+	return Traverse(bckRay, maxT, true, t) >= 0;
+}
+
+// Function to compute the bounding box in local coordinates.
+void qbRT::TriangleMesh::ComputeLocalBounds(qbRT::DATA::aabb &localBounds)
+{
+	if (m_numTriangles == 0)
+	{
+		// Nothing to contain yet.
+		ObjectBase::ComputeLocalBounds(localBounds);
+		return;
+	}
+
+	localBounds = m_meshBounds;
+}
+
+// PRIVATE FUNCTIONS.
+// Function to set up a meshRay.
+void qbRT::TriangleMesh::SetupMeshRay(const qbRT::Ray &bckRay, qbRT::meshRay &ray)
+{
+	double dir[3];
+	for (int i=0; i<3; ++i)
+	{
+		ray.origin[i] = bckRay.m_point1.GetElement(i);
+		dir[i] = bckRay.m_lab.GetElement(i);
+	}
+
+	/*
+		The watertight test (Woop, Benthin and Wald, 2013) works in a space
+		where the ray points along the z axis. We choose z to be the largest
+		component of the direction, and swap x and y if needed to keep the
+		winding of the triangles the same.
+	*/
+	ray.kz = 0;
+	if (std::abs(dir[1]) > std::abs(dir[ray.kz]))
+		ray.kz = 1;
+	if (std::abs(dir[2]) > std::abs(dir[ray.kz]))
+		ray.kz = 2;
+	ray.kx = (ray.kz + 1) % 3;
+	ray.ky = (ray.kx + 1) % 3;
+	if (dir[ray.kz] < 0.0)
+		std::swap(ray.kx, ray.ky);
+
+	// The shear and scale that take the direction onto the z axis.
+	ray.Sx = dir[ray.kx] / dir[ray.kz];
+	ray.Sy = dir[ray.ky] / dir[ray.kz];
+	ray.Sz = 1.0 / dir[ray.kz];
+}
+
+// Function to test a ray against a single triangle.
+bool qbRT::TriangleMesh::IntersectTriangle(int triangle, const qbRT::meshRay &ray, double maxT, double &t) const
+{
+	const int *v = &m_pVertexIndices[3*triangle];
+
+	// The vertices, relative to the start of the ray.
+	double A[3] = {m_pvx[v[0]] - ray.origin[0], m_pvy[v[0]] - ray.origin[1], m_pvz[v[0]] - ray.origin[2]};
+	double B[3] = {m_pvx[v[1]] - ray.origin[0], m_pvy[v[1]] - ray.origin[1], m_pvz[v[1]] - ray.origin[2]};
+	double C[3] = {m_pvx[v[2]] - ray.origin[0], m_pvy[v[2]] - ray.origin[1], m_pvz[v[2]] - ray.origin[2]};
+
+	// Shear the vertices so that the ray points along the z axis.
+	double Ax = A[ray.kx] - (ray.Sx * A[ray.kz]);
+	double Ay = A[ray.ky] - (ray.Sy * A[ray.kz]);
+	double Bx = B[ray.kx] - (ray.Sx * B[ray.kz]);
+	double By = B[ray.ky] - (ray.Sy * B[ray.kz]);
+	double Cx = C[ray.kx] - (ray.Sx * C[ray.kz]);
+	double Cy = C[ray.ky] - (ray.Sy * C[ray.kz]);
+
+	/* The scaled barycentric coordinates. The ray hits the triangle if these
+		all have the same sign (either side may face the ray). Edges are shared
+		exactly between neighbouring triangles, so no ray can pass between them. */
+	double U = (Cx * By) - (Cy * Bx);
+	double V = (Ax * Cy) - (Ay * Cx);
+	double W = (Bx * Ay) - (By * Ax);
+	if (((U < 0.0) || (V < 0.0) || (W < 0.0)) && ((U > 0.0) || (V > 0.0) || (W > 0.0)))
+		return false;
+
+	double det = U + V + W;
+	if (det == 0.0)
+		return false;
+
+	// Compute the scaled distance, and check that it is in range before dividing.
+	double T = (U * ray.Sz * A[ray.kz]) + (V * ray.Sz * B[ray.kz]) + (W * ray.Sz * C[ray.kz]);
+	if (det > 0.0)
+	{
+		if ((T <= 0.0) || (T > maxT * det))
+			return false;
+	}
+	else
+	{
+		if ((T >= 0.0) || (T < maxT * det))
+			return false;
+	}
+
+	t = T / det;
+	return true;
+}
+
+// Function to traverse the BVH.
+int qbRT::TriangleMesh::Traverse(const qbRT::Ray &bckRay, double maxT, bool anyHit, double &t) const
+{
+	const qbRT::ACCEL::bvhNode *nodes = m_pNodes;
+	if (m_numNodes == 0)
+		return -1;
+
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	qbRT::meshRay ray;
+	SetupMeshRay(bckRay, ray);
+
+	int closestTriangle = -1;
+	double minT = maxT;
+	double tHit;
+
+	// Traverse the tree front-to-back, skipping any node that starts beyond the closest hit so far.
+	int nodeStack[2 * qbRT::ACCEL::BVH_MAX_DEPTH + 2];
+	double nearStack[2 * qbRT::ACCEL::BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	double tNear, tFar;
+	if (qbRT::ACCEL::IntersectSlabs(nodes[0].bounds, slab, 0.0, minT, tNear, tFar))
+	{
+		nodeStack[stackSize] = 0;
+		nearStack[stackSize] = tNear;
+		++stackSize;
+	}
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		if (nearStack[stackSize] > minT)
+			continue;
+
+		const qbRT::ACCEL::bvhNode &node = nodes[nodeStack[stackSize]];
+		if (node.numObjects > 0)
+		{
+			// A leaf, so test each of its triangles.
+			for (int i=node.firstIndex; i<(node.firstIndex + node.numObjects); ++i)
+			{
+				if (IntersectTriangle(i, ray, minT, tHit) && ((closestTriangle < 0) || (tHit < minT)))
+				{
+					minT = tHit;
+					closestTriangle = i;
+					if (anyHit)
+					{
+						t = minT;
+						return closestTriangle;
+					}
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearest child first (so it goes onto the stack last).
+			double tNear1, tNear2;
+			bool hit1 = qbRT::ACCEL::IntersectSlabs(nodes[node.firstIndex].bounds, slab, 0.0, minT, tNear1, tFar);
+			bool hit2 = qbRT::ACCEL::IntersectSlabs(nodes[node.firstIndex + 1].bounds, slab, 0.0, minT, tNear2, tFar);
+			if (hit1 && hit2)
+			{
+				int nearChild = (tNear1 <= tNear2) ? node.firstIndex : node.firstIndex + 1;
+				int farChild = (tNear1 <= tNear2) ? node.firstIndex + 1 : node.firstIndex;
+				nodeStack[stackSize] = farChild;
+				nearStack[stackSize] = std::max(tNear1, tNear2);
+				++stackSize;
+				nodeStack[stackSize] = nearChild;
+				nearStack[stackSize] = std::min(tNear1, tNear2);
+				++stackSize;
+			}
+			else if (hit1)
+			{
+				nodeStack[stackSize] = node.firstIndex;
+				nearStack[stackSize] = tNear1;
+				++stackSize;
+			}
+			else if (hit2)
+			{
+				nodeStack[stackSize] = node.firstIndex + 1;
+				nearStack[stackSize] = tNear2;
+				++stackSize;
+			}
+		}
+	}
+
+	t = minT;
+	return closestTriangle;
+}
+
+// Function to compute the barycentric coordinates of a point in a triangle.
+void qbRT::TriangleMesh::Barycentric(int triangle, const qbVector3<double> &point, double &b0, double &b1, double &b2) const
+{
+	const int *v = &m_pVertexIndices[3*triangle];
+	qbVector3<double> p0 {m_pvx[v[0]], m_pvy[v[0]], m_pvz[v[0]]};
+	qbVector3<double> e1 = qbVector3<double>{m_pvx[v[1]], m_pvy[v[1]], m_pvz[v[1]]} - p0;
+	qbVector3<double> e2 = qbVector3<double>{m_pvx[v[2]], m_pvy[v[2]], m_pvz[v[2]]} - p0;
+	qbVector3<double> p = point - p0;
+
+	double d11 = qbVector3<double>::dot(e1, e1);
+	double d12 = qbVector3<double>::dot(e1, e2);
+	double d22 = qbVector3<double>::dot(e2, e2);
+	double dp1 = qbVector3<double>::dot(p, e1);
+	double dp2 = qbVector3<double>::dot(p, e2);
+	double denom = (d11 * d22) - (d12 * d12);
+	if (denom == 0.0)
+	{
+		b0 = 1.0;
+		b1 = 0.0;
+		b2 = 0.0;
+		return;
+	}
+
+	b1 = ((d22 * dp1) - (d12 * dp2)) / denom;
+	b2 = ((d11 * dp2) - (d12 * dp1)) / denom;
+	b0 = 1.0 - b1 - b2;
+}
+
+// Function to point the array pointers at the vectors, or at the cache file.
+void qbRT::TriangleMesh::BindArrays()
+{
+	if (m_cacheFile.IsOpen())
+	{
+		// The file has already been checked by LoadCache().
+		const unsigned char *pData = m_cacheFile.GetData();
+		qbRT::meshCacheHeader header;
+		std::memcpy(&header, pData, sizeof(header));
+		const uint64_t *offset = header.sectionOffset;
+		m_pvx = reinterpret_cast<const float*>(pData + offset[CACHE_VX]);
+		m_pvy = reinterpret_cast<const float*>(pData + offset[CACHE_VY]);
+		m_pvz = reinterpret_cast<const float*>(pData + offset[CACHE_VZ]);
+		m_pnx = reinterpret_cast<const float*>(pData + offset[CACHE_NX]);
+		m_pny = reinterpret_cast<const float*>(pData + offset[CACHE_NY]);
+		m_pnz = reinterpret_cast<const float*>(pData + offset[CACHE_NZ]);
+		m_pu = reinterpret_cast<const float*>(pData + offset[CACHE_U]);
+		m_pv = reinterpret_cast<const float*>(pData + offset[CACHE_V]);
+		m_pVertexIndices = reinterpret_cast<const int*>(pData + offset[CACHE_VERTEX_INDICES]);
+		m_pNormalIndices = (header.sectionSize[CACHE_NORMAL_INDICES] > 0) ? reinterpret_cast<const int*>(pData + offset[CACHE_NORMAL_INDICES]) : nullptr;
+		m_pUVIndices = (header.sectionSize[CACHE_UV_INDICES] > 0) ? reinterpret_cast<const int*>(pData + offset[CACHE_UV_INDICES]) : nullptr;
+		m_pNodes = reinterpret_cast<const qbRT::ACCEL::bvhNode*>(pData + offset[CACHE_NODES]);
+		m_numVertices = static_cast<int>(header.numVertices);
+		m_numNormals = static_cast<int>(header.numNormals);
+		m_numUVs = static_cast<int>(header.numUVs);
+		m_numTriangles = static_cast<int>(header.numTriangles);
+		m_numNodes = static_cast<int>(header.numNodes);
+		return;
+	}
+
+	m_pvx = m_vx.data();
+	m_pvy = m_vy.data();
+	m_pvz = m_vz.data();
+	m_pnx = m_nx.data();
+	m_pny = m_ny.data();
+	m_pnz = m_nz.data();
+	m_pu = m_u.data();
+	m_pv = m_v.data();
+	m_pVertexIndices = m_vertexIndices.data();
+	m_pNormalIndices = m_normalIndices.empty() ? nullptr : m_normalIndices.data();
+	m_pUVIndices = m_uvIndices.empty() ? nullptr : m_uvIndices.data();
+	m_pNodes = m_bvh.GetNodes().data();
+	m_numVertices = static_cast<int>(m_vx.size());
+	m_numNormals = static_cast<int>(m_nx.size());
+	m_numUVs = static_cast<int>(m_u.size());
+	m_numTriangles = static_cast<int>(m_vertexIndices.size()) / 3;
+	m_numNodes = static_cast<int>(m_bvh.GetNodes().size());
+}
+
+// Function to copy the contents of the cache file into the vectors.
+void qbRT::TriangleMesh::DetachCache()
+{
+	if (!m_cacheFile.IsOpen())
+		return;
+
+	/* The BVH isn't copied, as it has to be rebuilt (by UpdateMesh()) once the
+		mesh has been modified anyway. */
+	m_vx.assign(m_pvx, m_pvx + m_numVertices);
+	m_vy.assign(m_pvy, m_pvy + m_numVertices);
+	m_vz.assign(m_pvz, m_pvz + m_numVertices);
+	m_nx.assign(m_pnx, m_pnx + m_numNormals);
+	m_ny.assign(m_pny, m_pny + m_numNormals);
+	m_nz.assign(m_pnz, m_pnz + m_numNormals);
+	m_u.assign(m_pu, m_pu + m_numUVs);
+	m_v.assign(m_pv, m_pv + m_numUVs);
+	m_vertexIndices.assign(m_pVertexIndices, m_pVertexIndices + (3 * m_numTriangles));
+	if (m_pNormalIndices != nullptr)
+		m_normalIndices.assign(m_pNormalIndices, m_pNormalIndices + (3 * m_numTriangles));
+	if (m_pUVIndices != nullptr)
+		m_uvIndices.assign(m_pUVIndices, m_pUVIndices + (3 * m_numTriangles));
+
+	m_cacheFile.Close();
+	BindArrays();
+}
@@ -0,0 +1,211 @@
+/* ***********************************************************
+	trianglemesh.hpp
+
+	The TriangleMesh class definition
+
+	A class for objects made up of a (possibly very large) number
+	of triangles, such as those loaded from Wavefront OBJ files.
+
+	The vertices, normals and UV coordinates are stored as flat
+	arrays of floats (one array per component), and each triangle
+	is stored as indices into those arrays. The triangles are
+	organised into a BVH, so that each ray only needs to be tested
+	against the few triangles that are close to it, and they are
+	tested using a watertight ray / triangle test so that rays
+	can't slip through the gaps between neighbouring triangles.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef TRIANGLEMESH_H
+#define TRIANGLEMESH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "objectbase.hpp"
+#include "../qbAccel/bvh.hpp"
+#include "../mappedfile.hpp"
+
+namespace qbRT
+{
+	// Structure to hold a ray in the form used by the watertight triangle test.
+	struct meshRay
+	{
+		double origin[3];
+		int kx, ky, kz;
+		double Sx, Sy, Sz;
+	};
+
+	// Constants for the mesh cache files (increase the version whenever the layout changes).
+	constexpr uint32_t MESH_CACHE_VERSION = 1;
+	constexpr uint32_t MESH_CACHE_BYTE_ORDER = 0x01020304;
+	constexpr int MESH_CACHE_NUM_SECTIONS = 12;
+	constexpr uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+	/*
+		The header at the start of a mesh cache file. It is followed by the
+		sections (the vertex, normal and UV arrays, the index arrays and the
+		BVH nodes), each starting on a multiple of MESH_CACHE_ALIGNMENT bytes.
+		An empty section means that the mesh doesn't have that array.
+	*/
+	struct meshCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint32_t nodeSize;
+		uint32_t numVertices;
+		uint32_t numNormals;
+		uint32_t numUVs;
+		uint32_t numTriangles;
+		uint32_t numNodes;
+		qbRT::DATA::aabb bounds;
+		uint64_t sectionOffset[MESH_CACHE_NUM_SECTIONS];
+		uint64_t sectionSize[MESH_CACHE_NUM_SECTIONS];
+	};
+
+	class TriangleMesh : public ObjectBase
+	{
+		public:
+			// Default constructor.
+			TriangleMesh();
+
+			// Override the destructor.
+			virtual ~TriangleMesh() override;
+
+			// Function to load the mesh from a Wavefront OBJ file.
+			bool LoadOBJ(const std::string &fileName);
+
+			// Functions to save the mesh to a cache file, and to load (map) it again.
+			bool SaveCache(const std::string &fileName) const;
+			bool LoadCache(const std::string &fileName);
+
+			/* Function to load the mesh from the cache file if it is at least as new as the
+				OBJ file, otherwise to load the OBJ file and (re)write the cache. */
+			bool LoadCached(const std::string &objFileName, const std::string &cacheFileName);
+
+			// Functions to build a mesh directly. Call UpdateMesh() once all the triangles have been added.
+			int AddVertex(double x, double y, double z);
+			int AddNormal(double x, double y, double z);
+			int AddUV(double u, double v);
+			bool AddTriangle(	int v0, int v1, int v2,
+												int n0 = -1, int n1 = -1, int n2 = -1,
+												int t0 = -1, int t1 = -1, int t2 = -1);
+
+			// Function to discard the mesh.
+			void Clear();
+
+			// Function to build the BVH and update the extents after the mesh has been modified.
+			void UpdateMesh();
+
+			// Functions to return information about the mesh.
+			int GetNumTriangles() const;
+			int GetNumVertices() const;
+			size_t GetMemoryUsage() const;
+			bool IsMapped() const;
+
+			// Function to print the size of the mesh and the memory that it uses.
+			void PrintStats() const;
+
+			// Override the function to test for intersections.
+			virtual bool TestIntersection(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT) override;
+
+			// Override the function to finalize the hit data.
+			virtual void FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+
+			// Override the function to test for occlusion.
+			virtual bool TestOcclusion(const qbRT::Ray &castRay, double maxT) override;
+
+		protected:
+			// Override the function to compute the bounding box in local coordinates.
+			virtual void ComputeLocalBounds(qbRT::DATA::aabb &localBounds) override;
+
+		private:
+			// Function to set up a meshRay from a ray (in local coordinates).
+			static void SetupMeshRay(const qbRT::Ray &bckRay, meshRay &ray);
+
+			// Function to test a ray against a single triangle, returning t if it is no further away than maxT.
+			bool IntersectTriangle(int triangle, const meshRay &ray, double maxT, double &t) const;
+
+			// Function to traverse the BVH, returning the closest triangle (or the first one found if anyHit is set).
+			int Traverse(const qbRT::Ray &bckRay, double maxT, bool anyHit, double &t) const;
+
+			// Function to compute the barycentric coordinates of a point in a triangle.
+			void Barycentric(int triangle, const qbVector3<double> &point, double &b0, double &b1, double &b2) const;
+
+			// Function to point the array pointers at the vectors (unless we are using a cache file).
+			void BindArrays();
+
+			// Function to copy the contents of the cache file into the vectors, so that the mesh can be modified.
+			void DetachCache();
+
+		private:
+			// The vertices, normals and UV coordinates.
+			std::vector<float> m_vx, m_vy, m_vz;
+			std::vector<float> m_nx, m_ny, m_nz;
+			std::vector<float> m_u, m_v;
+
+			/*
+				The triangles, as three indices each into the arrays above (in the order
+				used by the leaves of the BVH). The normal and UV indices are only used if
+				the mesh has normals and UV coordinates, and are -1 where a triangle
+				doesn't have them.
+			*/
+			std::vector<int> m_vertexIndices;
+			std::vector<int> m_normalIndices;
+			std::vector<int> m_uvIndices;
+
+			// The BVH over the triangles.
+			qbRT::ACCEL::BVH m_bvh;
+
+			// The extents of the vertices.
+			qbRT::DATA::aabb m_meshBounds;
+
+			/*
+				The arrays that are actually used to render the mesh. These point
+				either into the vectors above, or into the cache file if the mesh
+				was loaded from one (in which case the vectors are empty).
+			*/
+			const float *m_pvx = nullptr, *m_pvy = nullptr, *m_pvz = nullptr;
+			const float *m_pnx = nullptr, *m_pny = nullptr, *m_pnz = nullptr;
+			const float *m_pu = nullptr, *m_pv = nullptr;
+			const int *m_pVertexIndices = nullptr;
+			const int *m_pNormalIndices = nullptr;
+			const int *m_pUVIndices = nullptr;
+			const qbRT::ACCEL::bvhNode *m_pNodes = nullptr;
+			int m_numVertices = 0;
+			int m_numNormals = 0;
+			int m_numUVs = 0;
+			int m_numTriangles = 0;
+			int m_numNodes = 0;
+
+			// The cache file, if the mesh was loaded from one.
+			qbRT::MappedFile m_cacheFile;
+	};
+}
+
+#endif
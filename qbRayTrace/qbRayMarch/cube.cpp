@@ -47,6 +47,9 @@ qbRT::RM::Cube::Cube()
 	m_boundingBox.SetTransformMatrix(qbRT::GTform { qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{1.2, 1.2, 1.2}} } );
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 
 }
 
@@ -41,6 +41,9 @@ qbRT::RM::RayMarchBase::RayMarchBase()
 	
 	// Define the maximum number of steps allowed.
 	m_maxSteps = 100;
+	
+	// Update the cached extents to match the bounding box.
+	UpdateExtents();
 }
 
 // Destructor.
@@ -50,7 +53,7 @@ qbRT::RM::RayMarchBase::~RayMarchBase()
 }
 
 // Test for intersections.
-bool qbRT::RM::RayMarchBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData	)
+bool qbRT::RM::RayMarchBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT	)
 {
 	// Check if an object function has been defined.
 	if (m_haveObjectFcn)
@@ -62,20 +65,33 @@ bool qbRT::RM::RayMarchBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::D
 		// Copy the ray and apply the backwards transform.
 		qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
 		
-		// Test for intersections with the bounding box.
-		if (m_boundingBox.TestIntersection(bckRay))
+		/* Test for intersections with the bounding box (within maxT). The surface is
+			entirely inside the box, so if the ray misses the box there is nothing to march. */
+		double tNear, tFar;
+		qbRT::ACCEL::slabRay slab;
+		qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+		if (qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
 		{
-			// Extract ray direction.
+			/* Extract ray direction. As we march along the normalized direction,
+				we scale maxT by the length of m_lab to get the furthest we need to go. */
 			qbVector3<double> vhat = bckRay.m_lab;
+			double labLength = vhat.norm();
+			double maxDist = maxT * labLength;
 			vhat.Normalize();		
 		
 			qbVector3<double> currentLoc = bckRay.m_point1;
+			double totalDist = 0.0;
 			int stepCount = 0;
 			double dist = EvaluateSDF(&currentLoc, &m_parms);
 			
 			// Main loop
 			while ((dist > m_epsilon) && (stepCount < m_maxSteps))
 			{
+				// Give up once we are further away than maxT.
+				totalDist += dist;
+				if (totalDist > maxDist)
+					return false;
+					
 				currentLoc = currentLoc + (vhat * dist);
 				
 				dist = EvaluateSDF(&currentLoc, &m_parms);
@@ -95,52 +111,14 @@ bool qbRT::RM::RayMarchBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::D
 			}
 		
 			// Otherwise, we have a valid intersection at currentLoc.
-			// Transform the intersection point back into world coordinates.
-			hitData.poi = m_transformMatrix.Apply(currentLoc, qbRT::FWDTFORM);
-			
-			// Compute the local normal.
-			qbVector3<double> surfaceNormal;
-
-			/*
-			 Note the extra code here to compute an offset location from which
-			to compute the normal. The reason to do this is that in some cases,
-			especially with more complex distance functions, the point of intersection
-			can be computed as being very slightly inside the surface. This would
-			obviously result in a normal vector pointing in the wrong direction.
-			By tracing back along the intersecting ray a short distance and then using
-			that location instead, we can avoid this problem.
-			*/
-
-			// Determine an offset point.
-			qbVector3<double> normalLoc = currentLoc - (vhat * 0.01);
-
-			qbVector3<double> x1 = normalLoc - m_xDisp;
-			qbVector3<double> x2 = normalLoc + m_xDisp;
-			qbVector3<double> y1 = normalLoc - m_yDisp;
-			qbVector3<double> y2 = normalLoc + m_yDisp;
-			qbVector3<double> z1 = normalLoc - m_zDisp;
-			qbVector3<double> z2 = normalLoc + m_zDisp;
-			surfaceNormal.SetElement(0, EvaluateSDF(&x2, &m_parms) - EvaluateSDF(&x1, &m_parms));
-			surfaceNormal.SetElement(1, EvaluateSDF(&y2, &m_parms) - EvaluateSDF(&y1, &m_parms));
-			surfaceNormal.SetElement(2, EvaluateSDF(&z2, &m_parms) - EvaluateSDF(&z1, &m_parms));
-		
-			// Transform the local normal.
-			surfaceNormal.Normalize();
-			hitData.normal = m_transformMatrix.ApplyNorm(surfaceNormal);
-			
-			// Return the base color.
-			hitData.color = m_baseColor;
-			
-			// Return a pointer to this object.
-			//hitData.hitObject = std::make_shared<qbRT::ObjectBase> (*this);			
-			hitData.hitObject = this -> shared_from_this();
-			
-			// Return the local point of intersection.
-			hitData.localPOI = currentLoc;			
-			
-			// Compute UV.		
-			ComputeUV(currentLoc, m_uvCoords);
-			hitData.uvCoords = m_uvCoords;				
+			double t = totalDist / labLength;
+			if (t > maxT)
+				return false;
+				
+			// Return the distance and the local point of intersection.
+			hitData.t = t;
+			hitData.localPOI = currentLoc;
+			hitData.partIndex = 0;
 		
 			return true;
 		}
@@ -150,6 +128,113 @@ bool qbRT::RM::RayMarchBase::TestIntersection(	const qbRT::Ray &castRay, qbRT::D
 	return false;
 }
 
+// Function to finalize the hit data.
+void qbRT::RM::RayMarchBase::FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData)
+{
+	// Transform the intersection point back into world coordinates.
+	hitData.poi = m_transformMatrix.Apply(hitData.localPOI, qbRT::FWDTFORM);
+	
+	// We need the direction of the ray in local coordinates to compute the normal.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	qbVector3<double> vhat = bckRay.m_lab;
+	vhat.Normalize();
+	
+	// Compute the local normal.
+	qbVector3<double> surfaceNormal;
+
+	/*
+	 Note the extra code here to compute an offset location from which
+	to compute the normal. The reason to do this is that in some cases,
+	especially with more complex distance functions, the point of intersection
+	can be computed as being very slightly inside the surface. This would
+	obviously result in a normal vector pointing in the wrong direction.
+	By tracing back along the intersecting ray a short distance and then using
+	that location instead, we can avoid this problem.
+	*/
+
+	// Determine an offset point.
+	qbVector3<double> normalLoc = hitData.localPOI - (vhat * 0.01);
+
+	qbVector3<double> x1 = normalLoc - m_xDisp;
+	qbVector3<double> x2 = normalLoc + m_xDisp;
+	qbVector3<double> y1 = normalLoc - m_yDisp;
+	qbVector3<double> y2 = normalLoc + m_yDisp;
+	qbVector3<double> z1 = normalLoc - m_zDisp;
+	qbVector3<double> z2 = normalLoc + m_zDisp;
+	surfaceNormal.SetElement(0, EvaluateSDF(&x2, &m_parms) - EvaluateSDF(&x1, &m_parms));
+	surfaceNormal.SetElement(1, EvaluateSDF(&y2, &m_parms) - EvaluateSDF(&y1, &m_parms));
+	surfaceNormal.SetElement(2, EvaluateSDF(&z2, &m_parms) - EvaluateSDF(&z1, &m_parms));
+
+	// Transform the local normal.
+	surfaceNormal.Normalize();
+	hitData.normal = m_transformMatrix.ApplyNorm(surfaceNormal);
+	
+	// Return the base color.
+	hitData.color = m_baseColor;
+	
+	// Compute UV, if it is needed.
+	if (NeedsUV())
+		ComputeUV(hitData.localPOI, hitData.uvCoords);
+	
+	// Return a pointer to this object.
+	hitData.hitObject = this;
+}
+
+// Test for occlusion.
+bool qbRT::RM::RayMarchBase::TestOcclusion(const qbRT::Ray &castRay, double maxT)
+{
+	// Check if an object function has been defined and that the object is visible.
+	if (!m_haveObjectFcn || !m_isVisible)
+		return false;
+		
+	// Copy the ray and apply the backwards transform.
+	qbRT::Ray bckRay = m_transformMatrix.Apply(castRay, qbRT::BCKTFORM);
+	
+	// Test for intersections with the bounding box (within maxT).
+	double tNear, tFar;
+	qbRT::ACCEL::slabRay slab;
+	qbRT::ACCEL::SetupSlabRay(bckRay, slab);
+	if (!qbRT::ACCEL::IntersectSlabs(m_localBounds, slab, 0.0, maxT, tNear, tFar))
+		return false;
+		
+	/* March along the ray as in TestIntersection(), but give up as soon
+		as we have travelled further than maxT. As we march along the normalized
+		direction, this is maxT scaled by the length of m_lab. */
+	qbVector3<double> vhat = bckRay.m_lab;
+	double maxDist = maxT * vhat.norm();
+	vhat.Normalize();
+	
+	qbVector3<double> currentLoc = bckRay.m_point1;
+	double totalDist = 0.0;
+	int stepCount = 0;
+	double dist = EvaluateSDF(&currentLoc, &m_parms);
+	while ((dist > m_epsilon) && (stepCount < m_maxSteps))
+	{
+		totalDist += dist;
+		if (totalDist > maxDist)
+			return false;
+			
+		currentLoc = currentLoc + (vhat * dist);
+		
+		dist = EvaluateSDF(&currentLoc, &m_parms);
+		if (dist > 1e6)
+			return false;
+			
+		stepCount++;
+	}
+	
+	// If m_maxSteps was exceeded, then there was no intersection.
+	return stepCount < m_maxSteps;
+}
+
+// Function to compute the bounding box in local coordinates.
+void qbRT::RM::RayMarchBase::ComputeLocalBounds(qbRT::DATA::aabb &localBounds)
+{
+	/* The surface is contained within the bounding box, which has its own
+		transform, so we use the extents of the box (which are in our local coordinates). */
+	localBounds = m_boundingBox.GetWorldBounds();
+}
+
 // Function to set the object function.
 void qbRT::RM::RayMarchBase::SetObjectFcn( std::function<double(qbVector3<double>*, qbVector3<double>*)> objectFcn )
 {
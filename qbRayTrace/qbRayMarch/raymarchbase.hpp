@@ -37,6 +37,7 @@
 #include "sdfunc.hpp"
 #include "../qbPrimatives/objectbase.hpp"
 #include "../qbPrimatives/box.hpp"
+#include "../qbAccel/slab.hpp"
 #include "../qbLinAlg/qbVector2.hpp"
 #include "../qbLinAlg/qbVector3.hpp"
 #include "../qbLinAlg/qbVector4.hpp"
@@ -55,7 +56,13 @@ namespace qbRT
 				virtual ~RayMarchBase() override;
 				
 				// Override the function to test for intersections.
-				virtual bool TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+				virtual bool TestIntersection(	const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData, double maxT) override;
+				
+				// Override the function to finalize the hit data.
+				virtual void FinalizeHit(const qbRT::Ray &castRay, qbRT::DATA::hitData &hitData) override;
+				
+				// Override the function to test for occlusion.
+				virtual bool TestOcclusion(const qbRT::Ray &castRay, double maxT) override;
 				
 				// Function to set the object function.
 				void SetObjectFcn( std::function<double(qbVector3<double>*, qbVector3<double>*)> objectFcn);
@@ -63,6 +70,10 @@ namespace qbRT
 				// Function to evaluate the Signed Distance Function (SDF) at the given coordinates.
 				double EvaluateSDF(	qbVector3<double> *location, qbVector3<double> *parms );
 												
+			protected:
+				// Override the function to compute the bounding box in local coordinates (this comes from the bounding box).
+				virtual void ComputeLocalBounds(qbRT::DATA::aabb &localBounds) override;
+				
 			public:
 				// Bounding box.
 				qbRT::Box m_boundingBox = qbRT::Box();
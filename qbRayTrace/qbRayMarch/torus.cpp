@@ -45,6 +45,9 @@ qbRT::RM::Torus::Torus()
 	m_boundingBox.SetTransformMatrix(qbRT::GTform { qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{1.3, 1.3, 1.3}} } );
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 qbRT::RM::Torus::~Torus()
@@ -66,6 +69,9 @@ void qbRT::RM::Torus::UpdateBounds()
 	m_boundingBox.SetTransformMatrix(qbRT::GTform { qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{0.0, 0.0, 0.0}},
 																									qbVector3<double>{std::vector<double>{m_r1+m_r2+0.3, m_r1+m_r2+0.3, m_r2 + 0.2}} } );	
+	
+	// Update the cached extents to match.
+	UpdateExtents();
 }
 
 // The private object function.
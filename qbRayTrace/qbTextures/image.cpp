@@ -39,12 +39,7 @@ qbRT::Texture::Image::Image()
 
 qbRT::Texture::Image::~Image()
 {
-	if (m_imageLoaded)
-	{
-		// Make sure that we free the image surface.
-		SDL_FreeSurface(m_imageSurface);
-		m_imageLoaded = false;
-	}
+
 }
 
 qbVector4<double> qbRT::Texture::Image::GetColor(const qbVector2<double> &uvCoords)
@@ -113,33 +108,19 @@ qbVector4<double> qbRT::Texture::Image::GetColor(const qbVector2<double> &uvCoor
 
 bool qbRT::Texture::Image::LoadImage(std::string fileName)
 {
-	if (m_imageLoaded)
-		SDL_FreeSurface(m_imageSurface);
-	
 	m_fileName = fileName;
-	m_imageSurface = SDL_LoadBMP(fileName.c_str());
-	
-	if (!m_imageSurface)
+	m_imageLoaded = false;
+	if (!m_image.LoadBMP(fileName))
 	{
-		std::cout << "Failed to load image. " << SDL_GetError() << "." << std::endl;
-		m_imageLoaded = false;
+		std::cout << "Failed to load image " << fileName << "." << std::endl;
 		return false;
 	}
 
 	// Extract useful information.
-	m_xSize = m_imageSurface->w;
-	m_ySize = m_imageSurface->h;
-	m_pitch = m_imageSurface->pitch;
-	m_pixelFormat = m_imageSurface->format;
-	m_bytesPerPixel = m_pixelFormat->BytesPerPixel;
-	m_rMask = m_pixelFormat->Rmask;
-	m_gMask = m_pixelFormat->Gmask;
-	m_bMask = m_pixelFormat->Bmask;
-	m_aMask = m_pixelFormat->Amask;
+	m_xSize = m_image.GetXSize();
+	m_ySize = m_image.GetYSize();
 	
-	std::cout << "Loaded " << m_imageSurface->w << " by " << m_imageSurface->h << "." << std::endl;
-	std::cout << "Bytes per pixel = " << +m_bytesPerPixel << std::endl;
-	std::cout << "Pitch = " << m_pitch << std::endl;
+	std::cout << "Loaded " << m_xSize << " by " << m_ySize << "." << std::endl;
 
 	m_imageLoaded = true;
 	return true;
@@ -154,40 +135,15 @@ void qbRT::Texture::Image::GetPixelValue(int x, int y, double &red, double &gree
 {
 	if ((x >= 0) && (x < m_xSize) && (y >= 0) && (y < m_ySize))
 	{	
-		// Convert (x,y) to a linear index, in bytes.
-		int pixelIndex = (x * m_bytesPerPixel) + (y * m_pitch);
-			
-		// Get a pointer to the pixel data.
-		uint8_t *pixels = (uint8_t *)m_imageSurface->pixels;
-			
-		// Extract the current pixel value.
-		std::array<uint8_t, 4> byteValues;
-		uint32_t currentPixel = 0;
-		for (int i=0; i<m_bytesPerPixel; ++i)
-		{
-			byteValues.at(i) = pixels[pixelIndex+i];
-		}
-
-		// Assemble the final pixel value, according to the number of bytes per pixel.
-		switch (m_bytesPerPixel)
-		{
-			case 3:
-				currentPixel = byteValues.at(0) | (byteValues.at(1) << 8) | (byteValues.at(2) << 16);
-				break;
-				
-			case 4:
-				currentPixel = byteValues.at(0) | (byteValues.at(1) << 8) | (byteValues.at(2) << 16) | (byteValues.at(3) << 24);
-				break;
-		}
-			
-		// Convert to RGB.
-		uint8_t r, g, b, a;
-		SDL_GetRGBA(currentPixel, m_imageSurface->format, &r, &g, &b, &a);
+		// Get the RGBA value of the pixel.
+		uint8_t r = 0, g = 0, b = 0, a = 255;
+		m_image.GetPixel(x, y, r, g, b, a);
 			
 		// Return the color.		
 		red = static_cast<double>(r);
 		green = static_cast<double>(g);
 		blue = static_cast<double>(b);
+		alpha = static_cast<double>(a);
 	}	
 }
 // ************************************************************************
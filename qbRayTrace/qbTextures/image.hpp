@@ -33,7 +33,7 @@
 #define IMAGE_H
 
 #include "texturebase.hpp"
-#include <SDL2/SDL.h>
+#include "../bitmap.hpp"
 
 namespace qbRT
 {
@@ -65,12 +65,9 @@ namespace qbRT
 				
 			private:
 				std::string m_fileName;
-				SDL_Surface *m_imageSurface;
-				SDL_PixelFormat *m_pixelFormat;
+				qbRT::Bitmap m_image;
 				bool m_imageLoaded = false;
-				int m_xSize, m_ySize, m_pitch;
-				uint8_t m_bytesPerPixel;
-				uint32_t m_rMask, m_gMask, m_bMask, m_aMask;				
+				int m_xSize, m_ySize;
 							
 		};
 	}
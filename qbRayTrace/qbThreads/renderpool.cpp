@@ -0,0 +1,360 @@
+/* ***********************************************************
+	renderpool.cpp
+
+	The RenderPool class implementation - A class to implement a
+	persistent pool of worker threads with per-worker work-stealing
+	deques.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "renderpool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+
+// Default constructor.
+qbRT::Threads::RenderPool::RenderPool()
+{
+
+}
+
+// The destructor.
+qbRT::Threads::RenderPool::~RenderPool()
+{
+	Stop();
+}
+
+// Function to start the worker threads.
+bool qbRT::Threads::RenderPool::Start(int numThreads, std::function<void(int)> jobFunction)
+{
+	// We don't allow the pool to be started twice.
+	if (!m_workers.empty())
+		return false;
+
+	// If the number of threads has not been specified, use the number of hardware threads.
+	if (numThreads < 1)
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+
+	// hardware_concurrency() is allowed to return zero if it can't work it out.
+	if (numThreads < 1)
+		numThreads = 1;
+
+	m_jobFunction = jobFunction;
+	m_stopRequested.store(false);
+
+	// Setup the state for each worker before any of the threads start,
+	// because the workers need to be able to see each other's deques.
+	m_workerStates.clear();
+	for (int i=0; i<numThreads; ++i)
+		m_workerStates.push_back(std::make_unique<workerState>());
+
+	// Create the worker threads.
+	for (int i=0; i<numThreads; ++i)
+		m_workers.push_back(std::thread(&qbRT::Threads::RenderPool::WorkerLoop, this, i));
+
+	std::cout << "Started " << numThreads << " render threads." << std::endl;
+
+	return true;
+}
+
+// Function to stop the worker threads.
+void qbRT::Threads::RenderPool::Stop()
+{
+	if (m_workers.empty())
+		return;
+
+	// Tell the workers to exit.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopRequested.store(true);
+	}
+	m_sleepCondition.notify_all();
+
+	// Wait for the workers to finish whatever they are currently doing.
+	for (auto &worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+	m_workerStates.clear();
+
+	// Discard anything that was still waiting.
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_sharedQueue.clear();
+	}
+	m_numPending.store(0);
+}
+
+// Function to submit a job.
+void qbRT::Threads::RenderPool::Submit(int jobIndex)
+{
+	m_numPending.fetch_add(1);
+
+	// If we are on one of our own worker threads, then push the job onto
+	// that worker's deque where it can be stolen by any idle workers.
+	bool submitted = false;
+	if ((m_currentPool == this) && (m_currentWorker >= 0))
+		submitted = m_workerStates.at(m_currentWorker) -> deque.Push(jobIndex);
+
+	// Otherwise (or if the deque is full), use the shared queue.
+	if (!submitted)
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_sharedQueue.push_back(jobIndex);
+	}
+
+	WakeWorker();
+}
+
+// Function to re-order the shared queue.
+void qbRT::Threads::RenderPool::ReorderQueue(const std::function<bool(int, int)> &compare)
+{
+	std::lock_guard<std::mutex> lock(m_sharedMutex);
+	std::stable_sort(m_sharedQueue.begin(), m_sharedQueue.end(), compare);
+}
+
+// Function to return the number of worker threads.
+int qbRT::Threads::RenderPool::GetNumThreads()
+{
+	return static_cast<int>(m_workers.size());
+}
+
+// Function to return the per-worker statistics.
+std::vector<qbRT::Threads::workerStats> qbRT::Threads::RenderPool::GetWorkerStats()
+{
+	std::vector<qbRT::Threads::workerStats> statsList;
+	long long timeNow = GetTimeNanoseconds();
+	for (auto &state : m_workerStates)
+	{
+		qbRT::Threads::workerStats stats;
+		stats.tilesRun = state -> tilesRun.load(std::memory_order_relaxed);
+		stats.tilesStolen = state -> tilesStolen.load(std::memory_order_relaxed);
+
+		// Include the time that the worker has been idle for so far, if it is idle now.
+		long long idleNanoseconds = state -> idleNanoseconds.load(std::memory_order_relaxed);
+		long long idleSince = state -> idleSince.load(std::memory_order_relaxed);
+		if (idleSince >= 0)
+			idleNanoseconds += std::max(timeNow - idleSince, 0LL);
+
+		stats.idleTime = static_cast<double>(idleNanoseconds) * 1e-9;
+		statsList.push_back(stats);
+	}
+
+	return statsList;
+}
+
+// Function to reset the per-worker statistics.
+void qbRT::Threads::RenderPool::ResetWorkerStats()
+{
+	long long timeNow = GetTimeNanoseconds();
+	for (auto &state : m_workerStates)
+	{
+		state -> tilesRun.store(0, std::memory_order_relaxed);
+		state -> tilesStolen.store(0, std::memory_order_relaxed);
+		state -> idleNanoseconds.store(0, std::memory_order_relaxed);
+
+		// Idle workers start counting again from now.
+		long long idleSince = state -> idleSince.load(std::memory_order_relaxed);
+		if (idleSince >= 0)
+			state -> idleSince.compare_exchange_strong(idleSince, timeNow, std::memory_order_relaxed);
+	}
+}
+
+// Function to print the per-worker statistics.
+void qbRT::Threads::RenderPool::PrintWorkerStats()
+{
+	std::vector<qbRT::Threads::workerStats> statsList = GetWorkerStats();
+	long totalRun = 0;
+	long totalStolen = 0;
+	double totalIdle = 0.0;
+
+	std::cout << "Worker    Tiles    Stolen    Idle (s)" << std::endl;
+	for (size_t i=0; i<statsList.size(); ++i)
+	{
+		std::cout << std::setw(6) << i << std::setw(9) << statsList.at(i).tilesRun;
+		std::cout << std::setw(10) << statsList.at(i).tilesStolen;
+		std::cout << std::setw(12) << std::fixed << std::setprecision(3) << statsList.at(i).idleTime << std::endl;
+		totalRun += statsList.at(i).tilesRun;
+		totalStolen += statsList.at(i).tilesStolen;
+		totalIdle += statsList.at(i).idleTime;
+	}
+	std::cout << " Total" << std::setw(9) << totalRun << std::setw(10) << totalStolen;
+	std::cout << std::setw(12) << std::fixed << std::setprecision(3) << totalIdle << std::endl;
+}
+
+// The function that is run by each of the worker threads.
+void qbRT::Threads::RenderPool::WorkerLoop(int workerIndex)
+{
+	m_currentPool = this;
+	m_currentWorker = workerIndex;
+	workerState &state = *m_workerStates.at(workerIndex);
+
+	// Each worker uses its own (very simple) random number generator to pick victims to steal from.
+	unsigned int randomState = 2654435761u * static_cast<unsigned int>(workerIndex + 1);
+
+	state.idleSince.store(GetTimeNanoseconds(), std::memory_order_relaxed);
+	while (!m_stopRequested.load(std::memory_order_acquire))
+	{
+		int jobIndex;
+		if (FindJob(workerIndex, randomState, jobIndex))
+		{
+			// We are no longer idle, so add the time we spent looking for work to the total.
+			long long timeNow = GetTimeNanoseconds();
+			long long idleSince = state.idleSince.exchange(-1, std::memory_order_relaxed);
+			if (idleSince >= 0)
+				state.idleNanoseconds.fetch_add(std::max(timeNow - idleSince, 0LL), std::memory_order_relaxed);
+
+			/* Count the job before running it, as the job itself may report that the frame
+				is complete, and whoever is waiting for that may read the stats straight away. */
+			state.tilesRun.fetch_add(1, std::memory_order_relaxed);
+			m_jobFunction(jobIndex);
+
+			state.idleSince.store(GetTimeNanoseconds(), std::memory_order_relaxed);
+			continue;
+		}
+
+		/*
+			A steal can fail because another thread won the race for the job,
+			or a job may be part way through being submitted, so if anything
+			is still pending we just have another go.
+		*/
+		if (m_numPending.load() > 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		/*
+			There was no work anywhere, so go to sleep until a new job is
+			submitted. Checking m_numPending while holding the sleep mutex
+			means that we can't miss a wake-up from Submit(). Note that
+			m_numPending and m_numSleeping use sequentially consistent
+			operations, so that either we see the new job here or Submit()
+			sees that we are (about to be) asleep.
+		*/
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_numSleeping.fetch_add(1);
+		m_sleepCondition.wait(lock, [this]{ return m_stopRequested.load() || (m_numPending.load() > 0); });
+		m_numSleeping.fetch_sub(1);
+	}
+
+	m_currentPool = nullptr;
+	m_currentWorker = -1;
+}
+
+// Function to find the next job for the given worker.
+bool qbRT::Threads::RenderPool::FindJob(int workerIndex, unsigned int &randomState, int &jobIndex)
+{
+	workerState &state = *m_workerStates.at(workerIndex);
+
+	// First try our own deque.
+	if (state.deque.Pop(jobIndex))
+	{
+		m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+		return true;
+	}
+
+	/*
+		Next try the shared queue. We take a batch of jobs proportional to the
+		amount of work remaining (guided scheduling), so that we don't keep
+		going back to the shared queue, but so that the other workers still get
+		a fair share. The first job in the batch is run now, the rest are pushed
+		onto our own deque in reverse order, so that we pop them in the order in
+		which they were submitted, while thieves steal from the far end.
+	*/
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		if (!m_sharedQueue.empty())
+		{
+			int numWorkers = static_cast<int>(m_workerStates.size());
+			int batchSize = std::max(1, static_cast<int>(m_sharedQueue.size()) / (2 * numWorkers));
+			batchSize = std::min(batchSize, m_dequeCapacity - state.deque.GetSize());
+			batchSize = std::max(batchSize, 1);
+
+			jobIndex = m_sharedQueue.front();
+			m_sharedQueue.pop_front();
+			m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+
+			// The batch size is limited by the free space in our deque, and
+			// only we push onto it, so these pushes can't fail.
+			int numToMove = std::min(batchSize - 1, static_cast<int>(m_sharedQueue.size()));
+			for (int i=numToMove-1; i>=0; --i)
+				state.deque.Push(m_sharedQueue.at(i));
+				
+			m_sharedQueue.erase(m_sharedQueue.begin(), m_sharedQueue.begin() + numToMove);
+
+			return true;
+		}
+	}
+
+	// Finally, try to steal from the other workers, starting with a random victim.
+	int numWorkers = static_cast<int>(m_workerStates.size());
+	if (numWorkers > 1)
+	{
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 17;
+		randomState ^= randomState << 5;
+		int firstVictim = static_cast<int>(randomState % static_cast<unsigned int>(numWorkers));
+
+		for (int i=0; i<numWorkers; ++i)
+		{
+			int victim = (firstVictim + i) % numWorkers;
+			if (victim == workerIndex)
+				continue;
+
+			if (m_workerStates.at(victim) -> deque.Steal(jobIndex))
+			{
+				m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+				state.tilesStolen.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Function to wake up a sleeping worker.
+void qbRT::Threads::RenderPool::WakeWorker()
+{
+	if (m_numSleeping.load() > 0)
+	{
+		// Taking the lock here makes sure that a worker that is just about to
+		// go to sleep sees the new job before it waits.
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_sleepCondition.notify_one();
+	}
+}
+
+// Function to return the current time, in nanoseconds.
+long long qbRT::Threads::RenderPool::GetTimeNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,167 @@
+/* ***********************************************************
+	renderpool.hpp
+
+	The RenderPool class definition - A class to implement a
+	persistent pool of worker threads. The threads are created
+	once, when the pool is started, and then repeatedly pick up
+	jobs (tile indices) until the pool is stopped.
+
+	Each worker owns a lock-free work-stealing deque. Jobs that
+	are submitted from outside the pool go into a shared queue,
+	from which idle workers take small batches into their own
+	deque. A worker that runs out of work steals jobs from the
+	other workers before going to sleep, so that expensive tiles
+	don't leave cores idle at the end of a frame.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include "workdeque.hpp"
+
+namespace qbRT
+{
+	namespace Threads
+	{
+		// Structure for returning the statistics for a single worker.
+		struct workerStats
+		{
+			long tilesRun = 0;
+			long tilesStolen = 0;
+			double idleTime = 0.0;
+		};
+
+		class RenderPool
+		{
+			public:
+				// Default constructor.
+				RenderPool();
+
+				// The destructor (stops the pool if it is still running).
+				~RenderPool();
+
+				/*
+					Function to start the worker threads. If numThreads is
+					less than 1, then the number of threads is taken from
+					std::thread::hardware_concurrency(). The job function is
+					called, on one of the worker threads, once for each job
+					index that is submitted.
+				*/
+				bool Start(int numThreads, std::function<void(int)> jobFunction);
+
+				// Function to stop the worker threads. Any jobs that are still
+				// waiting are discarded, but jobs that are already running are
+				// allowed to finish before this function returns.
+				void Stop();
+
+				// Function to submit a job. When called from one of the worker
+				// threads (for example to hand off part of a job), the job goes
+				// onto that worker's own deque, otherwise it goes to the shared queue.
+				void Submit(int jobIndex);
+
+				// Function to re-order the jobs that are still waiting in the shared
+				// queue. Jobs that are already in a worker's deque are not affected.
+				void ReorderQueue(const std::function<bool(int, int)> &compare);
+
+				// Function to return the number of worker threads.
+				int GetNumThreads();
+
+				// Functions to return, reset and print the per-worker statistics.
+				std::vector<qbRT::Threads::workerStats> GetWorkerStats();
+				void ResetWorkerStats();
+				void PrintWorkerStats();
+
+			private:
+				// The state belonging to a single worker.
+				struct workerState
+				{
+					workerState() : deque(m_dequeCapacity) {}
+
+					qbRT::Threads::WorkDeque deque;
+					std::atomic<long> tilesRun {0};
+					std::atomic<long> tilesStolen {0};
+					std::atomic<long long> idleNanoseconds {0};
+
+					// The time at which this worker became idle (or -1 if it is busy).
+					std::atomic<long long> idleSince {-1};
+				};
+
+				// The function that is run by each of the worker threads.
+				void WorkerLoop(int workerIndex);
+
+				// Function to find the next job for the given worker.
+				bool FindJob(int workerIndex, unsigned int &randomState, int &jobIndex);
+
+				// Function to wake up a sleeping worker (if there are any).
+				void WakeWorker();
+
+				// Function to return the current time, in nanoseconds.
+				static long long GetTimeNanoseconds();
+
+			private:
+				// The worker threads and their state.
+				std::vector<std::thread> m_workers;
+				std::vector<std::unique_ptr<workerState>> m_workerStates;
+
+				// The shared queue of jobs submitted from outside the pool.
+				std::deque<int> m_sharedQueue;
+				std::mutex m_sharedMutex;
+
+				// Used by workers to sleep when there is no work anywhere.
+				std::mutex m_sleepMutex;
+				std::condition_variable m_sleepCondition;
+				std::atomic<int> m_numSleeping {0};
+
+				// The number of jobs that have been submitted but not yet picked up.
+				std::atomic<long> m_numPending {0};
+
+				// The function to call for each job.
+				std::function<void(int)> m_jobFunction;
+
+				// Flag to indicate that the workers should exit.
+				std::atomic<bool> m_stopRequested {false};
+
+				// The capacity of each worker's deque.
+				inline static const int m_dequeCapacity = 4096;
+
+				// Identifies the pool and worker that the current thread belongs to.
+				inline static thread_local qbRT::Threads::RenderPool *m_currentPool = nullptr;
+				inline static thread_local int m_currentWorker = -1;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,666 @@
+/* ***********************************************************
+	tilescheduler.cpp
+
+	The TileScheduler class implementation - A class to manage the
+	grid of tiles that make up a frame and to hand them out to
+	a pool of render threads.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "tilescheduler.hpp"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+
+// Default constructor.
+qbRT::Threads::TileScheduler::TileScheduler()
+{
+
+}
+
+// The destructor.
+qbRT::Threads::TileScheduler::~TileScheduler()
+{
+	Stop();
+}
+
+// Function to generate the tile grid.
+bool qbRT::Threads::TileScheduler::GenerateTileGrid(int xSize, int ySize, int tileSizeX, int tileSizeY)
+{
+	// We can't change the tiles while the render threads might be using them.
+	if (m_numGridTilesPending.load() > 0)
+		return false;
+
+	if ((tileSizeX < 1) || (tileSizeY < 1))
+		return false;
+
+	// How many tiles do we need to cover the image? If the image size is not
+	// a multiple of the tile size, then the tiles on the right and bottom edges are smaller.
+	int numTilesX = (xSize + tileSizeX - 1) / tileSizeX;
+	int numTilesY = (ySize + tileSizeY - 1) / tileSizeY;
+	m_numGridTiles = numTilesX * numTilesY;
+	m_numTilesX = numTilesX;
+	m_numTilesY = numTilesY;
+
+	/*
+		Each split produces two children, and a tile can only be split
+		m_maxSplitDepth times, so each grid tile can produce at most
+		2^(m_maxSplitDepth + 1) - 1 tiles in total (including itself).
+	*/
+	int maxTilesPerGridTile = (1 << (std::max(m_maxSplitDepth, 0) + 1)) - 1;
+	int capacity = m_numGridTiles * maxTilesPerGridTile;
+
+	m_tiles.clear();
+	m_tiles.resize(capacity);
+
+	// Generate the actual tiles.
+	for (int y=0; y<numTilesY; ++y)
+	{
+		for (int x=0; x<numTilesX; ++x)
+		{
+			int tileIndex = (y * numTilesX) + x;
+			qbRT::DATA::tile &tile = m_tiles.at(tileIndex);
+			tile.x = x * tileSizeX;
+			tile.y = y * tileSizeY;
+			tile.xSize = std::min(tileSizeX, xSize - tile.x);
+			tile.ySize = std::min(tileSizeY, ySize - tile.y);
+			tile.renderComplete = 0;
+			tile.rootIndex = tileIndex;
+		}
+	}
+
+	// Remember the original size of the grid tiles, so that we can undo any splits.
+	m_gridTiles.assign(m_tiles.begin(), m_tiles.begin() + m_numGridTiles);
+	m_numTiles.store(m_numGridTiles);
+
+	m_frameBuffer.Initialize(xSize, ySize);
+
+	// Setup the tile states and counters.
+	m_tileStates.reset(new std::atomic<int> [capacity]);
+	m_pendingCounts.reset(new std::atomic<int> [capacity]);
+	for (int i=0; i<capacity; ++i)
+	{
+		m_tileStates[i].store(qbRT::Threads::TILE_WAITING);
+		m_pendingCounts[i].store(0);
+	}
+
+	m_gridTileCosts.reset(new std::atomic<long long> [m_numGridTiles]);
+	for (int i=0; i<m_numGridTiles; ++i)
+		m_gridTileCosts[i].store(0);
+
+	m_lastGridTileCosts.assign(m_numGridTiles, 0);
+
+	// Focus on the center of the image until we are told otherwise.
+	m_focusX = xSize / 2;
+	m_focusY = ySize / 2;
+	ComputeDispatchOrder();
+
+	return true;
+}
+
+// Function to set the tile callback.
+void qbRT::Threads::TileScheduler::SetTileCallback(std::function<void(int)> tileCallback)
+{
+	m_tileCallback = tileCallback;
+}
+
+// Function to start the render threads.
+bool qbRT::Threads::TileScheduler::Start(qbRT::Scene *pScene, int numThreads)
+{
+	m_pScene = pScene;
+	return m_renderPool.Start(numThreads, [this](int tileIndex){ RenderTile(tileIndex); });
+}
+
+// Function to stop the render threads.
+void qbRT::Threads::TileScheduler::Stop()
+{
+	m_renderPool.Stop();
+	m_numGridTilesPending.store(0);
+}
+
+// Function to start rendering a new frame.
+bool qbRT::Threads::TileScheduler::StartFrame()
+{
+	// Don't start a new frame until the last one is finished.
+	if ((m_pScene == nullptr) || (m_numGridTiles == 0) || (m_numGridTilesPending.load() > 0))
+		return false;
+
+	// Keep the cost of each grid tile from the last frame as an estimate for this one.
+	for (int i=0; i<m_numGridTiles; ++i)
+	{
+		m_lastGridTileCosts.at(i) = m_gridTileCosts[i].load();
+		m_gridTileCosts[i].store(0);
+	}
+
+	// Undo any splits from the last frame.
+	int numTiles = m_numTiles.load();
+	for (int i=0; i<numTiles; ++i)
+	{
+		if (i < m_numGridTiles)
+			m_tiles.at(i) = m_gridTiles.at(i);
+
+		m_tileStates[i].store(qbRT::Threads::TILE_WAITING);
+		m_pendingCounts[i].store(1);
+	}
+	m_numTiles.store(m_numGridTiles);
+
+	// Anything that was not collected from the last frame refers to tiles that no longer exist.
+	{
+		std::lock_guard<std::mutex> lock(m_completedMutex);
+		m_completedTiles.clear();
+	}
+
+	// The objects in the scene may have changed since the last frame.
+	m_pScene -> BuildBVH();
+
+	m_numSplits.store(0);
+	m_numPreSplits = 0;
+	m_frameTime.store(0);
+	m_frameStartTime = std::chrono::steady_clock::now();
+	m_renderPool.ResetWorkerStats();
+	m_numGridTilesPending.store(m_numGridTiles);
+
+	// The focus point may have moved since the last frame.
+	if (m_tileOrder == qbRT::Threads::TILE_ORDER_CURSOR)
+		ComputeDispatchOrder();
+
+	// Dispatch the tiles.
+	for (auto i : m_dispatchOrder)
+	{
+		/*
+			If this tile took longer than the budget last time, then split
+			it before dispatching it. Each split halves the area, so we need
+			to split log2(cost / budget) times to bring it within budget.
+		*/
+		int numSplits = 0;
+		double lastCost = static_cast<double>(m_lastGridTileCosts.at(i)) * 1e-9;
+		if ((m_tileBudget > 0.0) && (lastCost > m_tileBudget))
+			numSplits = std::min(static_cast<int>(std::ceil(std::log2(lastCost / m_tileBudget))), m_maxSplitDepth);
+
+		std::vector<int> tilesToSplit {i};
+		for (int level=0; level<numSplits; ++level)
+		{
+			std::vector<int> splitTiles;
+			for (auto tileIndex : tilesToSplit)
+			{
+				int child1, child2;
+				if (SplitRemainder(tileIndex, 0, child1, child2))
+				{
+					// The tile that we split now has nothing left to render itself.
+					m_tileStates[tileIndex].store(qbRT::Threads::TILE_COMPLETE, std::memory_order_release);
+					FinishTile(tileIndex);
+					splitTiles.push_back(child1);
+					splitTiles.push_back(child2);
+					m_numPreSplits++;
+				}
+				else
+				{
+					splitTiles.push_back(tileIndex);
+				}
+			}
+			tilesToSplit = splitTiles;
+		}
+
+		for (auto tileIndex : tilesToSplit)
+			m_renderPool.Submit(tileIndex);
+	}
+
+	return true;
+}
+
+// Function to set the order in which the grid tiles are dispatched.
+bool qbRT::Threads::TileScheduler::SetTileOrder(int tileOrder)
+{
+	if ((tileOrder < qbRT::Threads::TILE_ORDER_ROWMAJOR) || (tileOrder > qbRT::Threads::TILE_ORDER_CURSOR))
+		return false;
+
+	m_tileOrder = tileOrder;
+	ComputeDispatchOrder();
+	return true;
+}
+
+// Function to return the current tile order.
+int qbRT::Threads::TileScheduler::GetTileOrder()
+{
+	return m_tileOrder;
+}
+
+// Function to set the focus point.
+void qbRT::Threads::TileScheduler::SetFocusPoint(int x, int y)
+{
+	m_focusX = x;
+	m_focusY = y;
+
+	/*
+		Re-order any tiles that have not yet been picked up, so that the
+		ones nearest to the focus point go first. Tiles that the workers
+		have already taken into their own deques are not affected, but the
+		workers only take a small share of the queue at a time.
+	*/
+	if ((m_tileOrder == qbRT::Threads::TILE_ORDER_CURSOR) && !IsFrameComplete())
+	{
+		m_renderPool.ReorderQueue([this](int tile1, int tile2)
+		{
+			return GetFocusDistance(tile1) < GetFocusDistance(tile2);
+		});
+	}
+}
+
+// Function to return the number of tiles.
+int qbRT::Threads::TileScheduler::GetNumTiles()
+{
+	return m_numTiles.load(std::memory_order_acquire);
+}
+
+// Function to return the number of tiles in the original grid.
+int qbRT::Threads::TileScheduler::GetNumGridTiles()
+{
+	return m_numGridTiles;
+}
+
+// Function to return a reference to a tile.
+qbRT::DATA::tile& qbRT::Threads::TileScheduler::GetTile(int tileIndex)
+{
+	return m_tiles.at(tileIndex);
+}
+
+// Function to return the frame buffer.
+qbRT::FrameBuffer& qbRT::Threads::TileScheduler::GetFrameBuffer()
+{
+	return m_frameBuffer;
+}
+
+// Function to return the state of a tile.
+int qbRT::Threads::TileScheduler::GetTileState(int tileIndex)
+{
+	return m_tileStates[tileIndex].load(std::memory_order_acquire);
+}
+
+// Function to collect the tiles that have finished rendering.
+bool qbRT::Threads::TileScheduler::GetCompletedTiles(std::vector<int> &tileList)
+{
+	tileList.clear();
+	std::lock_guard<std::mutex> lock(m_completedMutex);
+	if (m_completedTiles.empty())
+		return false;
+
+	tileList.swap(m_completedTiles);
+	return true;
+}
+
+// Function to test whether a tile and all of its children have been rendered.
+bool qbRT::Threads::TileScheduler::IsTileComplete(int tileIndex)
+{
+	return (m_pendingCounts[tileIndex].load(std::memory_order_acquire) == 0);
+}
+
+// Function to test whether the whole frame has been rendered.
+bool qbRT::Threads::TileScheduler::IsFrameComplete()
+{
+	return (m_numGridTilesPending.load(std::memory_order_acquire) == 0);
+}
+
+// Function to return the number of secondary rays spawned (and culled) over the last frame.
+qbRT::DATA::rayStats qbRT::Threads::TileScheduler::GetRayStats()
+{
+	qbRT::DATA::rayStats frameStats;
+	int numTiles = m_numTiles.load();
+	for (int i=0; i<numTiles; ++i)
+	{
+		frameStats.secondaryRays += m_tiles.at(i).rayStats.secondaryRays;
+		frameStats.culledRays += m_tiles.at(i).rayStats.culledRays;
+	}
+	
+	return frameStats;
+}
+
+// Function to print the statistics for the last frame.
+void qbRT::Threads::TileScheduler::PrintStats()
+{
+	std::cout << "Frame time: " << std::fixed << std::setprecision(3) << static_cast<double>(m_frameTime.load()) * 1e-9 << "s";
+	std::cout << " (" << m_numGridTiles << " tiles, " << m_numPreSplits << " split in advance, ";
+	std::cout << m_numSplits.load() << " split over budget)" << std::endl;
+	
+	qbRT::DATA::rayStats frameStats = GetRayStats();
+	if (frameStats.secondaryRays > 0)
+	{
+		std::cout << "Secondary rays: " << frameStats.secondaryRays << " spawned, " << frameStats.culledRays << " culled (";
+		std::cout << std::setprecision(1) << 100.0 * static_cast<double>(frameStats.culledRays) / static_cast<double>(frameStats.secondaryRays) << "%)" << std::endl;
+	}
+	
+	m_renderPool.PrintWorkerStats();
+}
+
+// Function to render a tile.
+void qbRT::Threads::TileScheduler::RenderTile(int tileIndex)
+{
+	qbRT::DATA::tile &tile = m_tiles.at(tileIndex);
+	m_tileStates[tileIndex].store(qbRT::Threads::TILE_RENDERING, std::memory_order_release);
+	auto startTime = std::chrono::steady_clock::now();
+
+	// Only give the scene a time budget if we are allowed to split this tile any further.
+	double timeBudget = 0.0;
+	if ((m_tileBudget > 0.0) && (tile.splitDepth < m_maxSplitDepth))
+		timeBudget = m_tileBudget;
+
+	int rowsRendered = m_pScene -> RenderTile(&tile, &m_frameBuffer, timeBudget);
+	if (rowsRendered < tile.ySize)
+	{
+		// We ran out of time, so hand the rest of the tile to our children.
+		// They go onto this worker's deque, where idle workers can steal them.
+		int child1, child2;
+		if (SplitRemainder(tileIndex, rowsRendered, child1, child2))
+		{
+			m_numSplits.fetch_add(1);
+			m_renderPool.Submit(child2);
+			m_renderPool.Submit(child1);
+		}
+		else
+		{
+			// The tile is too small to split, so just finish it off here.
+			m_pScene -> RenderTile(&tile, &m_frameBuffer, 0.0, rowsRendered);
+		}
+	}
+
+	// Add the time spent on this tile to the cost of the grid tile that it came from.
+	std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - startTime;
+	m_gridTileCosts[tile.rootIndex].fetch_add(static_cast<long long>(renderTime.count() * 1e9));
+
+	m_tileStates[tileIndex].store(qbRT::Threads::TILE_COMPLETE, std::memory_order_release);
+
+	/*
+		Queue the tile for display before we finish it, so that it can't be
+		queued after the next frame has started. The callback comes after,
+		so that the display thread sees the frame as complete when it is
+		woken for the last tile.
+	*/
+	{
+		std::lock_guard<std::mutex> lock(m_completedMutex);
+		m_completedTiles.push_back(tileIndex);
+	}
+
+	FinishTile(tileIndex);
+
+	if (m_tileCallback)
+		m_tileCallback(tileIndex);
+}
+
+// Function to setup a child tile.
+void qbRT::Threads::TileScheduler::SetupChildTile(int tileIndex, int parentIndex, int x, int y, int xSize, int ySize)
+{
+	const qbRT::DATA::tile &parent = m_tiles.at(parentIndex);
+	qbRT::DATA::tile &child = m_tiles.at(tileIndex);
+	child.x = x;
+	child.y = y;
+	child.xSize = xSize;
+	child.ySize = ySize;
+	child.renderComplete = 0;
+	child.parentIndex = parentIndex;
+	child.rootIndex = parent.rootIndex;
+	child.splitDepth = parent.splitDepth + 1;
+	child.numChildren = 0;
+	child.rayStats = qbRT::DATA::rayStats();
+
+	m_tileStates[tileIndex].store(qbRT::Threads::TILE_WAITING);
+	m_pendingCounts[tileIndex].store(1);
+}
+
+// Function to split the remaining rows of a tile.
+bool qbRT::Threads::TileScheduler::SplitRemainder(int tileIndex, int rowsRendered, int &child1, int &child2)
+{
+	qbRT::DATA::tile &tile = m_tiles.at(tileIndex);
+	if (tile.splitDepth >= m_maxSplitDepth)
+		return false;
+
+	// Split whichever way gives the squarest children.
+	int x = tile.x;
+	int y = tile.y + rowsRendered;
+	int xSize = tile.xSize;
+	int ySize = tile.ySize - rowsRendered;
+	bool splitColumns = (xSize >= ySize);
+
+	if (splitColumns && (xSize < (2 * m_minTileSize)))
+		splitColumns = false;
+
+	if (!splitColumns && (ySize < (2 * m_minTileSize)))
+	{
+		// Try the other way instead.
+		if (xSize < (2 * m_minTileSize))
+			return false;
+
+		splitColumns = true;
+	}
+
+	// Reserve space for both of the children.
+	int firstChild = m_numTiles.load();
+	do
+	{
+		if (static_cast<size_t>(firstChild + 2) > m_tiles.size())
+			return false;
+	}
+	while (!m_numTiles.compare_exchange_weak(firstChild, firstChild + 2));
+
+	child1 = firstChild;
+	child2 = firstChild + 1;
+
+	/*
+		The children must be counted as pending before this tile finishes,
+		otherwise the frame could be marked as complete too early.
+	*/
+	m_pendingCounts[tileIndex].fetch_add(2);
+
+	if (splitColumns)
+	{
+		int halfSize = xSize / 2;
+		SetupChildTile(child1, tileIndex, x, y, halfSize, ySize);
+		SetupChildTile(child2, tileIndex, x + halfSize, y, xSize - halfSize, ySize);
+	}
+	else
+	{
+		int halfSize = ySize / 2;
+		SetupChildTile(child1, tileIndex, x, y, xSize, halfSize);
+		SetupChildTile(child2, tileIndex, x, y + halfSize, xSize, ySize - halfSize);
+	}
+
+	// The tile now only covers the rows that it has already rendered.
+	tile.ySize = rowsRendered;
+	tile.numChildren = 2;
+
+	return true;
+}
+
+// Function to mark a tile as finished and update its parents.
+void qbRT::Threads::TileScheduler::FinishTile(int tileIndex)
+{
+	// Work our way up the tree for as long as each sub-tree is complete.
+	int remaining = m_pendingCounts[tileIndex].fetch_sub(1) - 1;
+	while (remaining == 0)
+	{
+		int parentIndex = m_tiles.at(tileIndex).parentIndex;
+		if (parentIndex < 0)
+		{
+			/*
+				This grid tile is complete. Record the time first, so that
+				the frame time is already up to date by the time that the
+				last grid tile is seen to be complete.
+			*/
+			std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - m_frameStartTime;
+			long long finishTime = static_cast<long long>(elapsedTime.count() * 1e9);
+			long long frameTime = m_frameTime.load();
+			while ((finishTime > frameTime) && !m_frameTime.compare_exchange_weak(frameTime, finishTime));
+
+			m_numGridTilesPending.fetch_sub(1);
+			break;
+		}
+
+		tileIndex = parentIndex;
+		remaining = m_pendingCounts[tileIndex].fetch_sub(1) - 1;
+	}
+}
+
+// Function to compute the order in which to dispatch the grid tiles.
+void qbRT::Threads::TileScheduler::ComputeDispatchOrder()
+{
+	m_dispatchOrder.resize(m_numGridTiles);
+	for (int i=0; i<m_numGridTiles; ++i)
+		m_dispatchOrder.at(i) = i;
+
+	switch (m_tileOrder)
+	{
+		case qbRT::Threads::TILE_ORDER_SPIRAL:
+			ComputeSpiralOrder();
+			break;
+
+		case qbRT::Threads::TILE_ORDER_HILBERT:
+			ComputeCurveOrder(true);
+			break;
+
+		case qbRT::Threads::TILE_ORDER_MORTON:
+			ComputeCurveOrder(false);
+			break;
+
+		case qbRT::Threads::TILE_ORDER_CURSOR:
+			ComputeCursorOrder();
+			break;
+
+		default:
+			// The grid tiles are generated in row-major order already.
+			break;
+	}
+}
+
+// Function to compute a center-out spiral order.
+void qbRT::Threads::TileScheduler::ComputeSpiralOrder()
+{
+	/*
+		Walk a square spiral outwards from the center tile (right 1, down 1,
+		left 2, up 2, right 3...), keeping only those steps that land inside
+		the grid, until we have visited every tile.
+	*/
+	m_dispatchOrder.clear();
+	int x = (m_numTilesX - 1) / 2;
+	int y = (m_numTilesY - 1) / 2;
+	int dx = 1;
+	int dy = 0;
+	int legLength = 1;
+	m_dispatchOrder.push_back((y * m_numTilesX) + x);
+
+	while (m_dispatchOrder.size() < static_cast<size_t>(m_numGridTiles))
+	{
+		// Each leg length is used twice before it increases.
+		for (int leg=0; leg<2; ++leg)
+		{
+			for (int step=0; step<legLength; ++step)
+			{
+				x += dx;
+				y += dy;
+				if ((x >= 0) && (x < m_numTilesX) && (y >= 0) && (y < m_numTilesY))
+					m_dispatchOrder.push_back((y * m_numTilesX) + x);
+			}
+
+			// Turn clockwise.
+			int temp = dx;
+			dx = -dy;
+			dy = temp;
+		}
+		legLength++;
+	}
+}
+
+// Function to compute an order that follows a Hilbert or Morton curve.
+void qbRT::Threads::TileScheduler::ComputeCurveOrder(bool hilbert)
+{
+	// The curves are defined over a square grid with sides that are a power of two.
+	int gridSize = 1;
+	while ((gridSize < m_numTilesX) || (gridSize < m_numTilesY))
+		gridSize *= 2;
+
+	// Compute the distance along the curve for each tile.
+	std::vector<long long> curveDistance (m_numGridTiles);
+	for (int i=0; i<m_numGridTiles; ++i)
+	{
+		long long x = i % m_numTilesX;
+		long long y = i / m_numTilesX;
+		long long distance = 0;
+
+		if (hilbert)
+		{
+			for (long long s=gridSize/2; s>0; s/=2)
+			{
+				long long rx = (x & s) > 0 ? 1 : 0;
+				long long ry = (y & s) > 0 ? 1 : 0;
+				distance += s * s * ((3 * rx) ^ ry);
+
+				// Rotate the quadrant so that the curve joins up.
+				if (ry == 0)
+				{
+					if (rx == 1)
+					{
+						x = gridSize - 1 - x;
+						y = gridSize - 1 - y;
+					}
+					std::swap(x, y);
+				}
+			}
+		}
+		else
+		{
+			// Interleave the bits of x and y.
+			for (int bit=0; (1 << bit) < gridSize; ++bit)
+			{
+				distance |= ((x >> bit) & 1LL) << (2 * bit);
+				distance |= ((y >> bit) & 1LL) << ((2 * bit) + 1);
+			}
+		}
+
+		curveDistance.at(i) = distance;
+	}
+
+	std::sort(m_dispatchOrder.begin(), m_dispatchOrder.end(), [&curveDistance](int tile1, int tile2)
+	{
+		return curveDistance.at(tile1) < curveDistance.at(tile2);
+	});
+}
+
+// Function to compute an order with the tiles nearest to the focus point first.
+void qbRT::Threads::TileScheduler::ComputeCursorOrder()
+{
+	std::stable_sort(m_dispatchOrder.begin(), m_dispatchOrder.end(), [this](int tile1, int tile2)
+	{
+		return GetFocusDistance(tile1) < GetFocusDistance(tile2);
+	});
+}
+
+// Function to return the squared distance from the center of a tile to the focus point.
+double qbRT::Threads::TileScheduler::GetFocusDistance(int tileIndex)
+{
+	const qbRT::DATA::tile &tile = m_tiles.at(tileIndex);
+	double dx = (static_cast<double>(tile.x) + (static_cast<double>(tile.xSize) / 2.0)) - static_cast<double>(m_focusX);
+	double dy = (static_cast<double>(tile.y) + (static_cast<double>(tile.ySize) / 2.0)) - static_cast<double>(m_focusY);
+	return (dx * dx) + (dy * dy);
+}
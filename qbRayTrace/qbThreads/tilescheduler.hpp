@@ -0,0 +1,258 @@
+/* ***********************************************************
+	tilescheduler.hpp
+
+	The TileScheduler class definition - A class to manage the
+	grid of tiles that make up a frame and to hand them out to
+	a pool of render threads.
+
+	Tiles that run past a configurable time budget are split, so
+	that the rows that remain can be picked up by idle workers.
+	The cost of each grid tile is recorded so that, on the next
+	frame, tiles that are expected to be expensive can be split
+	before they are dispatched.
+
+	The order in which the grid tiles are dispatched can be chosen
+	(see SetTileOrder()), so that the part of the image that we are
+	most interested in is rendered first.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include "../qbutils.hpp"
+#include "../scene.hpp"
+#include "../framebuffer.hpp"
+#include "renderpool.hpp"
+
+namespace qbRT
+{
+	namespace Threads
+	{
+		// Constants to define the state of a tile.
+		constexpr int TILE_WAITING = 0;
+		constexpr int TILE_RENDERING = 1;
+		constexpr int TILE_COMPLETE = 2;
+
+		// Constants to define the order in which tiles are dispatched.
+		constexpr int TILE_ORDER_ROWMAJOR = 0;
+		constexpr int TILE_ORDER_SPIRAL = 1;
+		constexpr int TILE_ORDER_HILBERT = 2;
+		constexpr int TILE_ORDER_MORTON = 3;
+		constexpr int TILE_ORDER_CURSOR = 4;
+
+		class TileScheduler
+		{
+			public:
+				// Default constructor.
+				TileScheduler();
+
+				// The destructor.
+				~TileScheduler();
+
+				// Function to generate the grid of tiles covering an image of the given size.
+				bool GenerateTileGrid(int xSize, int ySize, int tileSizeX, int tileSizeY);
+
+				/*
+					Function to set a function to be called, on the render thread, each time
+					a tile finishes rendering. This is intended to wake up the display thread
+					(for example by pushing an SDL_UserEvent), which can then collect the
+					tiles with GetCompletedTiles(). It must be set before Start() is called.
+				*/
+				void SetTileCallback(std::function<void(int)> tileCallback);
+
+				// Function to start the render threads (see RenderPool::Start()).
+				bool Start(qbRT::Scene *pScene, int numThreads);
+
+				// Function to stop the render threads.
+				void Stop();
+
+				// Function to start rendering a new frame.
+				bool StartFrame();
+
+				/*
+					Function to set the order in which the grid tiles are dispatched.
+					TILE_ORDER_ROWMAJOR - Left to right, top to bottom.
+					TILE_ORDER_SPIRAL - Spiral outwards from the center of the image.
+					TILE_ORDER_HILBERT - Follow a Hilbert curve, so that consecutive tiles are always neighbours.
+					TILE_ORDER_MORTON - Follow a Morton (Z-order) curve.
+					TILE_ORDER_CURSOR - Nearest to the focus point first (see SetFocusPoint()).
+					The new order takes effect from the next frame.
+				*/
+				bool SetTileOrder(int tileOrder);
+
+				// Function to return the current tile order.
+				int GetTileOrder();
+
+				/*
+					Function to set the focus point (in pixels) used by TILE_ORDER_CURSOR,
+					for example the position of the mouse cursor. If a frame is being
+					rendered, then the tiles that are still waiting in the shared queue
+					are re-ordered so that those nearest to the new point are rendered next.
+				*/
+				void SetFocusPoint(int x, int y);
+
+				// Function to return the number of tiles (including any split tiles).
+				int GetNumTiles();
+
+				// Function to return the number of tiles in the original grid.
+				int GetNumGridTiles();
+
+				// Function to return a reference to a tile.
+				qbRT::DATA::tile& GetTile(int tileIndex);
+
+				// Function to return the frame buffer that the tiles are rendered into.
+				qbRT::FrameBuffer& GetFrameBuffer();
+
+				// Function to return the state of a tile (TILE_WAITING, TILE_RENDERING or TILE_COMPLETE).
+				// Note that this refers only to the area that the tile renders itself, not to its children.
+				int GetTileState(int tileIndex);
+
+				// Function to collect the tiles that have finished rendering since the last call.
+				// Returns false if there are none.
+				bool GetCompletedTiles(std::vector<int> &tileList);
+
+				// Function to test whether a tile and all of its children have been rendered.
+				bool IsTileComplete(int tileIndex);
+
+				// Function to test whether the whole frame has been rendered.
+				bool IsFrameComplete();
+
+				// Function to return the number of secondary rays spawned (and culled) over the last frame.
+				qbRT::DATA::rayStats GetRayStats();
+
+				// Function to print the statistics for the last frame.
+				void PrintStats();
+
+			private:
+				// Function to render a tile (called on one of the render threads).
+				void RenderTile(int tileIndex);
+
+				// Function to setup a new tile covering the given area of its parent.
+				void SetupChildTile(int tileIndex, int parentIndex, int x, int y, int xSize, int ySize);
+
+				// Function to split the rows of a tile that have not yet been rendered
+				// into two new tiles. Returns false if the tile could not be split.
+				bool SplitRemainder(int tileIndex, int rowsRendered, int &child1, int &child2);
+
+				// Function to mark a tile as finished and update its parents.
+				void FinishTile(int tileIndex);
+
+				// Function to compute the order in which to dispatch the grid tiles.
+				void ComputeDispatchOrder();
+
+				// Functions to compute the orderings.
+				void ComputeSpiralOrder();
+				void ComputeCurveOrder(bool hilbert);
+				void ComputeCursorOrder();
+
+				// Function to return the squared distance from the center of a tile to the focus point.
+				double GetFocusDistance(int tileIndex);
+
+			public:
+				/*
+					The time budget for a single tile, in seconds. A tile that
+					runs past this budget is split and the remaining rows are
+					handed out to other workers. Setting this to zero disables
+					splitting.
+				*/
+				double m_tileBudget = 0.05;
+
+				// The maximum number of times a tile can be split.
+				int m_maxSplitDepth = 3;
+
+				// The smallest width or height that a split can produce.
+				int m_minTileSize = 8;
+
+			private:
+				// The render threads and the scene that they render.
+				qbRT::Threads::RenderPool m_renderPool;
+				qbRT::Scene *m_pScene = nullptr;
+
+				/*
+					The tiles. Space for the maximum number of split tiles is allocated
+					up-front so that the list never has to be resized while the render
+					threads are using it. The first m_numGridTiles tiles are the grid.
+				*/
+				std::vector<qbRT::DATA::tile> m_tiles;
+				std::atomic<int> m_numTiles {0};
+				int m_numGridTiles = 0;
+				int m_numTilesX = 0;
+				int m_numTilesY = 0;
+
+				// The frame buffer, which covers the whole image.
+				qbRT::FrameBuffer m_frameBuffer;
+
+				// A copy of the grid tiles as they were generated, before any splits.
+				std::vector<qbRT::DATA::tile> m_gridTiles;
+
+				// The order in which the grid tiles are dispatched.
+				int m_tileOrder = qbRT::Threads::TILE_ORDER_ROWMAJOR;
+				std::vector<int> m_dispatchOrder;
+
+				// The focus point for TILE_ORDER_CURSOR (defaults to the center of the image).
+				int m_focusX = 0;
+				int m_focusY = 0;
+
+				// The tiles that have finished rendering but have not yet been collected.
+				std::vector<int> m_completedTiles;
+				std::mutex m_completedMutex;
+				std::function<void(int)> m_tileCallback;
+
+				// The state of each tile.
+				std::unique_ptr<std::atomic<int>[]> m_tileStates;
+
+				// For each tile, the number of tiles in its sub-tree (including
+				// itself) that have not yet finished rendering.
+				std::unique_ptr<std::atomic<int>[]> m_pendingCounts;
+
+				// The time spent rendering each grid tile (including its children)
+				// in the current frame and in the previous frame, in nanoseconds.
+				std::unique_ptr<std::atomic<long long>[]> m_gridTileCosts;
+				std::vector<long long> m_lastGridTileCosts;
+
+				// The number of grid tiles that are not yet complete.
+				std::atomic<int> m_numGridTilesPending {0};
+
+				// Statistics for the current frame.
+				std::atomic<int> m_numSplits {0};
+				int m_numPreSplits = 0;
+				std::chrono::steady_clock::time_point m_frameStartTime;
+
+				// The time, since the start of the frame, at which the last grid tile finished (in nanoseconds).
+				std::atomic<long long> m_frameTime {0};
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,117 @@
+/* ***********************************************************
+	workdeque.cpp
+
+	The WorkDeque class implementation - A fixed capacity, lock-free
+	work-stealing deque of job indices (Chase-Lev deque).
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "workdeque.hpp"
+#include <algorithm>
+
+// Constructor.
+qbRT::Threads::WorkDeque::WorkDeque(int capacity)
+{
+	// Round the capacity up to a power of two so that we can use a mask
+	// rather than a modulus to wrap around the circular buffer.
+	long size = 1;
+	while (size < capacity)
+		size *= 2;
+
+	m_buffer = std::vector<std::atomic<int>> (size);
+	m_mask = size - 1;
+}
+
+// Function to push a job onto the bottom of the deque.
+bool qbRT::Threads::WorkDeque::Push(int jobIndex)
+{
+	long bottom = m_bottom.load(std::memory_order_relaxed);
+	long top = m_top.load(std::memory_order_acquire);
+
+	// Is the deque full?
+	if ((bottom - top) > m_mask)
+		return false;
+
+	m_buffer[bottom & m_mask].store(jobIndex, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+// Function to pop a job from the bottom of the deque.
+bool qbRT::Threads::WorkDeque::Pop(int &jobIndex)
+{
+	long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// The deque was empty, so put the bottom back where it was.
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	jobIndex = m_buffer[bottom & m_mask].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// This is the last job in the deque, so we have to race any
+		// thieves for it.
+		bool wonRace = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return wonRace;
+	}
+
+	return true;
+}
+
+// Function to steal a job from the top of the deque.
+bool qbRT::Threads::WorkDeque::Steal(int &jobIndex)
+{
+	long top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return false;
+
+	int candidate = m_buffer[top & m_mask].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false;
+
+	jobIndex = candidate;
+	return true;
+}
+
+// Function to return the (approximate) number of jobs in the deque.
+int qbRT::Threads::WorkDeque::GetSize()
+{
+	long bottom = m_bottom.load(std::memory_order_relaxed);
+	long top = m_top.load(std::memory_order_relaxed);
+	return static_cast<int>(std::max(bottom - top, 0L));
+}
@@ -0,0 +1,84 @@
+/* ***********************************************************
+	workdeque.hpp
+
+	The WorkDeque class definition - A fixed capacity, lock-free
+	work-stealing deque of job indices (Chase-Lev deque). The
+	owning thread pushes and pops jobs at the bottom of the deque
+	without taking any locks, while other threads may steal jobs
+	from the top of the deque when they run out of work.
+
+	The memory ordering follows Le, Pop, Cohen and Zappa Nardelli,
+	"Correct and Efficient Work-Stealing for Weak Memory Models".
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef WORKDEQUE_H
+#define WORKDEQUE_H
+
+#include <atomic>
+#include <vector>
+
+namespace qbRT
+{
+	namespace Threads
+	{
+		class WorkDeque
+		{
+			public:
+				// Constructor (the capacity is rounded up to a power of two).
+				WorkDeque(int capacity);
+
+				// Function to push a job onto the bottom of the deque.
+				// Must only be called by the owning thread.
+				// Returns false if the deque is full.
+				bool Push(int jobIndex);
+
+				// Function to pop a job from the bottom of the deque.
+				// Must only be called by the owning thread.
+				bool Pop(int &jobIndex);
+
+				// Function to steal a job from the top of the deque.
+				// May be called by any thread. Returns false if the deque
+				// was empty or if another thread won the race for the job.
+				bool Steal(int &jobIndex);
+
+				// Function to return the (approximate) number of jobs in the deque.
+				int GetSize();
+
+			private:
+				std::vector<std::atomic<int>> m_buffer;
+				long m_mask;
+
+				// The top is where jobs are stolen from, the bottom is where
+				// the owner pushes and pops.
+				std::atomic<long> m_top {0};
+				std::atomic<long> m_bottom {0};
+		};
+	}
+}
+
+#endif
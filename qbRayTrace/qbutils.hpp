@@ -33,7 +33,6 @@
 #define QBRT_UTILS_H
 
 #include <memory>
-#include <SDL2/SDL.h>
 #include "./qbLinAlg/qbVector.h"
 #include "./qbLinAlg/qbVector2.hpp"
 #include "./qbLinAlg/qbVector3.hpp"
@@ -45,9 +44,26 @@ namespace qbRT
 {
 	// Forward-declare the object base class.
 	class ObjectBase;
+	
+	// Forward-declare the acceleration structure.
+	namespace ACCEL
+	{
+		class BVH;
+	}
+
+	// Forward-declare the containers for secondary rays and the cache for shadow rays.
+	class RayQueue;
+	class RayStack;
+	class ShadowCache;
 
 	namespace DATA
 	{
+		/*
+			Structure to hold the details of an intersection. TestIntersection()
+			only fills in t, localPOI and partIndex, which is all that is needed
+			to find the closest intersection. The rest is filled in by
+			FinalizeHit(), once we know which intersection we actually need.
+		*/
 		struct hitData
 		{
 			qbVector3<double> poi;
@@ -55,7 +71,82 @@ namespace qbRT
 			qbVector3<double> color;
 			qbVector3<double> localPOI;
 			qbVector2<double> uvCoords;
-			std::shared_ptr<qbRT::ObjectBase> hitObject;
+			
+			/*
+				The object that was hit. This is a non-owning pointer, the objects
+				are owned by the scene (Scene::m_objectList) and live for the whole
+				of a render, so there is no need to touch a reference count on
+				every intersection.
+			*/
+			qbRT::ObjectBase *hitObject = nullptr;
+			
+			// The distance to the intersection, in units of the ray direction (m_lab).
+			double t = 0.0;
+			
+			// Which part of the object was hit (eg. the face of a box).
+			int partIndex = 0;
+		};
+		
+		// Structure for an axis-aligned bounding box.
+		struct aabb
+		{
+			double min[3] = {1e30, 1e30, 1e30};
+			double max[3] = {-1e30, -1e30, -1e30};
+		};
+		
+		// Constants to define the type of a ray.
+		constexpr int RAY_CAMERA = 0;
+		constexpr int RAY_REFLECTION = 1;
+		constexpr int RAY_REFRACTION = 2;
+		
+		/*
+			Structure to carry the state of a single ray through the material
+			functions. Each secondary ray gets its own context, so nothing
+			about the ray being shaded is stored in the (shared) materials.
+		*/
+		struct shadingContext
+		{
+			// The number of bounces between the camera and this ray, in total and of each type.
+			int depth = 0;
+			int reflectionDepth = 0;
+			int refractionDepth = 0;
+			
+			// The fraction of this ray's color that reaches the camera.
+			double weight = 1.0;
+			
+			// The type of this ray (RAY_CAMERA, RAY_REFLECTION or RAY_REFRACTION).
+			int rayType = RAY_CAMERA;
+			
+			// Scratch space for the material normal at the current point.
+			qbVector3<double> localNormal;
+			
+			// The acceleration structure for the scene (if NULL, every object is tested).
+			const qbRT::ACCEL::BVH *bvh = nullptr;
+			
+			/* If not NULL, secondary rays are added to this queue to be traced later, rather
+				than being traced straight away (see qbRT::RayQueue). Their colors are added to
+				the pixel at pixelIndex, scaled by their weight. */
+			qbRT::RayQueue *rayQueue = nullptr;
+			int pixelIndex = 0;
+			
+			/* The index of the pixel in the whole image ((y * xSize) + x). Unlike pixelIndex, this
+				doesn't depend on how the image was split up, so it can be used to seed anything that
+				should give the same result however the pixel was rendered (see MaterialBase::CullRay()). */
+			int imageIndex = 0;
+			
+			/* If not NULL (and there is no rayQueue), secondary rays are pushed onto this stack
+				to be traced once the current ray has been shaded (see qbRT::RayStack). */
+			qbRT::RayStack *rayStack = nullptr;
+			
+			// If not NULL, shadow rays are looked up in this cache before being traced (see qbRT::ShadowCache).
+			qbRT::ShadowCache *shadowCache = nullptr;
+		};
+		
+		// Structure for counting the reflected and refracted rays that were spawned, and how many of those were culled.
+		struct rayStats
+		{
+			long long secondaryRays = 0;
+			long long culledRays = 0;
 		};
 		
 		// Structure for handling rendering tiles.
@@ -66,9 +157,21 @@ namespace qbRT
 			int xSize;
 			int ySize;
 			int renderComplete = 0;
-			bool textureComplete = false;
-			SDL_Texture *pTexture;
-			std::vector<qbVector3<double>> rgbData;
+			
+			/*
+				Parent / child bookkeeping for tiles that have been split by
+				the tile scheduler. A tile that has been split keeps the rows
+				that it had already rendered (ySize is reduced accordingly) and
+				the rest of its area is handed to its children. Grid tiles have
+				no parent and are their own root.
+			*/
+			int parentIndex = -1;
+			int rootIndex = -1;
+			int splitDepth = 0;
+			int numChildren = 0;
+			
+			// The secondary rays for this tile (not including any children).
+			qbRT::DATA::rayStats rayStats;
 		};			
 	}
 
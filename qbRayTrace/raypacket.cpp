@@ -0,0 +1,78 @@
+/* ***********************************************************
+	raypacket.cpp
+
+	The RayPacket class implementation.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "raypacket.hpp"
+
+// Default constructor (the rays are left unset, as they are always set before use).
+qbRT::RayPacket::RayPacket()
+{
+
+}
+
+// Function to set one of the rays.
+void qbRT::RayPacket::SetRay(int index, const qbRT::Ray &ray)
+{
+	m_point1X[index] = ray.m_point1.GetElement(0);
+	m_point1Y[index] = ray.m_point1.GetElement(1);
+	m_point1Z[index] = ray.m_point1.GetElement(2);
+	m_point2X[index] = ray.m_point2.GetElement(0);
+	m_point2Y[index] = ray.m_point2.GetElement(1);
+	m_point2Z[index] = ray.m_point2.GetElement(2);
+	m_labX[index] = ray.m_lab.GetElement(0);
+	m_labY[index] = ray.m_lab.GetElement(1);
+	m_labZ[index] = ray.m_lab.GetElement(2);
+}
+
+// Function to return one of the rays.
+qbRT::Ray qbRT::RayPacket::GetRay(int index) const
+{
+	// Copy the components directly, so that the ray is exactly the one that was set.
+	qbRT::Ray ray;
+	ray.m_point1 = qbVector3<double>{m_point1X[index], m_point1Y[index], m_point1Z[index]};
+	ray.m_point2 = qbVector3<double>{m_point2X[index], m_point2Y[index], m_point2Z[index]};
+	ray.m_lab = qbVector3<double>{m_labX[index], m_labY[index], m_labZ[index]};
+	return ray;
+}
+
+// Function to check whether the rays are coherent.
+bool qbRT::RayPacket::IsCoherent() const
+{
+	for (int i=1; i<RAY_PACKET_SIZE; ++i)
+	{
+		if ((m_point1X[i] != m_point1X[0]) || (m_point1Y[i] != m_point1Y[0]) || (m_point1Z[i] != m_point1Z[0]))
+			return false;
+
+		if (((m_labX[i] < 0.0) != (m_labX[0] < 0.0)) || ((m_labY[i] < 0.0) != (m_labY[0] < 0.0)) || ((m_labZ[i] < 0.0) != (m_labZ[0] < 0.0)))
+			return false;
+	}
+
+	return true;
+}
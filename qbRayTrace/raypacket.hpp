@@ -0,0 +1,72 @@
+/* ***********************************************************
+	raypacket.hpp
+
+	The RayPacket class definition - A class to hold a small group
+	of rays (for example the camera rays for neighbouring pixels),
+	so that they can be traced together.
+
+	The rays are stored with one array per component, so that the
+	same calculation can be carried out for every ray in a simple
+	loop that the compiler is able to vectorize. A packet is only
+	worthwhile if the rays are coherent (start from the same point
+	and head in roughly the same direction), as otherwise they soon
+	end up visiting different parts of the scene.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include "ray.hpp"
+
+namespace qbRT
+{
+	// The number of rays in a packet.
+	constexpr int RAY_PACKET_SIZE = 4;
+
+	class RayPacket
+	{
+		public:
+			// Default constructor.
+			RayPacket();
+
+			// Functions to set and return individual rays.
+			void SetRay(int index, const qbRT::Ray &ray);
+			qbRT::Ray GetRay(int index) const;
+
+			/* Function to check whether the rays are coherent enough to be traced as a
+				packet (they start from the same point and head into the same octant). */
+			bool IsCoherent() const;
+
+		public:
+			double m_point1X[RAY_PACKET_SIZE], m_point1Y[RAY_PACKET_SIZE], m_point1Z[RAY_PACKET_SIZE];
+			double m_point2X[RAY_PACKET_SIZE], m_point2Y[RAY_PACKET_SIZE], m_point2Z[RAY_PACKET_SIZE];
+			double m_labX[RAY_PACKET_SIZE], m_labY[RAY_PACKET_SIZE], m_labZ[RAY_PACKET_SIZE];
+	};
+}
+
+#endif
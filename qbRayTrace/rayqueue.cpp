@@ -0,0 +1,112 @@
+/* ***********************************************************
+	rayqueue.cpp
+
+	The RayQueue class implementation.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "rayqueue.hpp"
+#include <algorithm>
+
+// Default constructor.
+qbRT::RayQueue::RayQueue()
+{
+
+}
+
+// Function to set the region of the scene that is divided into cells.
+void qbRT::RayQueue::SetBounds(const qbRT::DATA::aabb &bounds)
+{
+	for (int i=0; i<3; ++i)
+	{
+		/* If the region is empty along this axis (or there is no region at all),
+			then every ray falls into the same cell. */
+		double extent = bounds.max[i] - bounds.min[i];
+		m_origin[i] = (extent > 0.0) ? bounds.min[i] : 0.0;
+		m_cellScale[i] = (extent > 0.0) ? static_cast<double>(RAY_QUEUE_CELLS) / extent : 0.0;
+	}
+}
+
+// Function to add a ray to the queue.
+void qbRT::RayQueue::Push(const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context)
+{
+	qbRT::DATA::queuedRay queuedRay;
+	queuedRay.ray = ray;
+	queuedRay.skipObject = skipObject;
+	queuedRay.context = context;
+	m_rays.push_back(queuedRay);
+	m_binIndices.push_back(ComputeBin(ray));
+}
+
+// Function to take the queued rays, sorted by bin.
+void qbRT::RayQueue::TakeBinnedRays(std::vector<qbRT::DATA::queuedRay> &outputRays)
+{
+	// Count the rays in each bin, and work out where each bin starts.
+	std::vector<int> binStarts (RAY_QUEUE_BINS + 1, 0);
+	for (int binIndex : m_binIndices)
+		++binStarts[binIndex + 1];
+
+	for (int i=0; i<RAY_QUEUE_BINS; ++i)
+		binStarts[i + 1] += binStarts[i];
+
+	// Then copy each ray into the next free slot of its bin.
+	outputRays.resize(m_rays.size());
+	for (size_t i=0; i<m_rays.size(); ++i)
+		outputRays[binStarts[m_binIndices[i]]++] = m_rays[i];
+
+	m_rays.clear();
+	m_binIndices.clear();
+}
+
+// Function to check whether the queue is empty.
+bool qbRT::RayQueue::IsEmpty() const
+{
+	return m_rays.empty();
+}
+
+// Function to return the number of rays in the queue.
+int qbRT::RayQueue::GetSize() const
+{
+	return static_cast<int>(m_rays.size());
+}
+
+// Function to compute which bin a ray belongs in.
+int qbRT::RayQueue::ComputeBin(const qbRT::Ray &ray) const
+{
+	int binIndex = 0;
+	for (int i=0; i<3; ++i)
+	{
+		// The cell that the ray starts in (rays that start outside the region go into the nearest cell).
+		double position = (ray.m_point1.GetElement(i) - m_origin[i]) * m_cellScale[i];
+		int cell = static_cast<int>(std::min(std::max(position, 0.0), static_cast<double>(RAY_QUEUE_CELLS - 1)));
+		binIndex = (binIndex * RAY_QUEUE_CELLS) + cell;
+	}
+
+	// Within each cell, the rays are split up by the octant that they head into.
+	int octant = ((ray.m_lab.GetElement(0) < 0.0) ? 1 : 0) + ((ray.m_lab.GetElement(1) < 0.0) ? 2 : 0) + ((ray.m_lab.GetElement(2) < 0.0) ? 4 : 0);
+	return (binIndex * 8) + octant;
+}
@@ -0,0 +1,111 @@
+/* ***********************************************************
+	rayqueue.hpp
+
+	The RayQueue class definition - A class to hold secondary rays
+	(reflections and refractions) that are waiting to be traced.
+
+	Tracing each secondary ray as soon as it is generated means that
+	consecutive rays head off to completely different parts of the
+	scene. Instead, the rays generated over a whole tile can be added
+	to a queue and then sorted into bins, by the cell of the scene
+	that they start in and the octant that they head into, so that
+	rays which are traced one after another visit much the same
+	parts of the acceleration structure.
+
+	Each ray carries the pixel that it contributes to and the weight
+	of its contribution, so that its color can be added to the pixel
+	once it has been traced.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef RAYQUEUE_H
+#define RAYQUEUE_H
+
+#include <vector>
+#include "ray.hpp"
+#include "qbutils.hpp"
+
+namespace qbRT
+{
+	// The number of cells along each axis of the scene, for binning the rays by where they start.
+	constexpr int RAY_QUEUE_CELLS = 4;
+
+	// The total number of bins (one per cell, for each of the eight direction octants).
+	constexpr int RAY_QUEUE_BINS = 8 * RAY_QUEUE_CELLS * RAY_QUEUE_CELLS * RAY_QUEUE_CELLS;
+
+	namespace DATA
+	{
+		// Structure for a secondary ray that is waiting to be traced.
+		struct queuedRay
+		{
+			qbRT::Ray ray;
+
+			// An object that the ray should ignore (eg. the one that it has just been refracted out of).
+			qbRT::ObjectBase *skipObject = nullptr;
+
+			/* The shading context for the ray, which includes the pixel that it contributes to
+				(pixelIndex) and the fraction of its color that reaches it (weight). */
+			qbRT::DATA::shadingContext context;
+		};
+	}
+
+	class RayQueue
+	{
+		public:
+			// Default constructor.
+			RayQueue();
+
+			// Function to set the region of the scene that is divided into cells.
+			void SetBounds(const qbRT::DATA::aabb &bounds);
+
+			// Function to add a ray to the queue.
+			void Push(const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context);
+
+			/* Function to move the queued rays into outputRays, sorted by bin, leaving the queue
+				empty (and ready for any rays generated by tracing them). Within each bin, the rays
+				are kept in the order that they were added. */
+			void TakeBinnedRays(std::vector<qbRT::DATA::queuedRay> &outputRays);
+
+			// Functions to return the state of the queue.
+			bool IsEmpty() const;
+			int GetSize() const;
+
+		private:
+			// Function to compute which bin a ray belongs in.
+			int ComputeBin(const qbRT::Ray &ray) const;
+
+		private:
+			std::vector<qbRT::DATA::queuedRay> m_rays;
+			std::vector<int> m_binIndices;
+
+			// The corner of the region and the number of cells per unit length along each axis.
+			double m_origin[3] = {0.0, 0.0, 0.0};
+			double m_cellScale[3] = {0.0, 0.0, 0.0};
+	};
+}
+
+#endif
@@ -0,0 +1,82 @@
+/* ***********************************************************
+	raystack.cpp
+	
+	The RayStack class implementation.
+	
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+	
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+	
+	GPLv3 LICENSE
+	
+	
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "raystack.hpp"
+
+// Default constructor.
+qbRT::RayStack::RayStack()
+{
+
+}
+
+// Function to empty the stack.
+void qbRT::RayStack::Clear()
+{
+	m_size = 0;
+}
+
+// Function to push a ray onto the stack.
+bool qbRT::RayStack::Push(const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context)
+{
+	if (m_size >= qbRT::RAY_STACK_CAPACITY)
+		return false;
+	
+	qbRT::DATA::queuedRay &stackedRay = m_rays[m_size];
+	stackedRay.ray = ray;
+	stackedRay.skipObject = skipObject;
+	stackedRay.context = context;
+	++m_size;
+	
+	return true;
+}
+
+// Function to pop the most recently pushed ray off the stack.
+bool qbRT::RayStack::Pop(qbRT::DATA::queuedRay &outputRay)
+{
+	if (m_size == 0)
+		return false;
+	
+	--m_size;
+	outputRay = m_rays[m_size];
+	
+	return true;
+}
+
+// Functions to return the state of the stack.
+bool qbRT::RayStack::IsEmpty() const
+{
+	return m_size == 0;
+}
+
+int qbRT::RayStack::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,85 @@
+/* ***********************************************************
+	raystack.hpp
+	
+	The RayStack class definition - A fixed-size stack of secondary
+	rays (reflections and refractions) that are waiting to be traced.
+	
+	Rather than each material tracing its reflected and refracted
+	rays itself (and so calling back into the material of whatever
+	they hit, and so on), the rays are pushed onto this stack along
+	with their shading context. The renderer then pops them off and
+	traces them one at a time in a simple loop, until the stack is
+	empty. The context carries the depth of the ray (in total, and
+	of each type) and the fraction of its color that reaches the
+	pixel, so nothing else needs to be remembered along the way.
+	
+	The rays are stored in a fixed-size array, so nothing is ever
+	allocated. If the stack is full, Push() returns false and the
+	material falls back to tracing the ray itself.
+	
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+	
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+	
+	GPLv3 LICENSE
+	
+	
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef RAYSTACK_H
+#define RAYSTACK_H
+
+#include <array>
+#include "qbutils.hpp"
+#include "rayqueue.hpp"
+
+namespace qbRT
+{
+	/* The maximum number of rays on the stack. Each ray that is popped can push at most
+		two more (a reflection and a refraction), so the stack never holds more than one ray
+		per bounce plus one, which is well within this for the default depth limits. */
+	constexpr int RAY_STACK_CAPACITY = 64;
+
+	class RayStack
+	{
+		public:
+			// Default constructor.
+			RayStack();
+			
+			// Function to empty the stack.
+			void Clear();
+			
+			// Function to push a ray onto the stack (returns false if the stack is full).
+			bool Push(const qbRT::Ray &ray, qbRT::ObjectBase *skipObject, const qbRT::DATA::shadingContext &context);
+			
+			// Function to pop the most recently pushed ray off the stack (returns false if it is empty).
+			bool Pop(qbRT::DATA::queuedRay &outputRay);
+			
+			// Functions to return the state of the stack.
+			bool IsEmpty() const;
+			int GetSize() const;
+			
+		private:
+			std::array<qbRT::DATA::queuedRay, qbRT::RAY_STACK_CAPACITY> m_rays;
+			int m_size = 0;
+	};
+}
+
+#endif
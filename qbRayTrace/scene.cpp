@@ -66,8 +66,11 @@ qbRT::Scene::~Scene()
 }
 
 // Function to perform the rendering.
-bool qbRT::Scene::Render(qbImage &outputImage)
+bool qbRT::Scene::Render(qbRT::FrameBuffer &outputImage)
 {
+	// Build the acceleration structure.
+	BuildBVH();
+
 	// Record the start time.
 	auto startTime = std::chrono::steady_clock::now();
 
@@ -75,17 +78,45 @@ bool qbRT::Scene::Render(qbImage &outputImage)
 	int xSize = outputImage.GetXSize();
 	int ySize = outputImage.GetYSize();
 	
-	// Loop over each pixel in our image.
-	for (int y=0; y<ySize; ++y)
+	// The wavefront renderer renders the whole image in one go.
+	if (m_useWavefront)
 	{
-		// Display progress.
-		std::cout << "Processing line " << y << " of " << ySize << "." << " \r";
-		std::cout.flush();
+		qbRT::DATA::tile imageTile;
+		imageTile.x = 0;
+		imageTile.y = 0;
+		imageTile.xSize = xSize;
+		imageTile.ySize = ySize;
+		
+		qbRT::WavefrontRenderer wavefront;
+		wavefront.RenderTile(*this, imageTile, outputImage, 0);
+	}
+	else
+	{
+		// If the secondary rays are being binned, then we bin them one row at a time.
+		qbRT::RayQueue rayQueue;
+		qbRT::RayQueue *pRayQueue = nullptr;
+		if (m_binSecondaryRays)
+		{
+			if (!m_bvh.GetNodes().empty())
+				rayQueue.SetBounds(m_bvh.GetNodes().front().bounds);
+			
+			pRayQueue = &rayQueue;
+		}
 		
-		for (int x=0; x<xSize; ++x)
+		// Loop over each pixel in our image.
+		std::vector<qbVector3<double>> rowColors (xSize);
+		for (int y=0; y<ySize; ++y)
 		{
-			qbVector3<double> pixelColor = RenderPixel(x, y, xSize, ySize);
-			outputImage.SetPixel(x, y, pixelColor.GetElement(0), pixelColor.GetElement(1), pixelColor.GetElement(2));
+			// Display progress.
+			std::cout << "Processing line " << y << " of " << ySize << "." << " \r";
+			std::cout.flush();
+			
+			RenderSpan(0, y, xSize, xSize, ySize, rowColors.data(), pRayQueue, 0);
+			if (pRayQueue != nullptr)
+				TraceQueuedRays(rayQueue, rowColors);
+			
+			for (int x=0; x<xSize; ++x)
+				outputImage.SetPixel(x, y, rowColors[x]);
 		}
 	}
 	
@@ -101,73 +132,246 @@ bool qbRT::Scene::Render(qbImage &outputImage)
 	return true;
 }
 
+// Function to build the acceleration structure.
+void qbRT::Scene::BuildBVH()
+{
+	m_bvh.Build(m_objectList);
+	m_bvh.PrintStats();
+}
+
 // Function to cast a ray into the scene.
-bool qbRT::Scene::CastRay(	qbRT::Ray &castRay, std::shared_ptr<qbRT::ObjectBase> &closestObject,
-														qbRT::DATA::hitData &closestHitData)
+bool qbRT::Scene::CastRay(	qbRT::Ray &castRay, qbRT::ObjectBase *&closestObject,
+														qbRT::DATA::hitData &closestHitData, const qbRT::ObjectBase *skipObject)
 {
+	// Use the acceleration structure if we have one.
+	if (m_bvh.IsBuilt())
+		return m_bvh.Intersect(castRay, skipObject, closestObject, closestHitData);
+	
+	/* As before, we ignore anything further away than 1e6, but we work in
+		units of m_lab (the same as TestIntersection()). */
 	qbRT::DATA::hitData hitData;
-	double minDist = 1e6;
+	double minT = 1e6 / castRay.m_lab.norm();
 	bool intersectionFound = false;
-	for (auto currentObject : m_objectList)
+	for (auto &currentObject : m_objectList)
 	{
-		bool validInt = currentObject -> TestIntersection(castRay, hitData);
+		if (currentObject.get() == skipObject)
+			continue;
 		
-		// If we have a valid intersection.
-		if (validInt)
+		// Only look for intersections that are no further away than the closest one found so far.
+		bool validInt = currentObject -> TestIntersection(castRay, hitData, minT);
+		
+		/* If this object is closer to the camera than any one that we have
+			seen before, then store a reference to it. */
+		if (validInt && (hitData.t < minT))
 		{
-			// Set the flag to indicate that we found an intersection.
 			intersectionFound = true;
-					
-			// Compute the distance between the camera and the point of intersection.
-			double dist = (hitData.poi - castRay.m_point1).norm();
-					
-			/* If this object is closer to the camera than any one that we have
-				seen before, then store a reference to it. */
-			if (dist < minDist)
-			{
-				minDist = dist;
-				closestObject = currentObject;
-				//closestIntPoint = intPoint;
-				//closestLocalNormal = localNormal;
-				//closestLocalColor = localColor;
-				closestHitData = hitData;
-			}
+			minT = hitData.t;
+			closestObject = currentObject.get();
+			closestHitData = hitData;
 		}
 	}
 	
+	// Fill in the rest of the hit data, for the closest intersection only.
+	if (intersectionFound)
+		closestObject -> FinalizeHit(castRay, closestHitData);
+	
 	return intersectionFound;
 }
 
 // Function to handle rendering a tile.
-void qbRT::Scene::RenderTile(qbRT::DATA::tile *tile)
+int qbRT::Scene::RenderTile(qbRT::DATA::tile *tile, qbRT::FrameBuffer *frameBuffer, double timeBudget, int firstRow)
 {
+	/* The wavefront renderer works on all of the remaining rows at once, so the time
+		budget doesn't apply. */
+	/* The secondary rays are counted by each thread as it goes, so the ones for this tile
+		are however many more there are by the time that we have finished. */
+	qbRT::DATA::rayStats startStats = qbRT::MaterialBase::m_rayStats;
+	
+	if (m_useWavefront)
+	{
+		qbRT::WavefrontRenderer wavefront;
+		wavefront.RenderTile(*this, *tile, *frameBuffer, firstRow);
+		tile->renderComplete = true;
+		AddRayStats(tile, startStats);
+		return tile->ySize;
+	}
+	
+	// Record the start time, so that we can check against the time budget.
+	auto startTime = std::chrono::steady_clock::now();
+	
+	/* If the secondary rays are being binned, then they are queued up until we have
+		finished with the camera rays, so we need to keep the colors of every row until
+		then. Otherwise, we only need one row at a time. */
+	qbRT::RayQueue rayQueue;
+	qbRT::RayQueue *pRayQueue = nullptr;
+	if (m_binSecondaryRays)
+	{
+		if (!m_bvh.GetNodes().empty())
+			rayQueue.SetBounds(m_bvh.GetNodes().front().bounds);
+		
+		pRayQueue = &rayQueue;
+	}
+	
+	std::vector<qbVector3<double>> pixelColors;
 
-	// Loop over each pixel in the tile.
-	qbVector3<double> pixelColor;
+	// Loop over each row of the tile.
+	int rowsRendered = tile->ySize;
+	for (int y=firstRow; y<tile->ySize; ++y)
+	{
+		int firstPixelIndex = (pRayQueue != nullptr) ? (y - firstRow) * tile->xSize : 0;
+		pixelColors.resize(firstPixelIndex + tile->xSize);
+		RenderSpan(tile->x, tile->y + y, tile->xSize, m_xSize, m_ySize, &pixelColors[firstPixelIndex], pRayQueue, firstPixelIndex);
+		if (pRayQueue == nullptr)
+		{
+			for (int x=0; x<tile->xSize; ++x)
+				frameBuffer -> SetPixel(tile->x + x, tile->y + y, pixelColors[x]);
+		}
+		
+		// If we have run out of time, stop here and let the caller deal with the remaining rows.
+		if ((timeBudget > 0.0) && (y < (tile->ySize - 1)))
+		{
+			std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - startTime;
+			if (elapsedTime.count() > timeBudget)
+			{
+				rowsRendered = y + 1;
+				break;
+			}
+		}
+	}
 	
-	for (int y=0; y<tile->ySize; ++y)
+	// Trace the secondary rays and write out the rows that we have rendered.
+	if (pRayQueue != nullptr)
 	{
-		for (int x=0; x<tile->xSize; ++x)
+		TraceQueuedRays(rayQueue, pixelColors);
+		for (int y=firstRow; y<rowsRendered; ++y)
 		{
-			pixelColor = RenderPixel(tile->x + x, tile->y + y, m_xSize, m_ySize);
-			tile->rgbData.at(Sub2Ind(x, y, tile->xSize, tile->ySize)) = pixelColor;
+			for (int x=0; x<tile->xSize; ++x)
+				frameBuffer -> SetPixel(tile->x + x, tile->y + y, pixelColors[((y - firstRow) * tile->xSize) + x]);
 		}
 	}
 	
-	tile->renderComplete = true;
+	if (rowsRendered == tile->ySize)
+		tile->renderComplete = true;
+	
+	AddRayStats(tile, startStats);
+	return rowsRendered;
+}
+
+// Function to add the secondary rays counted since startStats to a tile.
+void qbRT::Scene::AddRayStats(qbRT::DATA::tile *tile, const qbRT::DATA::rayStats &startStats)
+{
+	const qbRT::DATA::rayStats &threadStats = qbRT::MaterialBase::m_rayStats;
+	tile->rayStats.secondaryRays += threadStats.secondaryRays - startStats.secondaryRays;
+	tile->rayStats.culledRays += threadStats.culledRays - startStats.culledRays;
+}
+
+// Function to render a row of pixels.
+void qbRT::Scene::RenderSpan(	int x, int y, int numPixels, int xSize, int ySize, qbVector3<double> spanColors[],
+															qbRT::RayQueue *rayQueue, int firstPixelIndex)
+{
+	int i = 0;
+	
+	// Render as many of the pixels as we can in packets of neighbouring pixels.
+	if (m_usePackets)
+	{
+		qbRT::RayPacket cameraPacket;
+		qbRT::Ray cameraRay;
+		qbRT::ObjectBase *closestObject[qbRT::RAY_PACKET_SIZE];
+		qbRT::DATA::hitData closestHitData[qbRT::RAY_PACKET_SIZE];
+		bool intersectionFound[qbRT::RAY_PACKET_SIZE];
+		for (; (i + qbRT::RAY_PACKET_SIZE) <= numPixels; i += qbRT::RAY_PACKET_SIZE)
+		{
+			for (int j=0; j<qbRT::RAY_PACKET_SIZE; ++j)
+			{
+				GenerateCameraRay(x + i + j, y, xSize, ySize, cameraRay);
+				cameraPacket.SetRay(j, cameraRay);
+			}
+			
+			CastPacket(cameraPacket, closestObject, closestHitData, intersectionFound);
+			
+			// The shading is still done one pixel at a time.
+			for (int j=0; j<qbRT::RAY_PACKET_SIZE; ++j)
+			{
+				spanColors[i + j] = ComputePixelColor(	cameraPacket.GetRay(j), intersectionFound[j], closestObject[j], closestHitData[j],
+																								rayQueue, firstPixelIndex + i + j, (y * xSize) + x + i + j);
+			}
+		}
+	}
+	
+	// And the rest one at a time.
+	for (; i<numPixels; ++i)
+		spanColors[i] = RenderPixel(x + i, y, xSize, ySize, rayQueue, firstPixelIndex + i);
+}
+
+// Function to trace the queued secondary rays.
+void qbRT::Scene::TraceQueuedRays(qbRT::RayQueue &rayQueue, std::vector<qbVector3<double>> &pixelColors)
+{
+	/* Each pass traces the rays generated by the previous one (so the first pass traces
+		the first bounce from the camera rays, the next pass the second bounce, and so on),
+		with the rays sorted into bins so that similar rays are traced together. */
+	std::vector<qbRT::DATA::queuedRay> binnedRays;
+	while (!rayQueue.IsEmpty())
+	{
+		rayQueue.TakeBinnedRays(binnedRays);
+		for (auto &queuedRay : binnedRays)
+		{
+			qbRT::ObjectBase *closestObject = nullptr;
+			qbRT::DATA::hitData closestHitData;
+			if (!CastRay(queuedRay.ray, closestObject, closestHitData, queuedRay.skipObject))
+				continue;
+			
+			// Any rays generated by this one go back into the queue for the next pass.
+			qbRT::DATA::shadingContext context = queuedRay.context;
+			context.rayQueue = &rayQueue;
+			
+			qbVector3<double> rayColor = ComputeColor(queuedRay.ray, closestHitData, context);
+			int pixelIndex = context.pixelIndex;
+			pixelColors[pixelIndex] = pixelColors[pixelIndex] + (rayColor * context.weight);
+		}
+	}
+}
+
+// Function to cast a packet of rays into the scene.
+void qbRT::Scene::CastPacket(	const qbRT::RayPacket &castPacket, qbRT::ObjectBase *closestObject[],
+															qbRT::DATA::hitData closestHitData[], bool intersectionFound[])
+{
+	if (m_bvh.IsBuilt() && castPacket.IsCoherent())
+	{
+		m_bvh.IntersectPacket(castPacket, closestObject, closestHitData, intersectionFound);
+		return;
+	}
+	
+	// Otherwise, fall back to casting each ray on its own.
+	for (int i=0; i<qbRT::RAY_PACKET_SIZE; ++i)
+	{
+		qbRT::Ray castRay = castPacket.GetRay(i);
+		closestObject[i] = nullptr;
+		intersectionFound[i] = CastRay(castRay, closestObject[i], closestHitData[i]);
+	}
 }
 
 // Function to render an actual pixel.
-qbVector3<double> qbRT::Scene::RenderPixel(int x, int y, int xSize, int ySize)
+qbVector3<double> qbRT::Scene::RenderPixel(int x, int y, int xSize, int ySize, qbRT::RayQueue *rayQueue, int pixelIndex)
 {
-	std::shared_ptr<qbRT::ObjectBase> closestObject;	
+	qbRT::ObjectBase *closestObject = nullptr;	
 	qbRT::Ray cameraRay;
 	qbRT::DATA::hitData closestHitData;
+			
+	// Generate the ray for this pixel.
+	GenerateCameraRay(x, y, xSize, ySize, cameraRay);
+			
+	// Test for intersections with all objects in the scene.
+	bool intersectionFound = CastRay(cameraRay, closestObject, closestHitData);
+	
+	// And compute the color.
+	return ComputePixelColor(cameraRay, intersectionFound, closestObject, closestHitData, rayQueue, pixelIndex, (y * xSize) + x);
+}
+
+// Function to generate the camera ray for a pixel.
+void qbRT::Scene::GenerateCameraRay(int x, int y, int xSize, int ySize, qbRT::Ray &cameraRay)
+{
 	double xFact = 1.0 / (static_cast<double>(xSize) / 2.0);
 	double yFact = 1.0 / (static_cast<double>(ySize) / 2.0);
-	double minDist = 1e6;
-	double maxDist = 0.0;
-	qbVector3<double> outputColor {3};
 	
 	// Normalize the x and y coordinates.
 	double normX = (static_cast<double>(x) * xFact) - 1.0;
@@ -175,35 +379,79 @@ qbVector3<double> qbRT::Scene::RenderPixel(int x, int y, int xSize, int ySize)
 			
 	// Generate the ray for this pixel.
 	m_camera.GenerateRay(normX, normY, cameraRay);
-			
-	// Test for intersections with all objects in the scene.
-	bool intersectionFound = CastRay(cameraRay, closestObject, closestHitData);
+}
 
+// Function to compute the color seen along a camera ray.
+qbVector3<double> qbRT::Scene::ComputePixelColor(	const qbRT::Ray &cameraRay, bool intersectionFound, qbRT::ObjectBase *closestObject,
+																									qbRT::DATA::hitData &closestHitData, qbRT::RayQueue *rayQueue, int pixelIndex,
+																									int imageIndex)
+{
+	qbVector3<double> outputColor {3};
+	
 	/* Compute the illumination for the closest object, assuming that there
 		was a valid intersection. */
-	if (intersectionFound)
+	if (!intersectionFound)
+		return outputColor;
+	
+	// Each camera ray starts with a fresh shading context.
+	qbRT::DATA::shadingContext context;
+	if (m_bvh.IsBuilt())
+		context.bvh = &m_bvh;
+	
+	context.rayQueue = rayQueue;
+	context.pixelIndex = pixelIndex;
+	context.imageIndex = imageIndex;
+	
+	// If the secondary rays are being binned, then they are traced later (see TraceQueuedRays()).
+	if (rayQueue != nullptr)
+		return ComputeColor(cameraRay, closestHitData, context);
+	
+	/* Otherwise, any reflected or refracted rays are pushed onto a stack, which is
+		kept for each thread so that nothing is allocated per pixel or per bounce. */
+	thread_local qbRT::RayStack rayStack;
+	rayStack.Clear();
+	context.rayStack = &rayStack;
+	outputColor = ComputeColor(cameraRay, closestHitData, context);
+	
+	/* Then we trace the rays on the stack (and any that they push in turn), adding
+		the color of each one to the pixel, scaled by its weight. */
+	qbRT::DATA::queuedRay stackedRay;
+	while (rayStack.Pop(stackedRay))
 	{
-		// Check if the object has a material.
-		if (closestHitData.hitObject -> m_hasMaterial)
-		{
-			// Use the material to compute the color.
-			qbRT::MaterialBase::m_reflectionRayCount = 0;
-			outputColor = closestHitData.hitObject -> m_pMaterial -> ComputeColor(	m_objectList, m_lightList,
-																																							closestHitData.hitObject, closestHitData.poi,
-																																							closestHitData.normal,
-																																							closestHitData.localPOI,
-																																							closestHitData.uvCoords, cameraRay);
-		}
-		else
-		{
-			// Use the basic method to compute the color.
-			outputColor = qbRT::MaterialBase::ComputeDiffuseColor(m_objectList, m_lightList,
-																																					closestHitData.hitObject, closestHitData.poi,
-																																					closestHitData.normal, closestObject->m_baseColor);
-		}
+		qbRT::ObjectBase *stackedObject = nullptr;
+		qbRT::DATA::hitData stackedHitData;
+		if (!CastRay(stackedRay.ray, stackedObject, stackedHitData, stackedRay.skipObject))
+			continue;
+		
+		qbRT::DATA::shadingContext rayContext = stackedRay.context;
+		rayContext.rayStack = &rayStack;
+		
+		qbVector3<double> rayColor = ComputeColor(stackedRay.ray, stackedHitData, rayContext);
+		outputColor = outputColor + (rayColor * rayContext.weight);
 	}
 	
 	return outputColor;
+}
+
+// Function to compute the color of the closest intersection along a ray.
+qbVector3<double> qbRT::Scene::ComputeColor(	const qbRT::Ray &castRay, qbRT::DATA::hitData &closestHitData,
+																							qbRT::DATA::shadingContext &context)
+{
+	// Check if the object has a material.
+	if (closestHitData.hitObject -> m_hasMaterial)
+	{
+		// Use the material to compute the color.
+		return closestHitData.hitObject -> m_pMaterial -> ComputeColor(	m_objectList, m_lightList,
+																																		closestHitData.hitObject, closestHitData.poi,
+																																		closestHitData.normal,
+																																		closestHitData.localPOI,
+																																		closestHitData.uvCoords, castRay, context);
+	}
+	
+	// Otherwise, use the basic method to compute the color.
+	return qbRT::MaterialBase::ComputeDiffuseColor(	m_objectList, m_lightList,
+																									closestHitData.hitObject, closestHitData.poi,
+																									closestHitData.normal, closestHitData.hitObject -> m_baseColor, context);
 }	
 
 // Function to convert to a linear index.
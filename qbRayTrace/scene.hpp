@@ -37,15 +37,20 @@
 
 #include <memory>
 #include <vector>
-#include <SDL2/SDL.h>
 #include "qbutils.hpp"
-#include "qbImage.hpp"
+#include "framebuffer.hpp"
 #include "camera.hpp"
+#include "rayqueue.hpp"
+#include "raystack.hpp"
+#include "wavefront.hpp"
+#include "./qbAccel/bvh.hpp"
 #include "./qbPrimatives/objsphere.hpp"
 #include "./qbPrimatives/objplane.hpp"
 #include "./qbPrimatives/cylinder.hpp"
 #include "./qbPrimatives/cone.hpp"
 #include "./qbPrimatives/box.hpp"
+#include "./qbPrimatives/instance.hpp"
+#include "./qbPrimatives/trianglemesh.hpp"
 #include "./qbLights/pointlight.hpp"
 #include "./qbRayMarch/sphere.hpp"
 #include "./qbRayMarch/torus.hpp"
@@ -66,26 +71,66 @@ namespace qbRT
 			// Destructor.
 			virtual ~Scene();
 			
-			// Function to perform the rendering.
-			bool Render(qbImage &outputImage);
+			// Function to perform the rendering (on the calling thread).
+			bool Render(qbRT::FrameBuffer &outputImage);
 			
 			/*
 				New function to handle rendering a specified tile.
 			*/
-			// Function to handle rendering a tile.
-			void RenderTile(qbRT::DATA::tile *tile);
+			// Function to handle rendering a tile into the frame buffer.
+			// If a time budget (in seconds) is given, then rendering stops at the end
+			// of the first row that runs past the budget. Rendering starts from firstRow,
+			// which allows a tile to be finished off. Returns the number of rows rendered
+			// (counting from the top of the tile).
+			int RenderTile(qbRT::DATA::tile *tile, qbRT::FrameBuffer *frameBuffer, double timeBudget = 0.0, int firstRow = 0);
 			
-			// Function to cast a ray into the scene.
-			bool CastRay(	qbRT::Ray &castRay, std::shared_ptr<qbRT::ObjectBase> &closestObject,
-										qbRT::DATA::hitData &closestHitData);
+			// Function to (re)build the acceleration structure from the current object list.
+			// This must be called, with no rendering in progress, whenever the objects change.
+			void BuildBVH();
+			
+			// Function to cast a ray into the scene (ignoring skipObject, if given).
+			bool CastRay(	qbRT::Ray &castRay, qbRT::ObjectBase *&closestObject,
+										qbRT::DATA::hitData &closestHitData, const qbRT::ObjectBase *skipObject = nullptr);
+										
+			/* Function to cast a packet of rays into the scene. If the rays aren't
+				coherent (or there is no acceleration structure), they are cast one
+				at a time instead. */
+			void CastPacket(	const qbRT::RayPacket &castPacket, qbRT::ObjectBase *closestObject[],
+												qbRT::DATA::hitData closestHitData[], bool intersectionFound[]);
+										
+			// Function to generate the camera ray for a pixel.
+			void GenerateCameraRay(int x, int y, int xSize, int ySize, qbRT::Ray &cameraRay);
+			
+			// Function to compute the color of the closest intersection along a ray.
+			qbVector3<double> ComputeColor(	const qbRT::Ray &castRay, qbRT::DATA::hitData &closestHitData,
+																			qbRT::DATA::shadingContext &context);
 										
 			// Function to handle setting up the scene (to be overriden).
 			virtual void SetupSceneObjects();
 			
 		// Private functions.
 		private:
-			// Function to handle rendering a pixel.
-			qbVector3<double> RenderPixel(int x, int y, int xSize, int ySize);
+			/* Function to handle rendering a pixel. If rayQueue is not NULL, then any secondary rays
+				are added to it (for pixelIndex), to be traced later. Otherwise, they are traced from a
+				stack (see qbRT::RayStack) once the camera ray has been shaded. */
+			qbVector3<double> RenderPixel(int x, int y, int xSize, int ySize, qbRT::RayQueue *rayQueue, int pixelIndex);
+			
+			/* Function to render a row of numPixels pixels, starting at (x, y), into spanColors, using
+				packets where possible. Secondary rays are handled as for RenderPixel(), with the pixels
+				numbered from firstPixelIndex. */
+			void RenderSpan(	int x, int y, int numPixels, int xSize, int ySize, qbVector3<double> spanColors[],
+												qbRT::RayQueue *rayQueue, int firstPixelIndex);
+			
+			// Function to trace the rays in the queue (and any that they generate), adding their colors to pixelColors.
+			void TraceQueuedRays(qbRT::RayQueue &rayQueue, std::vector<qbVector3<double>> &pixelColors);
+			
+			// Function to compute the color seen along a camera ray, given the result of casting it.
+			qbVector3<double> ComputePixelColor(	const qbRT::Ray &cameraRay, bool intersectionFound, qbRT::ObjectBase *closestObject,
+																						qbRT::DATA::hitData &closestHitData, qbRT::RayQueue *rayQueue, int pixelIndex,
+																						int imageIndex);
+			
+			// Function to add the secondary rays that this thread has counted since startStats to the tile.
+			void AddRayStats(qbRT::DATA::tile *tile, const qbRT::DATA::rayStats &startStats);
 			
 			// Function to convert coordinates to a linear index.
 			int Sub2Ind(int x, int y, int xSize, int ySize);
@@ -101,8 +146,22 @@ namespace qbRT
 			// The list of lights in the scene.
 			std::vector<std::shared_ptr<qbRT::LightBase>> m_lightList;
 			
+			// The acceleration structure over m_objectList (see BuildBVH()).
+			qbRT::ACCEL::BVH m_bvh;
+			
 			// Scene parameters.
 			int m_xSize, m_ySize;
+			
+			// Flag to indicate whether camera rays should be traced in packets.
+			bool m_usePackets = true;
+			
+			/* Flag to indicate whether secondary rays should be queued up and traced in bins
+				(one tile at a time), rather than as soon as they are generated. */
+			bool m_binSecondaryRays = false;
+			
+			/* Flag to indicate whether to render with the wavefront renderer (see qbRT::WavefrontRenderer),
+				rather than one pixel at a time. */
+			bool m_useWavefront = false;
 	};
 }
 
@@ -37,9 +37,7 @@
 
 #include <memory>
 #include <vector>
-#include <SDL2/SDL.h>
 #include "scene.hpp"
-#include "qbImage.hpp"
 #include "camera.hpp"
 #include "./qbPrimatives/objsphere.hpp"
 #include "./qbPrimatives/objplane.hpp"
@@ -0,0 +1,122 @@
+/* ***********************************************************
+	shadowcache.cpp
+
+	The ShadowCache class implementation.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "shadowcache.hpp"
+#include "./qbAccel/bvh.hpp"
+
+// Default constructor.
+qbRT::ShadowCache::ShadowCache()
+{
+
+}
+
+// Function to empty the cache.
+void qbRT::ShadowCache::Clear()
+{
+	m_rays.clear();
+	m_occluded.clear();
+	m_nextRay = 0;
+	m_endRay = 0;
+}
+
+// Function to return the list of shadow rays.
+std::vector<qbRT::DATA::shadowRay>& qbRT::ShadowCache::GetRays()
+{
+	return m_rays;
+}
+
+// Function to trace all of the shadow rays.
+void qbRT::ShadowCache::TraceAll(const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList, const qbRT::ACCEL::BVH *bvh)
+{
+	m_occluded.resize(m_rays.size());
+	for (size_t i=0; i<m_rays.size(); ++i)
+		m_occluded[i] = TraceRay(m_rays[i], objectList, bvh);
+}
+
+// Function to set the range of rays for the next lookups.
+void qbRT::ShadowCache::SetLookupRange(int firstRay, int numRays)
+{
+	m_nextRay = firstRay;
+	m_endRay = firstRay + numRays;
+}
+
+// Function to look up the next shadow ray.
+bool qbRT::ShadowCache::Lookup(const qbRT::DATA::shadowRay &shadowRay, bool &occluded)
+{
+	if ((m_nextRay >= m_endRay) || (m_nextRay >= static_cast<int>(m_occluded.size())))
+		return false;
+
+	// The ray has to be exactly the same, otherwise the answer might not be.
+	const qbRT::DATA::shadowRay &cachedRay = m_rays[m_nextRay];
+	for (int i=0; i<3; ++i)
+	{
+		if (	(cachedRay.ray.m_point1.GetElement(i) != shadowRay.ray.m_point1.GetElement(i)) ||
+					(cachedRay.ray.m_lab.GetElement(i) != shadowRay.ray.m_lab.GetElement(i)))
+			return false;
+	}
+
+	if ((cachedRay.maxDist != shadowRay.maxDist) || (cachedRay.skipObject != shadowRay.skipObject))
+		return false;
+
+	occluded = m_occluded[m_nextRay];
+	++m_nextRay;
+	return true;
+}
+
+// Function to test a shadow ray.
+bool qbRT::ShadowCache::IsOccluded(	const qbRT::DATA::shadowRay &shadowRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+																		const qbRT::DATA::shadingContext &context)
+{
+	bool occluded = false;
+	if ((context.shadowCache != nullptr) && context.shadowCache -> Lookup(shadowRay, occluded))
+		return occluded;
+
+	return TraceRay(shadowRay, objectList, context.bvh);
+}
+
+// Function to trace a single shadow ray.
+bool qbRT::ShadowCache::TraceRay(	const qbRT::DATA::shadowRay &shadowRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+																	const qbRT::ACCEL::BVH *bvh)
+{
+	// If we have an acceleration structure, then it can do this for us.
+	if (bvh != nullptr)
+		return bvh -> IsOccluded(shadowRay.ray, shadowRay.maxDist, shadowRay.skipObject);
+
+	/* Otherwise, test each object in turn. As the ray direction is a unit vector,
+		the distance is also the value of t at the end of the ray. */
+	for (auto &sceneObject : objectList)
+	{
+		if ((sceneObject.get() != shadowRay.skipObject) && sceneObject -> TestOcclusion(shadowRay.ray, shadowRay.maxDist))
+			return true;
+	}
+
+	return false;
+}
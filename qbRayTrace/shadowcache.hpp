@@ -0,0 +1,106 @@
+/* ***********************************************************
+	shadowcache.hpp
+
+	The ShadowCache class definition - A class to hold a list of
+	shadow rays and whether or not each one is blocked.
+
+	The shading code tests for shadows as it goes, one ray at a
+	time, in between everything else that it does. The wavefront
+	renderer (see wavefront.hpp) instead asks the materials for the
+	shadow rays that they are going to need, traces all of them in
+	one go and then shades with the answers already to hand. The
+	shading code gets those answers from IsOccluded(), which only
+	traces a ray itself if the answer isn't in the cache.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef SHADOWCACHE_H
+#define SHADOWCACHE_H
+
+#include <memory>
+#include <vector>
+#include "ray.hpp"
+#include "qbutils.hpp"
+
+namespace qbRT
+{
+	namespace DATA
+	{
+		/* Structure for a shadow ray (a test of whether anything other than skipObject lies
+			within maxDist of the start of the ray). The ray direction should be a unit vector. */
+		struct shadowRay
+		{
+			qbRT::Ray ray;
+			double maxDist = 0.0;
+			const qbRT::ObjectBase *skipObject = nullptr;
+		};
+	}
+
+	class ShadowCache
+	{
+		public:
+			// Default constructor.
+			ShadowCache();
+
+			// Function to empty the cache.
+			void Clear();
+
+			// Function to return the list of shadow rays, so that more can be added to the end of it.
+			std::vector<qbRT::DATA::shadowRay>& GetRays();
+
+			// Function to trace all of the shadow rays.
+			void TraceAll(const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList, const qbRT::ACCEL::BVH *bvh);
+
+			/* Function to pick out the rays that the next lookups should be matched against
+				(normally the rays for a single point, in the order they will be needed). */
+			void SetLookupRange(int firstRay, int numRays);
+
+			/* Function to look up the next shadow ray. If it matches shadowRay exactly, then
+				occluded is set and true is returned. Otherwise, nothing is changed. */
+			bool Lookup(const qbRT::DATA::shadowRay &shadowRay, bool &occluded);
+
+			/* Function to test a shadow ray, using the cache in the context if there is one, and
+				otherwise tracing the ray (with the acceleration structure, if there is one). */
+			static bool IsOccluded(	const qbRT::DATA::shadowRay &shadowRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+															const qbRT::DATA::shadingContext &context);
+
+		private:
+			// Function to trace a single shadow ray.
+			static bool TraceRay(	const qbRT::DATA::shadowRay &shadowRay, const std::vector<std::shared_ptr<qbRT::ObjectBase>> &objectList,
+														const qbRT::ACCEL::BVH *bvh);
+
+		private:
+			std::vector<qbRT::DATA::shadowRay> m_rays;
+			std::vector<bool> m_occluded;
+
+			// The next ray to look up, and the end of the range set by SetLookupRange().
+			int m_nextRay = 0;
+			int m_endRay = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,194 @@
+/* ***********************************************************
+	wavefront.cpp
+
+	The WavefrontRenderer class implementation.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#include "wavefront.hpp"
+#include "scene.hpp"
+#include "raypacket.hpp"
+#include "./qbMaterials/materialbase.hpp"
+
+// Default constructor.
+qbRT::WavefrontRenderer::WavefrontRenderer()
+{
+
+}
+
+// Function to render a tile.
+void qbRT::WavefrontRenderer::RenderTile(qbRT::Scene &scene, const qbRT::DATA::tile &tile, qbRT::FrameBuffer &frameBuffer, int firstRow)
+{
+	// Every pixel starts off black (as it stays if its camera ray misses everything).
+	qbVector3<double> blankColor {3};
+	m_pixelColors.assign((tile.ySize - firstRow) * tile.xSize, blankColor);
+
+	// The rays generated by shading are binned, as for Scene::m_binSecondaryRays.
+	if (!scene.m_bvh.GetNodes().empty())
+		m_rayQueue.SetBounds(scene.m_bvh.GetNodes().front().bounds);
+
+	// Run each pass through the pipeline, starting with the camera rays.
+	GenerateCameraRays(scene, tile, firstRow);
+	bool cameraRays = true;
+	while (!m_rays.empty())
+	{
+		ExtendRays(scene, cameraRays);
+		TraceShadowRays(scene);
+		ShadeHits(scene);
+		AccumulateColors();
+
+		m_rayQueue.TakeBinnedRays(m_rays);
+		cameraRays = false;
+	}
+
+	// And write out the result.
+	for (int y=firstRow; y<tile.ySize; ++y)
+	{
+		for (int x=0; x<tile.xSize; ++x)
+			frameBuffer.SetPixel(tile.x + x, tile.y + y, m_pixelColors[((y - firstRow) * tile.xSize) + x]);
+	}
+}
+
+// Function to generate the camera rays.
+void qbRT::WavefrontRenderer::GenerateCameraRays(qbRT::Scene &scene, const qbRT::DATA::tile &tile, int firstRow)
+{
+	m_rays.resize((tile.ySize - firstRow) * tile.xSize);
+	int rayIndex = 0;
+	for (int y=firstRow; y<tile.ySize; ++y)
+	{
+		for (int x=0; x<tile.xSize; ++x)
+		{
+			qbRT::DATA::queuedRay &cameraRay = m_rays[rayIndex];
+			scene.GenerateCameraRay(tile.x + x, tile.y + y, scene.m_xSize, scene.m_ySize, cameraRay.ray);
+			cameraRay.skipObject = nullptr;
+			cameraRay.context = qbRT::DATA::shadingContext();
+			cameraRay.context.pixelIndex = rayIndex;
+			cameraRay.context.imageIndex = ((tile.y + y) * scene.m_xSize) + tile.x + x;
+			if (scene.m_bvh.IsBuilt())
+				cameraRay.context.bvh = &scene.m_bvh;
+			++rayIndex;
+		}
+	}
+}
+
+// Function to find the closest intersection for each ray.
+void qbRT::WavefrontRenderer::ExtendRays(qbRT::Scene &scene, bool cameraRays)
+{
+	m_hitRays.clear();
+	m_hits.clear();
+
+	qbRT::ObjectBase *closestObject[qbRT::RAY_PACKET_SIZE];
+	qbRT::DATA::hitData closestHitData[qbRT::RAY_PACKET_SIZE];
+	bool intersectionFound[qbRT::RAY_PACKET_SIZE];
+	int numRays = static_cast<int>(m_rays.size());
+	int i = 0;
+
+	// Neighbouring camera rays are coherent, so they can be traced in packets.
+	if (cameraRays && scene.m_usePackets)
+	{
+		qbRT::RayPacket cameraPacket;
+		for (; (i + qbRT::RAY_PACKET_SIZE) <= numRays; i += qbRT::RAY_PACKET_SIZE)
+		{
+			for (int j=0; j<qbRT::RAY_PACKET_SIZE; ++j)
+				cameraPacket.SetRay(j, m_rays[i + j].ray);
+
+			scene.CastPacket(cameraPacket, closestObject, closestHitData, intersectionFound);
+			for (int j=0; j<qbRT::RAY_PACKET_SIZE; ++j)
+			{
+				if (intersectionFound[j])
+				{
+					m_hitRays.push_back(i + j);
+					m_hits.push_back(closestHitData[j]);
+				}
+			}
+		}
+	}
+
+	// And the rest one at a time.
+	for (; i<numRays; ++i)
+	{
+		closestObject[0] = nullptr;
+		if (scene.CastRay(m_rays[i].ray, closestObject[0], closestHitData[0], m_rays[i].skipObject))
+		{
+			m_hitRays.push_back(i);
+			m_hits.push_back(closestHitData[0]);
+		}
+	}
+}
+
+// Function to trace the shadow rays.
+void qbRT::WavefrontRenderer::TraceShadowRays(qbRT::Scene &scene)
+{
+	// Ask each material which shadow rays it is going to test.
+	m_shadowCache.Clear();
+	std::vector<qbRT::DATA::shadowRay> &shadowRays = m_shadowCache.GetRays();
+	m_firstShadowRays.resize(m_hits.size() + 1);
+	for (size_t i=0; i<m_hits.size(); ++i)
+	{
+		m_firstShadowRays[i] = static_cast<int>(shadowRays.size());
+
+		const qbRT::DATA::hitData &hit = m_hits[i];
+		if (hit.hitObject -> m_hasMaterial)
+			hit.hitObject -> m_pMaterial -> GetShadowRays(scene.m_lightList, hit.poi, hit.normal, hit.uvCoords, shadowRays);
+		else
+			qbRT::MaterialBase::GetDiffuseShadowRays(scene.m_lightList, hit.poi, hit.normal, shadowRays);
+	}
+	m_firstShadowRays[m_hits.size()] = static_cast<int>(shadowRays.size());
+
+	// Then trace them all.
+	m_shadowCache.TraceAll(scene.m_objectList, scene.m_bvh.IsBuilt() ? &scene.m_bvh : nullptr);
+}
+
+// Function to shade the intersections.
+void qbRT::WavefrontRenderer::ShadeHits(qbRT::Scene &scene)
+{
+	m_hitColors.resize(m_hits.size());
+	for (size_t i=0; i<m_hits.size(); ++i)
+	{
+		const qbRT::DATA::queuedRay &castRay = m_rays[m_hitRays[i]];
+
+		/* The shadow rays come from the cache, and any reflected or refracted rays are
+			queued up for the next pass. */
+		qbRT::DATA::shadingContext context = castRay.context;
+		context.rayQueue = &m_rayQueue;
+		context.shadowCache = &m_shadowCache;
+		m_shadowCache.SetLookupRange(m_firstShadowRays[i], m_firstShadowRays[i + 1] - m_firstShadowRays[i]);
+
+		m_hitColors[i] = scene.ComputeColor(castRay.ray, m_hits[i], context);
+	}
+}
+
+// Function to add the colors to their pixels.
+void qbRT::WavefrontRenderer::AccumulateColors()
+{
+	for (size_t i=0; i<m_hits.size(); ++i)
+	{
+		const qbRT::DATA::queuedRay &castRay = m_rays[m_hitRays[i]];
+		int pixelIndex = castRay.context.pixelIndex;
+		m_pixelColors[pixelIndex] = m_pixelColors[pixelIndex] + (m_hitColors[i] * castRay.context.weight);
+	}
+}
@@ -0,0 +1,106 @@
+/* ***********************************************************
+	wavefront.hpp
+
+	The WavefrontRenderer class definition - An alternative to the
+	recursive renderer (Scene::RenderPixel()), that renders a whole
+	tile at a time in separate stages.
+
+	The recursive renderer finds the closest intersection for a
+	pixel, shades it (testing for shadows as it goes), then traces
+	and shades any reflected or refracted rays before moving on to
+	the next pixel. Here, each stage works through every ray in the
+	tile in a single loop before the next stage starts:
+
+		Generate		- Create the camera rays for the tile.
+		Extend			- Find the closest intersection for every ray.
+		Shadow			- Trace every shadow ray that shading will need.
+		Shade				- Shade every intersection, queueing up any reflected
+									or refracted rays for the next pass.
+		Accumulate	- Add the colors to their pixels.
+
+	The extend, shadow, shade and accumulate stages are repeated for
+	each generation of secondary rays, until there are none left. The
+	shading itself is done by the materials, exactly as before, so the
+	image is the same as from the recursive renderer.
+
+	This file forms part of the qbRayTrace project as described
+	in the series of videos on the QuantitativeBytes YouTube
+	channel.
+
+	The whole series may be found on the QuantitativeBytes
+	YouTube channel at:
+	www.youtube.com/c/QuantitativeBytes
+
+	GPLv3 LICENSE
+
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***********************************************************/
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <vector>
+#include "qbutils.hpp"
+#include "framebuffer.hpp"
+#include "rayqueue.hpp"
+#include "shadowcache.hpp"
+
+namespace qbRT
+{
+	// Forward-declare the scene.
+	class Scene;
+
+	class WavefrontRenderer
+	{
+		public:
+			// Default constructor.
+			WavefrontRenderer();
+
+			// Function to render the rows of a tile from firstRow onwards into the frame buffer.
+			void RenderTile(qbRT::Scene &scene, const qbRT::DATA::tile &tile, qbRT::FrameBuffer &frameBuffer, int firstRow);
+
+		private:
+			// The stages of the pipeline.
+			void GenerateCameraRays(qbRT::Scene &scene, const qbRT::DATA::tile &tile, int firstRow);
+			void ExtendRays(qbRT::Scene &scene, bool cameraRays);
+			void TraceShadowRays(qbRT::Scene &scene);
+			void ShadeHits(qbRT::Scene &scene);
+			void AccumulateColors();
+
+		private:
+			// The rays for the current pass.
+			std::vector<qbRT::DATA::queuedRay> m_rays;
+
+			// The rays that hit something (as indices into m_rays), and what they hit.
+			std::vector<int> m_hitRays;
+			std::vector<qbRT::DATA::hitData> m_hits;
+
+			// The shadow rays for all of the hits, with the first one for each hit (plus one past the end).
+			qbRT::ShadowCache m_shadowCache;
+			std::vector<int> m_firstShadowRays;
+
+			// The color of each hit.
+			std::vector<qbVector3<double>> m_hitColors;
+
+			// The rays generated by shading, for the next pass.
+			qbRT::RayQueue m_rayQueue;
+
+			// The color of each pixel of the tile, from firstRow onwards.
+			std::vector<qbVector3<double>> m_pixelColors;
+	};
+}
+
+#endif